@@ -0,0 +1,232 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "../AI/FlowField.h"
+
+#include "../Util/MathUtil.h"
+
+#include <algorithm>
+#include <functional>
+
+FlowField::FlowField( SpatialGraph* graph, SpatialGraphKDNode* pGoalNode )
+: _graph(graph)
+, _goalId(pGoalNode->ID)
+, _lastUsed(0)
+{
+	_distances.resize( graph->GetNodeIdCount(), MathUtil::MaxFloat );
+	_next.resize( graph->GetNodeIdCount(), -1 );
+
+	std::vector<OpenEntry> open;
+	OpenEntry start;
+	start.Distance = 0.0f;
+	start.ID = _goalId;
+	_distances[_goalId] = 0.0f;
+	open.push_back( start );
+
+	while( !open.empty() )
+	{
+		std::pop_heap( open.begin(), open.end(), std::greater<OpenEntry>() );
+		OpenEntry current = open.back();
+		open.pop_back();
+
+		//Skip the stale copies left behind when a node got closer
+		if( current.Distance > _distances[current.ID] )
+			continue;
+
+		SpatialGraphKDNode* pNode = graph->GetNodeById( current.ID );
+		for( unsigned int i = 0; i < pNode->Neighbors.size(); i++ )
+		{
+			//We're searching backward, so it's the neighbor's way to us 
+			// that has to be open
+			SpatialGraphKDNode* pNeighbor = pNode->Neighbors[i];
+			if( pNeighbor->bBlocked )
+				continue;
+
+			bool canComeHere = false;
+			for( unsigned int j = 0; j < pNeighbor->Neighbors.size(); j++ )
+			{
+				if( pNeighbor->Neighbors[j] == pNode )
+				{
+					canComeHere = pNeighbor->NeighborLOS[j];
+					break;
+				}
+			}
+			if( !canComeHere )
+				continue;
+
+			float distance = current.Distance + Vector2::Distance( pNode->Centroid, pNeighbor->Centroid );
+			if( distance >= _distances[pNeighbor->ID] )
+				continue;
+
+			_distances[pNeighbor->ID] = distance;
+			_next[pNeighbor->ID] = current.ID;
+
+			OpenEntry entry;
+			entry.Distance = distance;
+			entry.ID = pNeighbor->ID;
+			open.push_back( entry );
+			std::push_heap( open.begin(), open.end(), std::greater<OpenEntry>() );
+		}
+	}
+}
+
+bool FlowField::GetMoveDirection( const Vector2& from, const Vector2& goal, Vector2& moveDir )
+{
+	SpatialGraphKDNode* pNode = _graph->FindNode( from );
+	if( pNode == NULL || pNode->bBlocked )
+		return false;
+
+	if( pNode->ID == _goalId )
+	{
+		moveDir = Vector2::Normalize( goal - from );
+		return true;
+	}
+
+	int next = _next[pNode->ID];
+	if( next < 0 )
+		return false;
+
+	moveDir = Vector2::Normalize( _graph->GetNodeById(next)->Centroid - from );
+	return true;
+}
+
+float FlowField::GetDistance( const Vector2& from )
+{
+	SpatialGraphKDNode* pNode = _graph->FindNode( from );
+	if( pNode == NULL || pNode->ID < 0 )
+		return MathUtil::MaxFloat;
+
+	return _distances[pNode->ID];
+}
+
+
+FlowFieldManager* FlowFieldManager::s_FlowFieldManager = NULL;
+
+FlowFieldManager& FlowFieldManager::GetInstance()
+{
+	if( s_FlowFieldManager == NULL )
+	{
+		s_FlowFieldManager = new FlowFieldManager();
+	}
+	return *s_FlowFieldManager;
+}
+
+FlowFieldManager::FlowFieldManager()
+: _graph(NULL)
+, _graphRevision(0)
+, _useClock(0)
+, _maxFields(16)
+, _numBuilds(0)
+{
+}
+
+FlowField* FlowFieldManager::GetField( const Vector2& goal )
+{
+	SpatialGraph* graph = theSpatialGraph.GetGraph();
+	if( graph == NULL )
+		return NULL;
+
+	//Any change to the graph makes every field stale
+	if( graph != _graph || graph->GetRevision() != _graphRevision )
+	{
+		Clear();
+		_graph = graph;
+		_graphRevision = graph->GetRevision();
+	}
+
+	SpatialGraphKDNode* pGoalNode = graph->FindNode( goal );
+	if( pGoalNode == NULL || pGoalNode->bBlocked )
+		return NULL;
+
+	FlowField* field = NULL;
+	std::map<int, FlowField*>::iterator it = _fields.find( pGoalNode->ID );
+	if( it != _fields.end() )
+	{
+		field = it->second;
+	}
+	else
+	{
+		if( (int)_fields.size() >= _maxFields )
+		{
+			EvictLeastRecentlyUsed();
+		}
+		field = new FlowField( graph, pGoalNode );
+		_fields[pGoalNode->ID] = field;
+		_numBuilds++;
+	}
+
+	field->_lastUsed = ++_useClock;
+	return field;
+}
+
+bool FlowFieldManager::GetMoveDirection( const Vector2& from, const Vector2& goal, Vector2& moveDir )
+{
+	FlowField* field = GetField( goal );
+	if( field == NULL )
+		return false;
+
+	return field->GetMoveDirection( from, goal, moveDir );
+}
+
+void FlowFieldManager::SetMaxFields( int maxFields )
+{
+	_maxFields = MathUtil::Max( maxFields, 1 );
+	while( (int)_fields.size() > _maxFields )
+	{
+		EvictLeastRecentlyUsed();
+	}
+}
+
+void FlowFieldManager::Clear()
+{
+	for( std::map<int, FlowField*>::iterator it = _fields.begin(); it != _fields.end(); ++it )
+	{
+		delete it->second;
+	}
+	_fields.clear();
+}
+
+void FlowFieldManager::EvictLeastRecentlyUsed()
+{
+	std::map<int, FlowField*>::iterator oldest = _fields.end();
+	for( std::map<int, FlowField*>::iterator it = _fields.begin(); it != _fields.end(); ++it )
+	{
+		if( oldest == _fields.end() || it->second->_lastUsed < oldest->second->_lastUsed )
+		{
+			oldest = it;
+		}
+	}
+
+	if( oldest != _fields.end() )
+	{
+		delete oldest->second;
+		_fields.erase( oldest );
+	}
+}
@@ -0,0 +1,183 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../AI/SpatialGraph.h"
+
+#include <map>
+
+//singleton shortcut
+#define theFlowFields FlowFieldManager::GetInstance()
+
+///Which way to go from anywhere in the SpatialGraph to reach one goal node
+/** 
+ * Built with a single Dijkstra search outward from the goal, so every 
+ *  leaf in the graph knows its distance to the goal and which neighbor to
+ *  head for next. Once it's built, any number of agents can steer by it 
+ *  for the cost of finding the node they're standing in. 
+ * 
+ * You don't create these yourself; ask the FlowFieldManager for one. 
+ */
+class FlowField
+{
+public:
+	/**
+	 * Which way to move from a point to get to the goal. 
+	 * 
+	 * @param from Where the agent is now
+	 * @param goal The exact goal point, which should be in this field's 
+	 *   goal node; agents in that node head straight for it
+	 * @param moveDir Filled in with a normalized direction
+	 * @return False if the point isn't in the graph, is in blocked space, 
+	 *   or can't reach the goal
+	 */
+	bool GetMoveDirection( const Vector2& from, const Vector2& goal, Vector2& moveDir );
+
+	/**
+	 * How far a point's node is from the goal, going centroid to centroid.
+	 * 
+	 * @param from The point to check
+	 * @return The distance, or MathUtil::MaxFloat if it can't get there
+	 */
+	float GetDistance( const Vector2& from );
+
+	const int GetGoalNodeId() const { return _goalId; }
+
+private:
+	friend class FlowFieldManager;
+	FlowField( SpatialGraph* graph, SpatialGraphKDNode* pGoalNode );
+
+	struct OpenEntry
+	{
+		float Distance;
+		int ID;
+
+		bool operator>( const OpenEntry& other ) const
+		{
+			if( Distance != other.Distance )
+				return Distance > other.Distance;
+			return ID > other.ID;
+		}
+	};
+
+	SpatialGraph* _graph;
+	int _goalId;
+	std::vector<float> _distances;
+	// The neighbor to head for next, or -1 at the goal and where it's 
+	//  unreachable
+	std::vector<int> _next;
+	// For evicting the least recently used field
+	unsigned int _lastUsed;
+};
+
+///Builds and caches FlowFields, so crowds heading to one place share work
+/** 
+ * When lots of agents are all going to the same place, having each one run
+ *  its own A* repeats nearly the same search over and over. The 
+ *  FlowFieldManager instead builds one FlowField per goal node and keeps it
+ *  around until the goal moves to another node, the graph is rebuilt or 
+ *  invalidated, or it's the least recently used field and room is needed. 
+ * 
+ * GotoAIEvents (and so GotoTargetAIEvents) use it when 
+ *  GotoAIEvent::SetUseFlowField is turned on. 
+ * 
+ * Like the World, it uses the singleton pattern; use "theFlowFields" to 
+ *  access it. 
+ */
+class FlowFieldManager
+{
+public:
+	/**
+	 * Used to access the singleton instance of this class. As a shortcut, 
+	 *  you can just use "theFlowFields". 
+	 * 
+	 * @return The singleton
+	 */
+	static FlowFieldManager& GetInstance();
+
+	/**
+	 * Gets the field leading to a point, building it if it isn't cached. 
+	 * 
+	 * @param goal Where the agents are headed
+	 * @return The field, or NULL if there's no graph or the goal isn't in 
+	 *   open space. Only good until the next call, since that might evict
+	 *   it. 
+	 */
+	FlowField* GetField( const Vector2& goal );
+
+	/**
+	 * A shortcut for getting the field for a goal and asking it which way 
+	 *  to move. 
+	 * 
+	 * @param from Where the agent is now
+	 * @param goal Where it's headed
+	 * @param moveDir Filled in with a normalized direction
+	 * @return False if there's no way to get there
+	 */
+	bool GetMoveDirection( const Vector2& from, const Vector2& goal, Vector2& moveDir );
+
+	/**
+	 * Sets how many fields to keep around at once. 
+	 * 
+	 * @param maxFields The limit (16 by default)
+	 */
+	void SetMaxFields( int maxFields );
+	const int GetMaxFields() const { return _maxFields; }
+
+	const int GetNumFields() const { return (int)_fields.size(); }
+
+	/**
+	 * Find out how many fields have been built, to see how well the cache 
+	 *  is doing. 
+	 * 
+	 * @return The number of fields built since startup
+	 */
+	const int GetNumBuilds() const { return _numBuilds; }
+
+	/**
+	 * Throws away every cached field. 
+	 */
+	void Clear();
+
+protected:
+	FlowFieldManager();
+	static FlowFieldManager* s_FlowFieldManager;
+
+private:
+	void EvictLeastRecentlyUsed();
+
+	// By goal node ID
+	std::map<int, FlowField*> _fields;
+	SpatialGraph* _graph;
+	int _graphRevision;
+	unsigned int _useClock;
+	int _maxFields;
+	int _numBuilds;
+};
@@ -31,27 +31,38 @@
 #include "../AI/PathFinder.h"
 
 #include "../AI/SpatialGraph.h"
+#include "../AI/PathRequestQueue.h"
+#include "../AI/PathHierarchy.h"
 #include "../Infrastructure/TextRendering.h"
 #include "../Util/DrawUtil.h"
 #include "../Util/StringUtil.h"
 #include "../Util/MathUtil.h"
 
 bool PathFinder::_drawPaths = false;
+bool PathFinder::_asyncPaths = false;
 
 PathFinder::PathFinder()
 : _currentPathIndex(-1)
 , _currentState(PFMS_START)
 , _arrivalDist(0.0f)
+, _pathRequest(INVALID_PATH_REQUEST)
+, _corridor(new PathCorridor())
 {
 	InitializeStates();
 }
 
 PathFinder::~PathFinder()
 {
+	if( _pathRequest != INVALID_PATH_REQUEST )
+	{
+		thePathRequestQueue.CancelRequest( _pathRequest );
+	}
+
 	for( int i = 0; i < PFMS_COUNT; i++ )
 	{
 		delete _states[i];
 	}
+	delete _corridor;
 
 }
 
@@ -111,6 +122,11 @@ void PathFinder::EnableDrawPaths(bool enable)
 	_drawPaths = enable;
 }
 
+void PathFinder::EnableAsyncPaths(bool enable)
+{
+	_asyncPaths = enable;
+}
+
 
 class StartMoveState : public FindNextMoveState
 {
@@ -126,7 +142,28 @@ public:
 		}
 		//find path
 		GetCurrentPath().clear();
-		bool retVal = theSpatialGraph.GetPath( GetCurrentPosition(), GetCurrentDestination(), GetCurrentPath() );
+		GetCurrentCorridor().Clear();
+		bool retVal = false;
+		if( PathFinder::GetAsyncPaths() )
+		{
+			PathRequestQueue::ePathRequestStatus status = PollPathRequest();
+			if( status == PathRequestQueue::PRS_PENDING )
+			{
+				//Stay put until it shows up
+				move.LastResult = PathFinder::PFMR_PATH_PENDING;
+				return false;
+			}
+			retVal = (status == PathRequestQueue::PRS_FOUND);
+		}
+		else if( theSpatialGraph.GetPathHierarchy() != NULL )
+		{
+			//Only the first stretch; Follow fills in the rest as we go
+			retVal = theSpatialGraph.GetHierarchicalPath( GetCurrentPosition(), GetCurrentDestination(), GetCurrentCorridor(), GetCurrentPath() );
+		}
+		else
+		{
+			retVal = theSpatialGraph.GetPath( GetCurrentPosition(), GetCurrentDestination(), GetCurrentPath() );
+		}
 
 		if( retVal )
 		{
@@ -147,6 +184,31 @@ public:
 		return false;
 	}
 
+private:
+	PathRequestQueue::ePathRequestStatus PollPathRequest()
+	{
+		unsigned int& request = GetCurrentPathRequest();
+
+		//Start over if the destination moved while we were waiting
+		if( request != INVALID_PATH_REQUEST && GetCurrentPathRequestDest() != GetCurrentDestination() )
+		{
+			thePathRequestQueue.CancelRequest( request );
+			request = INVALID_PATH_REQUEST;
+		}
+
+		if( request == INVALID_PATH_REQUEST )
+		{
+			request = thePathRequestQueue.RequestPath( GetCurrentPosition(), GetCurrentDestination() );
+			GetCurrentPathRequestDest() = GetCurrentDestination();
+		}
+
+		PathRequestQueue::ePathRequestStatus status = thePathRequestQueue.GetResult( request, GetCurrentPath() );
+		if( status != PathRequestQueue::PRS_PENDING )
+		{
+			request = INVALID_PATH_REQUEST;
+		}
+		return status;
+	}
 };
 
 class ValidateMoveState : public FindNextMoveState
@@ -160,8 +222,10 @@ public:
 		const Vector2List& currentPath = GetCurrentPath();
 		int currentPathIndex = GetCurrentPathIndex();
 
-		//has the destination changed
-		Vector2 vDest = currentPath[currentPath.size()-1];
+		//has the destination changed (a path that's still being refined 
+		// doesn't end at it yet)
+		PathCorridor& corridor = GetCurrentCorridor();
+		Vector2 vDest = corridor.IsComplete() ? currentPath[currentPath.size()-1] : corridor.GetGoal();
 		if( vDest == GetCurrentDestination() )
 		{
 			if( theSpatialGraph.CanGo( GetCurrentPosition(), currentPath[currentPathIndex] ) )
@@ -196,6 +260,19 @@ public:
 		const Vector2List& currentPath = GetCurrentPath();
 		int nextPathIndex = GetCurrentPathIndex();
 
+		//Fill in more of a hierarchical path before we can see past the end
+		// of what's there
+		PathCorridor& corridor = GetCurrentCorridor();
+		while( !corridor.IsComplete() && nextPathIndex + iLookAheadCount >= (int)currentPath.size() - 1 )
+		{
+			if( !corridor.RefineNext( GetCurrentPath() ) )
+			{
+				//The graph changed out from under it
+				SetNewState( PathFinder::PFMS_START );
+				return true;
+			}
+		}
+
 		//Are we at our goal index
 		if( nextPathIndex == (int)currentPath.size() - 1 )
 		{
@@ -33,6 +33,7 @@
 
 struct PathFinderMove;
 class FindNextMoveState;
+class PathCorridor;
 
 class PathFinder
 {
@@ -42,6 +43,7 @@ public:
 		PFMR_PATH_NOT_FOUND,
 		PFMR_PATH_FOUND,
 		PFMR_ARRIVED,
+		PFMR_PATH_PENDING,
 	};
 
 	PathFinder();
@@ -62,6 +64,8 @@ public:
 
 	void Render();
 	static void EnableDrawPaths(bool enable);
+	static void EnableAsyncPaths(bool enable);
+	static const bool GetAsyncPaths() {return _asyncPaths;}
 	
 private:
 	void InitializeStates();
@@ -75,12 +79,18 @@ private:
 	Vector2			_currentPos;
 	Vector2			_currentDest;
 	float			_arrivalDist;
+	// A PathRequestHandle, while we're waiting on the PathRequestQueue
+	unsigned int	_pathRequest;
+	Vector2			_pathRequestDest;
+	// The rest of the trip, when the path came from the PathHierarchy
+	PathCorridor*	_corridor;
 
 	FindNextMoveState* _states[PFMS_COUNT];
 
 	friend class FindNextMoveState;
 	
 	static bool _drawPaths;
+	static bool _asyncPaths;
 
 };
 
@@ -101,6 +111,9 @@ protected:
 	const Vector2& GetCurrentDestination() { return _pathFinder->_currentDest; }
 	int& GetCurrentPathIndex() {return _pathFinder->_currentPathIndex; }
 	float GetCurrentArrivalDist() {return _pathFinder->_arrivalDist; }
+	unsigned int& GetCurrentPathRequest() {return _pathFinder->_pathRequest; }
+	Vector2& GetCurrentPathRequestDest() {return _pathFinder->_pathRequestDest; }
+	PathCorridor& GetCurrentCorridor() {return *_pathFinder->_corridor; }
 
 
 	PathFinder*	_pathFinder;
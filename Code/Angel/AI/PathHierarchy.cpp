@@ -0,0 +1,719 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "../AI/PathHierarchy.h"
+
+#include "../Util/MathUtil.h"
+
+#include <algorithm>
+#include <functional>
+#include <chrono>
+
+static double GetHierarchyClockSeconds()
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static unsigned int s_nextSerial = 0;
+
+static bool AreNeighbors( SpatialGraphKDNode* pA, SpatialGraphKDNode* pB )
+{
+	for( unsigned int i = 0; i < pA->Neighbors.size(); i++ )
+	{
+		if( pA->Neighbors[i] == pB )
+			return true;
+	}
+	return false;
+}
+
+static bool HasLineOfSight( SpatialGraphKDNode* pFrom, SpatialGraphKDNode* pTo )
+{
+	for( unsigned int i = 0; i < pFrom->Neighbors.size(); i++ )
+	{
+		if( pFrom->Neighbors[i] == pTo )
+			return pFrom->NeighborLOS[i];
+	}
+	return false;
+}
+
+struct BoundaryEdge
+{
+	int From;
+	int To;
+};
+
+static bool IntersectsAny( const BoundingBox& bbox, const std::vector<BoundingBox>& regions )
+{
+	for( unsigned int i = 0; i < regions.size(); i++ )
+	{
+		if( bbox.Intersects(regions[i]) )
+			return true;
+	}
+	return false;
+}
+
+//An open leaf to step out of a blocked start into
+struct StartExit
+{
+	float DistanceSquared;
+	SpatialGraphKDNode* Node;
+
+	bool operator<( const StartExit& other ) const
+	{
+		if( DistanceSquared != other.DistanceSquared )
+			return DistanceSquared < other.DistanceSquared;
+		return Node->ID < other.Node->ID;
+	}
+};
+
+static int FindGroup( std::vector<int>& groups, int i )
+{
+	while( groups[i] != i )
+	{
+		groups[i] = groups[groups[i]];
+		i = groups[i];
+	}
+	return i;
+}
+
+PathHierarchy::PathHierarchy( SpatialGraph* graph, int clusterDepth )
+: _graph(graph)
+, _clusterDepth(clusterDepth)
+, _serial(++s_nextSerial)
+, _update(1)
+, _stamp(0)
+, _searchExpanded(0)
+{
+	Build( NULL );
+}
+
+void PathHierarchy::Update( const std::vector<BoundingBox>& changed )
+{
+	_update++;
+	Build( &changed );
+}
+
+void PathHierarchy::Build( const std::vector<BoundingBox>* changed )
+{
+	double startTime = GetHierarchyClockSeconds();
+
+	int nodeCount = _graph->GetNodeIdCount();
+	_clusterOf.assign( nodeCount, -1 );
+	_portalOf.assign( nodeCount, -1 );
+	_distances.resize( nodeCount, 0.0f );
+	_stamps.resize( nodeCount, 0 );
+	_portals.clear();
+
+	_stats.NumClusters = 0;
+	_stats.NumClustersSearched = 0;
+	_stats.NumPortalEdges = 0;
+
+	for( unsigned int c = 0; c < _clusters.size(); c++ )
+	{
+		_clusters[c].Found = false;
+	}
+	AssignClusters( _graph->GetRoot(), -1, 0, changed );
+
+	//Whatever wasn't found again got collapsed into (or split up by) 
+	// something else
+	for( unsigned int c = 0; c < _clusters.size(); c++ )
+	{
+		Cluster& cluster = _clusters[c];
+		if( !cluster.Alive || cluster.Found )
+			continue;
+
+		_clusterIds.erase( cluster.Key );
+		_freeClusterIds.push_back( c );
+		cluster.Alive = false;
+		cluster.ChangedAt = _update;
+		cluster.PortalLeaves.clear();
+		cluster.Edges.clear();
+	}
+
+	_clusterPortals.assign( _clusters.size(), std::vector<int>() );
+	FindEntrances();
+
+	for( unsigned int c = 0; c < _clusters.size(); c++ )
+	{
+		if( _clusters[c].Alive )
+			LinkPortals( c );
+	}
+
+	_stats.NumPortals = (int)_portals.size();
+	_stats.BuildSeconds = (float)(GetHierarchyClockSeconds() - startTime);
+}
+
+void PathHierarchy::AssignClusters( SpatialGraphKDNode* node, int cluster, unsigned int pathIndex, const std::vector<BoundingBox>* changed )
+{
+	//Each subtree at the cluster depth (or leaf above it) is a cluster
+	if( cluster < 0 && (node->Depth >= _clusterDepth || !node->HasChildren()) )
+	{
+		cluster = FindCluster( node, pathIndex, changed );
+	}
+
+	if( node->HasChildren() )
+	{
+		AssignClusters( node->LHC, cluster, pathIndex << 1, changed );
+		AssignClusters( node->RHC, cluster, (pathIndex << 1) | 1, changed );
+	}
+	else if( !node->bBlocked )
+	{
+		_clusterOf[node->ID] = cluster;
+	}
+}
+
+int PathHierarchy::FindCluster( SpatialGraphKDNode* node, unsigned int pathIndex, const std::vector<BoundingBox>* changed )
+{
+	_stats.NumClusters++;
+
+	//The tree always splits the same way, so a spot in it covers the same
+	// space however many times it's rebuilt
+	ClusterKey key( node->Depth, pathIndex );
+	std::map<ClusterKey, int>::iterator it = _clusterIds.find( key );
+	if( it != _clusterIds.end() )
+	{
+		Cluster& cluster = _clusters[it->second];
+		cluster.Found = true;
+		if( changed != NULL && IntersectsAny(node->BBox, *changed) )
+			cluster.ChangedAt = _update;
+		return it->second;
+	}
+
+	int id;
+	if( _freeClusterIds.empty() )
+	{
+		id = (int)_clusters.size();
+		_clusters.push_back( Cluster() );
+	}
+	else
+	{
+		id = _freeClusterIds.back();
+		_freeClusterIds.pop_back();
+	}
+	_clusterIds[key] = id;
+
+	Cluster& cluster = _clusters[id];
+	cluster.Key = key;
+	cluster.Alive = true;
+	cluster.Found = true;
+	cluster.ChangedAt = _update;
+	cluster.PortalLeaves.clear();
+	cluster.Edges.clear();
+	return id;
+}
+
+void PathHierarchy::LinkPortals( int c )
+{
+	const std::vector<int>& portals = _clusterPortals[c];
+	Cluster& cluster = _clusters[c];
+
+	std::vector<int> portalLeaves;
+	for( unsigned int i = 0; i < portals.size(); i++ )
+	{
+		portalLeaves.push_back( _portals[portals[i]].LeafId );
+	}
+	std::sort( portalLeaves.begin(), portalLeaves.end() );
+
+	//Nothing inside changed and the portals are where they were, so the 
+	// costs from last time still hold
+	if( cluster.ChangedAt < _update && portalLeaves == cluster.PortalLeaves )
+	{
+		for( unsigned int i = 0; i < cluster.Edges.size(); i++ )
+		{
+			const CachedEdge& cached = cluster.Edges[i];
+			PortalEdge edge;
+			edge.To = _portalOf[cached.ToLeaf];
+			edge.Cost = cached.Cost;
+			_portals[_portalOf[cached.FromLeaf]].Edges.push_back( edge );
+			_stats.NumPortalEdges++;
+		}
+		return;
+	}
+
+	//Work out what it costs to get between every pair of portals in the 
+	// cluster, without leaving it
+	cluster.PortalLeaves.swap( portalLeaves );
+	cluster.Edges.clear();
+	_stats.NumClustersSearched++;
+	for( unsigned int i = 0; i < portals.size(); i++ )
+	{
+		SearchCluster( _portals[portals[i]].LeafId, c, false );
+		for( unsigned int j = 0; j < portals.size(); j++ )
+		{
+			int leafId = _portals[portals[j]].LeafId;
+			if( i == j || _stamps[leafId] != _stamp )
+				continue;
+
+			PortalEdge edge;
+			edge.To = portals[j];
+			edge.Cost = _distances[leafId];
+			_portals[portals[i]].Edges.push_back( edge );
+			_stats.NumPortalEdges++;
+
+			CachedEdge cached;
+			cached.FromLeaf = _portals[portals[i]].LeafId;
+			cached.ToLeaf = leafId;
+			cached.Cost = edge.Cost;
+			cluster.Edges.push_back( cached );
+		}
+	}
+}
+
+bool PathHierarchy::IsUnchangedSince( int leafId, unsigned int update )
+{
+	if( leafId < 0 || leafId >= (int)_clusterOf.size() || _clusterOf[leafId] < 0 )
+		return false;
+
+	//A leaf in a cluster that hasn't changed is the same leaf it was
+	return _clusters[_clusterOf[leafId]].ChangedAt <= update;
+}
+
+void PathHierarchy::FindEntrances()
+{
+	//Collect every open step from one cluster into another, by which two 
+	// clusters it's between
+	std::map< std::pair<int, int>, std::vector<BoundaryEdge> > borders;
+	for( int id = 0; id < _graph->GetNodeIdCount(); id++ )
+	{
+		SpatialGraphKDNode* pNode = _graph->GetNodeById( id );
+		if( pNode == NULL || _clusterOf[id] < 0 )
+			continue;
+
+		for( unsigned int i = 0; i < pNode->Neighbors.size(); i++ )
+		{
+			SpatialGraphKDNode* pNeighbor = pNode->Neighbors[i];
+			if( pNeighbor->bBlocked || !pNode->NeighborLOS[i] )
+				continue;
+			if( _clusterOf[pNeighbor->ID] == _clusterOf[id] )
+				continue;
+
+			BoundaryEdge edge;
+			edge.From = id;
+			edge.To = pNeighbor->ID;
+			borders[std::make_pair(_clusterOf[id], _clusterOf[pNeighbor->ID])].push_back( edge );
+		}
+	}
+
+	std::map< std::pair<int, int>, std::vector<BoundaryEdge> >::iterator it = borders.begin();
+	for( ; it != borders.end(); ++it )
+	{
+		const std::vector<BoundaryEdge>& edges = it->second;
+
+		//Steps whose leaves touch on either side are part of the same 
+		// stretch of open border
+		std::vector<int> groups( edges.size() );
+		for( unsigned int i = 0; i < edges.size(); i++ )
+		{
+			groups[i] = i;
+		}
+		for( unsigned int i = 0; i < edges.size(); i++ )
+		{
+			SpatialGraphKDNode* pFromI = _graph->GetNodeById( edges[i].From );
+			SpatialGraphKDNode* pToI = _graph->GetNodeById( edges[i].To );
+			for( unsigned int j = i + 1; j < edges.size(); j++ )
+			{
+				SpatialGraphKDNode* pFromJ = _graph->GetNodeById( edges[j].From );
+				SpatialGraphKDNode* pToJ = _graph->GetNodeById( edges[j].To );
+				if(    pFromI == pFromJ || pToI == pToJ 
+					|| AreNeighbors( pFromI, pFromJ ) || AreNeighbors( pToI, pToJ ) )
+				{
+					groups[FindGroup( groups, i )] = FindGroup( groups, j );
+				}
+			}
+		}
+
+		//Each stretch gets one entrance, at the step nearest its middle
+		std::vector<Vector2> middles( edges.size(), Vector2(0.0f) );
+		std::vector<int> counts( edges.size(), 0 );
+		for( unsigned int i = 0; i < edges.size(); i++ )
+		{
+			int group = FindGroup( groups, i );
+			Vector2 middle = (_graph->GetNodeById(edges[i].From)->Centroid + _graph->GetNodeById(edges[i].To)->Centroid) * 0.5f;
+			middles[group] += middle;
+			counts[group]++;
+		}
+		std::vector<int> best( edges.size(), -1 );
+		std::vector<float> bestDistances( edges.size(), MathUtil::MaxFloat );
+		for( unsigned int i = 0; i < edges.size(); i++ )
+		{
+			int group = FindGroup( groups, i );
+			Vector2 middle = (_graph->GetNodeById(edges[i].From)->Centroid + _graph->GetNodeById(edges[i].To)->Centroid) * 0.5f;
+			float distance = Vector2::DistanceSquared( middle, middles[group] / (float)counts[group] );
+			if( distance < bestDistances[group] )
+			{
+				bestDistances[group] = distance;
+				best[group] = i;
+			}
+		}
+
+		for( unsigned int i = 0; i < edges.size(); i++ )
+		{
+			if( best[i] < 0 )
+				continue;
+
+			const BoundaryEdge& edge = edges[best[i]];
+			int from = AddPortal( edge.From );
+			int to = AddPortal( edge.To );
+
+			PortalEdge link;
+			link.To = to;
+			link.Cost = Vector2::Distance( _graph->GetNodeById(edge.From)->Centroid, _graph->GetNodeById(edge.To)->Centroid );
+			_portals[from].Edges.push_back( link );
+			_stats.NumPortalEdges++;
+		}
+	}
+}
+
+int PathHierarchy::AddPortal( int leafId )
+{
+	if( _portalOf[leafId] >= 0 )
+		return _portalOf[leafId];
+
+	Portal portal;
+	portal.LeafId = leafId;
+	portal.Cluster = _clusterOf[leafId];
+	_portalOf[leafId] = (int)_portals.size();
+	_portals.push_back( portal );
+	_clusterPortals[portal.Cluster].push_back( _portalOf[leafId] );
+	return _portalOf[leafId];
+}
+
+void PathHierarchy::SearchCluster( int startId, int cluster, bool backward )
+{
+	//Distances only count if they're stamped with this search
+	if( ++_stamp == 0 )
+	{
+		std::fill( _stamps.begin(), _stamps.end(), 0 );
+		_stamp = 1;
+	}
+	_searchExpanded = 0;
+	_open.clear();
+
+	_distances[startId] = 0.0f;
+	_stamps[startId] = _stamp;
+	OpenEntry start;
+	start.F = 0.0f;
+	start.ID = startId;
+	_open.push_back( start );
+
+	while( !_open.empty() )
+	{
+		std::pop_heap( _open.begin(), _open.end(), std::greater<OpenEntry>() );
+		OpenEntry current = _open.back();
+		_open.pop_back();
+
+		//Skip the stale copies left behind when a node got closer
+		if( current.F > _distances[current.ID] )
+			continue;
+		_searchExpanded++;
+
+		SpatialGraphKDNode* pNode = _graph->GetNodeById( current.ID );
+		for( unsigned int i = 0; i < pNode->Neighbors.size(); i++ )
+		{
+			SpatialGraphKDNode* pNeighbor = pNode->Neighbors[i];
+			if( pNeighbor->bBlocked || _clusterOf[pNeighbor->ID] != cluster )
+				continue;
+
+			//Searching backward, it's the neighbor's way to us that has to 
+			// be open
+			bool open = backward ? HasLineOfSight( pNeighbor, pNode ) : (bool)pNode->NeighborLOS[i];
+			if( !open )
+				continue;
+
+			float distance = current.F + Vector2::Distance( pNode->Centroid, pNeighbor->Centroid );
+			if( _stamps[pNeighbor->ID] == _stamp && distance >= _distances[pNeighbor->ID] )
+				continue;
+
+			_distances[pNeighbor->ID] = distance;
+			_stamps[pNeighbor->ID] = _stamp;
+
+			OpenEntry entry;
+			entry.F = distance;
+			entry.ID = pNeighbor->ID;
+			_open.push_back( entry );
+			std::push_heap( _open.begin(), _open.end(), std::greater<OpenEntry>() );
+		}
+	}
+}
+
+bool PathHierarchy::FindCorridor( SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode, const Vector2& goal, PathCorridor& corridor )
+{
+	if( _clusterOf[pSourceNode->ID] >= 0 )
+		return SearchCorridor( pSourceNode, pDestNode, goal, corridor );
+
+	//Starting inside an obstacle's skin puts us in a blocked leaf, which 
+	// belongs to no cluster. Flat A* still steps out of it into any open 
+	// neighbor it can see, so try those, nearest first.
+	std::vector<StartExit> exits;
+	for( unsigned int i = 0; i < pSourceNode->Neighbors.size(); i++ )
+	{
+		SpatialGraphKDNode* pNeighbor = pSourceNode->Neighbors[i];
+		if( pNeighbor->bBlocked || !pSourceNode->NeighborLOS[i] )
+			continue;
+
+		StartExit exit;
+		exit.DistanceSquared = Vector2::DistanceSquared( pSourceNode->Centroid, pNeighbor->Centroid );
+		exit.Node = pNeighbor;
+		exits.push_back( exit );
+	}
+	std::sort( exits.begin(), exits.end() );
+
+	for( unsigned int i = 0; i < exits.size(); i++ )
+	{
+		if( SearchCorridor( exits[i].Node, pDestNode, goal, corridor ) )
+			return true;
+	}
+	corridor.Clear();
+	return false;
+}
+
+bool PathHierarchy::SearchCorridor( SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode, const Vector2& goal, PathCorridor& corridor )
+{
+	double startTime = GetHierarchyClockSeconds();
+
+	corridor.Clear();
+	_stats.AbstractNodesExpanded = 0;
+	_stats.LocalNodesExpanded = 0;
+
+	int sourceCluster = _clusterOf[pSourceNode->ID];
+	int destCluster = _clusterOf[pDestNode->ID];
+	if( sourceCluster < 0 || destCluster < 0 )
+		return false;
+
+	//Find out how far the start is from each portal in its cluster (and 
+	// whether it can just get to the goal without leaving)
+	SearchCluster( pSourceNode->ID, sourceCluster, false );
+	_stats.LocalNodesExpanded += _searchExpanded;
+
+	bool found = false;
+	if( sourceCluster == destCluster && _stamps[pDestNode->ID] == _stamp )
+	{
+		corridor._waypoints.push_back( pSourceNode->ID );
+		if( pDestNode != pSourceNode )
+			corridor._waypoints.push_back( pDestNode->ID );
+		found = true;
+	}
+	else
+	{
+		//The portals are the graph being searched, with the start tacked on
+		// the end; the goal gets checked as each portal comes off
+		int numPortals = (int)_portals.size();
+		int startIndex = numPortals;
+		int goalIndex = numPortals + 1;
+		_costs.assign( numPortals + 2, MathUtil::MaxFloat );
+		_parents.assign( numPortals + 2, -1 );
+		_closed.assign( numPortals + 2, false );
+		_goalCosts.assign( numPortals, MathUtil::MaxFloat );
+
+		_costs[startIndex] = 0.0f;
+		std::vector<OpenEntry> startEntries;
+		const std::vector<int>& sourcePortals = _clusterPortals[sourceCluster];
+		for( unsigned int i = 0; i < sourcePortals.size(); i++ )
+		{
+			int leafId = _portals[sourcePortals[i]].LeafId;
+			if( _stamps[leafId] != _stamp )
+				continue;
+
+			_costs[sourcePortals[i]] = _distances[leafId];
+			_parents[sourcePortals[i]] = startIndex;
+
+			OpenEntry entry;
+			entry.F = _distances[leafId] + Vector2::Distance( _graph->GetNodeById(leafId)->Centroid, pDestNode->Centroid );
+			entry.ID = sourcePortals[i];
+			startEntries.push_back( entry );
+		}
+
+		//And how far each portal in the goal's cluster is from the goal
+		SearchCluster( pDestNode->ID, destCluster, true );
+		_stats.LocalNodesExpanded += _searchExpanded;
+		const std::vector<int>& destPortals = _clusterPortals[destCluster];
+		for( unsigned int i = 0; i < destPortals.size(); i++ )
+		{
+			int leafId = _portals[destPortals[i]].LeafId;
+			if( _stamps[leafId] == _stamp )
+				_goalCosts[destPortals[i]] = _distances[leafId];
+		}
+
+		_open = startEntries;
+		std::make_heap( _open.begin(), _open.end(), std::greater<OpenEntry>() );
+		while( !_open.empty() )
+		{
+			std::pop_heap( _open.begin(), _open.end(), std::greater<OpenEntry>() );
+			int current = _open.back().ID;
+			_open.pop_back();
+
+			if( _closed[current] )
+				continue;
+			_closed[current] = true;
+
+			if( current == goalIndex )
+			{
+				found = true;
+				break;
+			}
+			_stats.AbstractNodesExpanded++;
+
+			if( _goalCosts[current] < MathUtil::MaxFloat )
+			{
+				float cost = _costs[current] + _goalCosts[current];
+				if( cost < _costs[goalIndex] )
+				{
+					_costs[goalIndex] = cost;
+					_parents[goalIndex] = current;
+
+					OpenEntry entry;
+					entry.F = cost;
+					entry.ID = goalIndex;
+					_open.push_back( entry );
+					std::push_heap( _open.begin(), _open.end(), std::greater<OpenEntry>() );
+				}
+			}
+
+			const std::vector<PortalEdge>& edges = _portals[current].Edges;
+			for( unsigned int i = 0; i < edges.size(); i++ )
+			{
+				int next = edges[i].To;
+				float cost = _costs[current] + edges[i].Cost;
+				if( _closed[next] || cost >= _costs[next] )
+					continue;
+
+				_costs[next] = cost;
+				_parents[next] = current;
+
+				OpenEntry entry;
+				entry.F = cost + Vector2::Distance( _graph->GetNodeById(_portals[next].LeafId)->Centroid, pDestNode->Centroid );
+				entry.ID = next;
+				_open.push_back( entry );
+				std::push_heap( _open.begin(), _open.end(), std::greater<OpenEntry>() );
+			}
+		}
+
+		if( found )
+		{
+			std::vector<int> portals;
+			for( int i = _parents[goalIndex]; i != startIndex; i = _parents[i] )
+			{
+				portals.push_back( _portals[i].LeafId );
+			}
+
+			corridor._waypoints.push_back( pSourceNode->ID );
+			for( int i = (int)portals.size() - 1; i >= 0; i-- )
+			{
+				//The start or goal can be a portal itself
+				if( portals[i] != corridor._waypoints.back() )
+					corridor._waypoints.push_back( portals[i] );
+			}
+			if( pDestNode->ID != corridor._waypoints.back() )
+				corridor._waypoints.push_back( pDestNode->ID );
+		}
+	}
+
+	if( found )
+	{
+		corridor._goal = goal;
+		corridor._serial = _serial;
+		corridor._update = _update;
+		corridor._next = 0;
+	}
+
+	_stats.QuerySeconds = (float)(GetHierarchyClockSeconds() - startTime);
+	return found;
+}
+
+bool PathHierarchy::RefineSegment( int fromId, int toId, Vector2List& path )
+{
+	SpatialGraphKDNode* pFrom = _graph->GetNodeById( fromId );
+	SpatialGraphKDNode* pTo = _graph->GetNodeById( toId );
+
+	int cluster = _clusterOf[fromId];
+	if( cluster != _clusterOf[toId] )
+	{
+		//Going through an entrance is just a step between neighbors
+		path.push_back( pTo->Centroid );
+		return true;
+	}
+
+	unsigned int start = (unsigned int)path.size();
+	if( !_refineSearch.FindPathInRegion( _graph, pFrom, pTo, _clusterOf, cluster, path ) )
+		return false;
+	_stats.NumRefines++;
+	_stats.RefineNodesExpanded += _refineSearch.GetNodesExpanded();
+
+	//The search starts with the node we're already at
+	path.erase( path.begin() + start );
+	return true;
+}
+
+
+PathCorridor::PathCorridor()
+: _serial(0)
+, _update(0)
+, _next(0)
+{
+}
+
+void PathCorridor::Clear()
+{
+	_waypoints.clear();
+	_next = 0;
+}
+
+bool PathCorridor::RefineNext( Vector2List& path )
+{
+	if( IsComplete() )
+		return true;
+
+	//Leaf IDs only mean the same thing while the clusters they're in stay
+	// the same, so the rest of the trip has to be through unchanged ones
+	PathHierarchy* hierarchy = theSpatialGraph.GetPathHierarchy();
+	if( hierarchy == NULL || hierarchy->GetSerial() != _serial )
+		return false;
+	for( int i = MathUtil::Max( _next - 1, 0 ); i < (int)_waypoints.size(); i++ )
+	{
+		if( !hierarchy->IsUnchangedSince( _waypoints[i], _update ) )
+			return false;
+	}
+
+	if( _next == 0 )
+	{
+		path.push_back( hierarchy->GetGraph()->GetNodeById(_waypoints[0])->Centroid );
+	}
+	else if( !hierarchy->RefineSegment( _waypoints[_next-1], _waypoints[_next], path ) )
+	{
+		return false;
+	}
+
+	_next++;
+	if( IsComplete() )
+	{
+		path.push_back( _goal );
+	}
+	return true;
+}
@@ -0,0 +1,293 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../AI/SpatialGraph.h"
+#include "../AI/PathSearch.h"
+
+#include <map>
+
+class PathCorridor;
+
+///Counters from the PathHierarchy, for comparing against flat A*
+/** 
+ * The per-query numbers are from the most recent PathHierarchy::FindCorridor;
+ *  compare AbstractNodesExpanded + LocalNodesExpanded (and the refinement 
+ *  that follows) with PathSearch::GetNodesExpanded for the same trip. 
+ */
+struct PathHierarchyStats
+{
+	// For the last build or Update
+	float BuildSeconds;
+	int NumClusters;
+	// Clusters whose portal-to-portal costs had to be searched (again)
+	int NumClustersSearched;
+	// Leaves that sit on an entrance between two clusters
+	int NumPortals;
+	// Links between portals, both across entrances and through clusters
+	int NumPortalEdges;
+	
+	// Portals taken off the open list by the abstract search
+	int AbstractNodesExpanded;
+	// Leaves visited linking the start and goal to their clusters' portals
+	int LocalNodesExpanded;
+	float QuerySeconds;
+	
+	// Running totals for PathCorridor::RefineNext
+	int NumRefines;
+	int RefineNodesExpanded;
+	
+	PathHierarchyStats()
+		: BuildSeconds(0.0f)
+		, NumClusters(0)
+		, NumClustersSearched(0)
+		, NumPortals(0)
+		, NumPortalEdges(0)
+		, AbstractNodesExpanded(0)
+		, LocalNodesExpanded(0)
+		, QuerySeconds(0.0f)
+		, NumRefines(0)
+		, RefineNodesExpanded(0)
+	{
+	}
+};
+
+///An abstract graph over a SpatialGraph, for long paths on big maps (HPA*)
+/** 
+ * The leaves of the SpatialGraph are grouped into clusters (the subtrees 
+ *  of the KD tree a few levels up from the bottom). Wherever two clusters 
+ *  touch, each stretch of open border becomes an entrance with a portal 
+ *  leaf on either side, and the cost of getting between every pair of 
+ *  portals inside a cluster is worked out ahead of time. 
+ * 
+ * A path is then found by searching just the portals, which is far less 
+ *  work than searching every leaf, and turned into real points one cluster
+ *  at a time by a PathCorridor as the agent gets there. The paths aren't 
+ *  always quite as short as flat A* would find, since they have to go 
+ *  through the portals. 
+ * 
+ * Building one from scratch means a search from every portal in every 
+ *  cluster, so it's about as expensive as building the graph itself. When 
+ *  the graph is invalidated, Update only searches the clusters whose 
+ *  leaves changed (or whose portals moved), and corridors that don't pass 
+ *  through any of those stay good. 
+ * 
+ * You don't create these yourself; turn on 
+ *  SpatialGraphManager::EnableHierarchicalPaths and the manager builds one 
+ *  and keeps it up to date. It's only used from the main thread. 
+ */
+class PathHierarchy
+{
+public:
+	PathHierarchy( SpatialGraph* graph, int clusterDepth );
+
+	/**
+	 * Catches up with SpatialGraph::InvalidateRegions. Clusters are known by
+	 *  where they sit in the KD tree, so the ones outside the changed areas
+	 *  keep their IDs and, if their portals are where they were, their 
+	 *  costs. 
+	 * 
+	 * @param changed The areas the graph rebuilt, from 
+	 *   SpatialGraph::GetLastChangedRegions
+	 */
+	void Update( const std::vector<BoundingBox>& changed );
+
+	/**
+	 * Finds the portals to go through to get from one leaf to another, and 
+	 *  starts the corridor off. If the start is blocked (pushed into the 
+	 *  skin of an obstacle, say), the trip starts from the nearest open 
+	 *  neighbor it can see, the way flat A* would step out of it. 
+	 * 
+	 * @param pSourceNode Where to start
+	 * @param pDestNode Where to end up
+	 * @param goal The exact point to finish at, in pDestNode
+	 * @param corridor Set up to refine the trip cluster by cluster
+	 * @return False if there's no way to get there
+	 */
+	bool FindCorridor( SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode, const Vector2& goal, PathCorridor& corridor );
+
+	SpatialGraph* GetGraph() { return _graph; }
+	// Different for every PathHierarchy built, so corridors can tell theirs is gone
+	const unsigned int GetSerial() const { return _serial; }
+	// Goes up with every Update
+	const unsigned int GetUpdateCount() const { return _update; }
+	const PathHierarchyStats& GetStats() const { return _stats; }
+
+private:
+	friend class PathCorridor;
+
+	struct PortalEdge
+	{
+		int To;
+		float Cost;
+	};
+
+	struct Portal
+	{
+		int LeafId;
+		int Cluster;
+		std::vector<PortalEdge> Edges;
+	};
+
+	struct OpenEntry
+	{
+		float F;
+		int ID;
+
+		bool operator>( const OpenEntry& other ) const
+		{
+			if( F != other.F )
+				return F > other.F;
+			return ID > other.ID;
+		}
+	};
+
+	struct CachedEdge
+	{
+		int FromLeaf;
+		int ToLeaf;
+		float Cost;
+	};
+
+	//Depth and path from the root of a cluster's top node
+	typedef std::pair<int, unsigned int> ClusterKey;
+
+	struct Cluster
+	{
+		ClusterKey Key;
+		bool Alive;
+		bool Found;
+		// The Update its leaves last changed in
+		unsigned int ChangedAt;
+		// Its portals' leaves (sorted) and the costs between them, as of 
+		//  the last time they were searched
+		std::vector<int> PortalLeaves;
+		std::vector<CachedEdge> Edges;
+	};
+
+	void Build( const std::vector<BoundingBox>* changed );
+	void AssignClusters( SpatialGraphKDNode* node, int cluster, unsigned int pathIndex, const std::vector<BoundingBox>* changed );
+	int FindCluster( SpatialGraphKDNode* node, unsigned int pathIndex, const std::vector<BoundingBox>* changed );
+	void FindEntrances();
+	void LinkPortals( int cluster );
+	bool SearchCorridor( SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode, const Vector2& goal, PathCorridor& corridor );
+	bool IsUnchangedSince( int leafId, unsigned int update );
+	int AddPortal( int leafId );
+	void SearchCluster( int startId, int cluster, bool backward );
+	bool RefineSegment( int fromId, int toId, Vector2List& path );
+
+	SpatialGraph* _graph;
+	int _clusterDepth;
+	unsigned int _serial;
+	unsigned int _update;
+	PathHierarchyStats _stats;
+
+	// By cluster ID; IDs of clusters that are gone get reused
+	std::vector<Cluster> _clusters;
+	std::map<ClusterKey, int> _clusterIds;
+	std::vector<int> _freeClusterIds;
+
+	// By leaf ID; -1 for blocked leaves
+	std::vector<int> _clusterOf;
+	// By leaf ID; -1 for leaves that aren't portals
+	std::vector<int> _portalOf;
+	std::vector<Portal> _portals;
+	std::vector< std::vector<int> > _clusterPortals;
+
+	// Scratch for SearchCluster, by leaf ID
+	std::vector<float> _distances;
+	std::vector<unsigned int> _stamps;
+	unsigned int _stamp;
+	int _searchExpanded;
+
+	// Scratch for the abstract search, by portal (plus one for the start)
+	std::vector<float> _costs;
+	std::vector<float> _goalCosts;
+	std::vector<int> _parents;
+	std::vector<bool> _closed;
+	std::vector<OpenEntry> _open;
+
+	PathSearch _refineSearch;
+};
+
+///One agent's trip through a PathHierarchy, refined as it goes
+/** 
+ * Holds the leaves the abstract search picked out (the start, the portals 
+ *  along the way, and the goal), and fills in the real path between them 
+ *  one stretch at a time, so an agent that changes its mind partway there 
+ *  never pays for the rest. 
+ * 
+ * The PathFinder keeps one of these when hierarchical paths are turned on.
+ */
+class PathCorridor
+{
+public:
+	PathCorridor();
+
+	void Clear();
+
+	/**
+	 * Find out whether every stretch has been added to the path yet. 
+	 * 
+	 * @return True if the path already reaches the goal (or the corridor is
+	 *   empty)
+	 */
+	const bool IsComplete() const { return _next >= (int)_waypoints.size(); }
+
+	/**
+	 * Where the corridor ends up. 
+	 * 
+	 * @return The goal passed to PathHierarchy::FindCorridor
+	 */
+	const Vector2& GetGoal() const { return _goal; }
+
+	/**
+	 * Adds the next stretch of the trip to the end of a path. The last one
+	 *  ends with the goal point itself. 
+	 * 
+	 * @param path The path so far
+	 * @return False if any cluster still ahead has changed since the 
+	 *   corridor was found (or the stretch is somehow blocked), meaning 
+	 *   it's time for a new path
+	 */
+	bool RefineNext( Vector2List& path );
+
+private:
+	friend class PathHierarchy;
+
+	// Leaf IDs: the start, then portals, then the goal
+	std::vector<int> _waypoints;
+	Vector2 _goal;
+	unsigned int _serial;
+	// The PathHierarchy's update count when we were found
+	unsigned int _update;
+	// The waypoint the next stretch ends at
+	int _next;
+};
@@ -0,0 +1,337 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "../AI/PathRequestQueue.h"
+
+#include "../Util/MathUtil.h"
+
+#include <algorithm>
+#include <chrono>
+
+// How many recent latencies to keep for GetLatencyPercentile
+#define PATH_LATENCY_SAMPLES 256
+
+static double GetQueueClockSeconds()
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+PathRequestQueue* PathRequestQueue::s_PathRequestQueue = NULL;
+
+PathRequestQueue& PathRequestQueue::GetInstance()
+{
+	if( s_PathRequestQueue == NULL )
+	{
+		s_PathRequestQueue = new PathRequestQueue();
+	}
+	return *s_PathRequestQueue;
+}
+
+PathRequestQueue::PathRequestQueue()
+: _nextHandle(1)
+, _lookupGraph(NULL)
+, _lookupRevision(0)
+, _runningJobs(0)
+, _frameBudget(2.0f)
+, _numDeduplicated(0)
+, _nextLatency(0)
+, _worker(NULL)
+, _stopWorker(false)
+{
+}
+
+PathRequestHandle PathRequestQueue::RequestPath( const Vector2& source, const Vector2& dest )
+{
+	PathRequestHandle handle = _nextHandle++;
+	if( _nextHandle == INVALID_PATH_REQUEST )
+		_nextHandle = 1;
+
+	PathRequest& request = _requests[handle];
+	request.Source = source;
+	request.Dest = dest;
+	request.Status = PRS_PENDING;
+	request.StartTime = GetQueueClockSeconds();
+
+	SpatialGraph* graph = theSpatialGraph.GetGraph();
+	if( graph == NULL )
+	{
+		FinishRequest( request, PRS_NOT_FOUND );
+		return handle;
+	}
+
+	SpatialGraphKDNode* pSourceNode = graph->FindNode( source );
+	SpatialGraphKDNode* pDestNode = graph->FindNode( dest );
+	if( pSourceNode == NULL || pDestNode == NULL )
+	{
+		FinishRequest( request, PRS_NOT_FOUND );
+		return handle;
+	}
+
+	if( pSourceNode == pDestNode )
+	{
+		request.Path.push_back( source );
+		request.Path.push_back( dest );
+		FinishRequest( request, PRS_FOUND );
+		return handle;
+	}
+
+	//Node IDs get reused when the graph changes, so only match up 
+	// requests made against the same version of it
+	if( graph != _lookupGraph || graph->GetRevision() != _lookupRevision )
+	{
+		_jobLookup.clear();
+		_lookupGraph = graph;
+		_lookupRevision = graph->GetRevision();
+	}
+
+	NodePair key( pSourceNode->ID, pDestNode->ID );
+	std::map<NodePair, PathJob*>::iterator it = _jobLookup.find( key );
+	if( it != _jobLookup.end() )
+	{
+		it->second->Requests.push_back( handle );
+		_numDeduplicated++;
+		return handle;
+	}
+
+	PathJob* job = new PathJob();
+	job->Key = key;
+	job->Source = source;
+	job->Dest = dest;
+	job->Found = false;
+	job->Requests.push_back( handle );
+	_jobLookup[key] = job;
+
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_queuedJobs.push_back( job );
+	}
+	_wakeCondition.notify_one();
+
+	return handle;
+}
+
+PathRequestQueue::ePathRequestStatus PathRequestQueue::GetResult( PathRequestHandle request, Vector2List& path )
+{
+	hashmap_ns::hash_map<PathRequestHandle, PathRequest>::iterator it = _requests.find( request );
+	if( it == _requests.end() )
+		return PRS_UNKNOWN;
+
+	ePathRequestStatus status = it->second.Status;
+	if( status == PRS_PENDING )
+		return status;
+
+	if( status == PRS_FOUND )
+	{
+		path.insert( path.end(), it->second.Path.begin(), it->second.Path.end() );
+	}
+	_requests.erase( it );
+	return status;
+}
+
+void PathRequestQueue::CancelRequest( PathRequestHandle request )
+{
+	//If its search is still going, FinishJob will just skip it
+	_requests.erase( request );
+}
+
+void PathRequestQueue::EnableWorkerThread( bool enable )
+{
+	if( enable == (_worker != NULL) )
+		return;
+
+	if( enable )
+	{
+		_stopWorker = false;
+		_worker = new std::thread( &PathRequestQueue::WorkerLoop, this );
+	}
+	else
+	{
+		//Anything still queued gets picked up by Update instead
+		Shutdown();
+	}
+}
+
+void PathRequestQueue::Shutdown()
+{
+	if( _worker == NULL )
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_stopWorker = true;
+	}
+	_wakeCondition.notify_all();
+
+	_worker->join();
+	delete _worker;
+	_worker = NULL;
+}
+
+const int PathRequestQueue::GetQueueDepth()
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return (int)_queuedJobs.size() + _runningJobs;
+}
+
+const float PathRequestQueue::GetLatencyPercentile( float percentile )
+{
+	if( _latencies.empty() )
+		return 0.0f;
+
+	std::vector<float> sorted( _latencies );
+	std::sort( sorted.begin(), sorted.end() );
+	percentile = MathUtil::Clamp( percentile, 0.0f, 100.0f );
+	int index = (int)((percentile / 100.0f) * (float)(sorted.size() - 1) + 0.5f);
+	return sorted[index] * 1000.0f;
+}
+
+void PathRequestQueue::Update()
+{
+	//Hand out whatever the worker has finished
+	std::deque<PathJob*> finished;
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		finished.swap( _finishedJobs );
+	}
+	for( unsigned int i = 0; i < finished.size(); i++ )
+	{
+		FinishJob( finished[i] );
+	}
+
+	if( _worker != NULL )
+		return;
+
+	//Otherwise do as much as the budget allows, but always at least one
+	double startTime = GetQueueClockSeconds();
+	while( !_queuedJobs.empty() )
+	{
+		PathJob* job = _queuedJobs.front();
+		_queuedJobs.pop_front();
+
+		RunJob( job, _search );
+		FinishJob( job );
+
+		if( (GetQueueClockSeconds() - startTime) * 1000.0 >= _frameBudget )
+			break;
+	}
+}
+
+void PathRequestQueue::RunJob( PathJob* job, PathSearch& search )
+{
+	job->Found = false;
+	SpatialGraph* graph = theSpatialGraph.GetGraph();
+	if( graph == NULL )
+		return;
+
+	//The graph may have changed since the request was made, so look the
+	// nodes up again
+	SpatialGraphKDNode* pSourceNode = graph->FindNode( job->Source );
+	SpatialGraphKDNode* pDestNode = graph->FindNode( job->Dest );
+	if( pSourceNode == NULL || pDestNode == NULL )
+		return;
+
+	job->Found = search.FindPath( graph, pSourceNode, pDestNode, job->Centroids );
+}
+
+void PathRequestQueue::FinishJob( PathJob* job )
+{
+	for( unsigned int i = 0; i < job->Requests.size(); i++ )
+	{
+		hashmap_ns::hash_map<PathRequestHandle, PathRequest>::iterator it = _requests.find( job->Requests[i] );
+		if( it == _requests.end() )
+			continue;
+
+		PathRequest& request = it->second;
+		if( job->Found )
+		{
+			//Same shape as SpatialGraphManager::GetPath gives back
+			request.Path.reserve( job->Centroids.size() + 2 );
+			request.Path.push_back( request.Source );
+			request.Path.insert( request.Path.end(), job->Centroids.begin(), job->Centroids.end() );
+			request.Path.push_back( request.Dest );
+		}
+		FinishRequest( request, job->Found ? PRS_FOUND : PRS_NOT_FOUND );
+	}
+
+	std::map<NodePair, PathJob*>::iterator it = _jobLookup.find( job->Key );
+	if( it != _jobLookup.end() && it->second == job )
+	{
+		_jobLookup.erase( it );
+	}
+	delete job;
+}
+
+void PathRequestQueue::FinishRequest( PathRequest& request, ePathRequestStatus status )
+{
+	request.Status = status;
+
+	float latency = (float)(GetQueueClockSeconds() - request.StartTime);
+	if( (int)_latencies.size() < PATH_LATENCY_SAMPLES )
+	{
+		_latencies.push_back( latency );
+	}
+	else
+	{
+		_latencies[_nextLatency] = latency;
+	}
+	_nextLatency = (_nextLatency + 1) % PATH_LATENCY_SAMPLES;
+}
+
+void PathRequestQueue::WorkerLoop()
+{
+	PathSearch search;
+	while( true )
+	{
+		PathJob* job = NULL;
+		{
+			std::unique_lock<std::mutex> lock( _mutex );
+			while( !_stopWorker && _queuedJobs.empty() )
+			{
+				_wakeCondition.wait( lock );
+			}
+			if( _stopWorker )
+				return;
+
+			job = _queuedJobs.front();
+			_queuedJobs.pop_front();
+			_runningJobs++;
+		}
+
+		{
+			//Keep the graph from changing out from under the search
+			std::lock_guard<std::mutex> graphLock( theSpatialGraph.GetGraphMutex() );
+			RunJob( job, search );
+		}
+
+		std::lock_guard<std::mutex> lock( _mutex );
+		_runningJobs--;
+		_finishedJobs.push_back( job );
+	}
+}
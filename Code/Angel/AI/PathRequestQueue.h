@@ -0,0 +1,228 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../AI/SpatialGraph.h"
+#include "../AI/PathSearch.h"
+
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//singleton shortcut
+#define thePathRequestQueue PathRequestQueue::GetInstance()
+
+typedef unsigned int PathRequestHandle;
+#define INVALID_PATH_REQUEST 0
+
+///Spreads path searches out over time so a crowd of agents doesn't hitch
+/** 
+ * Instead of running A* the moment it's asked, the PathRequestQueue hands 
+ *  back a handle and works through its queue a little at a time: either a 
+ *  few milliseconds' worth each frame on the main thread, or continuously 
+ *  on a worker thread of its own. Requests between the same pair of 
+ *  SpatialGraph nodes are only searched once, and every requester gets 
+ *  the result. 
+ * 
+ * The PathFinder uses this when PathFinder::EnableAsyncPaths is on; in 
+ *  that case its moves come back as PFMR_PATH_PENDING until the path is 
+ *  ready. 
+ * 
+ * Requests should only be made (and checked on) from the main thread. 
+ * 
+ * Like the World, it uses the singleton pattern; use "thePathRequestQueue"
+ *  to access it. 
+ */
+class PathRequestQueue
+{
+public:
+	enum ePathRequestStatus
+	{
+		PRS_PENDING,
+		PRS_FOUND,
+		PRS_NOT_FOUND,
+		PRS_UNKNOWN,
+	};
+
+	/**
+	 * Used to access the singleton instance of this class. As a shortcut, 
+	 *  you can just use "thePathRequestQueue". 
+	 * 
+	 * @return The singleton
+	 */
+	static PathRequestQueue& GetInstance();
+
+	/**
+	 * Asks for a path. Requests that can be answered right away (no graph,
+	 *  start and end in the same node) are, but the result still comes back
+	 *  through GetResult. 
+	 * 
+	 * @param source Where the path should start
+	 * @param dest Where the path should end
+	 * @return A handle to check on the request with
+	 */
+	PathRequestHandle RequestPath( const Vector2& source, const Vector2& dest );
+
+	/**
+	 * Checks on a request. Once it's come back found or not found, the 
+	 *  request is finished and the handle is no longer valid. 
+	 * 
+	 * @param request The handle from RequestPath
+	 * @param path If the path was found, it's copied in here (the same way
+	 *   SpatialGraphManager::GetPath would fill it out)
+	 * @return Whether the path is still pending, was found, or wasn't; 
+	 *   PRS_UNKNOWN if the handle isn't valid
+	 */
+	ePathRequestStatus GetResult( PathRequestHandle request, Vector2List& path );
+
+	/**
+	 * Drops a request whose result isn't wanted anymore. 
+	 * 
+	 * @param request The handle from RequestPath
+	 */
+	void CancelRequest( PathRequestHandle request );
+
+	/**
+	 * Sets how long the main thread can spend on searches each frame. At 
+	 *  least one search runs per frame no matter what, so the queue always
+	 *  drains. Doesn't matter when the worker thread is on. 
+	 * 
+	 * @param milliseconds The per-frame budget (2 by default)
+	 */
+	void SetFrameBudget( float milliseconds ) { _frameBudget = milliseconds; }
+	const float GetFrameBudget() const { return _frameBudget; }
+
+	/**
+	 * Moves the searches off to a worker thread of their own. Results are 
+	 *  still handed out on the main thread, once per frame. While a search
+	 *  is running, SpatialGraphManager::CreateGraph and InvalidateRegion 
+	 *  wait for it to finish. 
+	 * 
+	 * @param enable Whether to search on a worker thread
+	 */
+	void EnableWorkerThread( bool enable );
+	const bool GetWorkerThreadEnabled() const { return _worker != NULL; }
+
+	/**
+	 * Find out how many distinct searches are waiting to run or running. 
+	 *  Deduplicated requests share a search, so this can be lower than the
+	 *  number of requests. 
+	 * 
+	 * @return The queue depth
+	 */
+	const int GetQueueDepth();
+
+	/**
+	 * Find out how many requests were folded into a search someone else 
+	 *  had already asked for. 
+	 * 
+	 * @return The number of deduplicated requests since startup
+	 */
+	const int GetNumDeduplicated() const { return _numDeduplicated; }
+
+	/**
+	 * Looks at how long recent requests (the last few hundred) took from 
+	 *  RequestPath until their results were ready. 
+	 * 
+	 * @param percentile Which percentile to report, from 0 to 100 (50 for 
+	 *   the median, 99 for the worst of the usual cases)
+	 * @return The latency in milliseconds
+	 */
+	const float GetLatencyPercentile( float percentile );
+
+	/**
+	 * INTERNAL: Called by the World once per frame to run searches on the 
+	 *  main thread and hand out finished results. 
+	 */
+	void Update();
+
+	/**
+	 * INTERNAL: Stops the worker thread. Called by the World when it's 
+	 *  shutting down. 
+	 */
+	void Shutdown();
+
+protected:
+	PathRequestQueue();
+	static PathRequestQueue* s_PathRequestQueue;
+
+private:
+	typedef std::pair<int, int> NodePair;
+
+	struct PathJob
+	{
+		NodePair Key;
+		Vector2 Source;
+		Vector2 Dest;
+		Vector2List Centroids;
+		bool Found;
+		std::vector<PathRequestHandle> Requests;
+	};
+
+	struct PathRequest
+	{
+		Vector2 Source;
+		Vector2 Dest;
+		ePathRequestStatus Status;
+		Vector2List Path;
+		double StartTime;
+	};
+
+	void RunJob( PathJob* job, PathSearch& search );
+	void FinishJob( PathJob* job );
+	void FinishRequest( PathRequest& request, ePathRequestStatus status );
+	void WorkerLoop();
+
+	hashmap_ns::hash_map<PathRequestHandle, PathRequest> _requests;
+	PathRequestHandle _nextHandle;
+
+	// Jobs by their source and dest node IDs, until they're finished
+	std::map<NodePair, PathJob*> _jobLookup;
+	SpatialGraph* _lookupGraph;
+	int _lookupRevision;
+	std::deque<PathJob*> _queuedJobs;
+	std::deque<PathJob*> _finishedJobs;
+	int _runningJobs;
+
+	PathSearch _search;
+	float _frameBudget;
+	int _numDeduplicated;
+
+	// Ring buffer of recent latencies, in seconds
+	std::vector<float> _latencies;
+	int _nextLatency;
+
+	std::thread* _worker;
+	std::mutex _mutex;
+	std::condition_variable _wakeCondition;
+	bool _stopWorker;
+};
@@ -0,0 +1,149 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "../AI/PathSearch.h"
+
+#include <algorithm>
+#include <functional>
+
+PathSearch::PathSearch()
+	: _generation(0)
+	, _nodesExpanded(0)
+{
+}
+
+void PathSearch::Open( int id, int parent, float g, float h )
+{
+	NodeRecord& record = _records[id];
+	record.G = g;
+	record.Parent = parent;
+
+	OpenEntry entry;
+	entry.F = g + h;
+	entry.ID = id;
+	_open.push_back( entry );
+	std::push_heap( _open.begin(), _open.end(), std::greater<OpenEntry>() );
+}
+
+bool PathSearch::FindPath( SpatialGraph* graph, SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode, Vector2List& path )
+{
+	return Search( graph, pSourceNode, pDestNode, NULL, 0, path );
+}
+
+bool PathSearch::FindPathInRegion( SpatialGraph* graph, SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode, const std::vector<int>& regions, int region, Vector2List& path )
+{
+	return Search( graph, pSourceNode, pDestNode, &regions, region, path );
+}
+
+bool PathSearch::Search( SpatialGraph* graph, SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode, const std::vector<int>* regions, int region, Vector2List& path )
+{
+	_nodesExpanded = 0;
+	_open.clear();
+
+	NodeRecord blank;
+	blank.G = 0.0f;
+	blank.Parent = -1;
+	blank.Generation = 0;
+	blank.Closed = false;
+	if( (int)_records.size() < graph->GetNodeIdCount() )
+	{
+		_records.resize( graph->GetNodeIdCount(), blank );
+	}
+
+	//Anything not stamped with this generation hasn't been seen yet
+	if( ++_generation == 0 )
+	{
+		std::fill( _records.begin(), _records.end(), blank );
+		_generation = 1;
+	}
+
+	const Vector2& goal = pDestNode->Centroid;
+	NodeRecord& start = _records[pSourceNode->ID];
+	start.Generation = _generation;
+	start.Closed = false;
+	Open( pSourceNode->ID, -1, 0.0f, Vector2::Distance(pSourceNode->Centroid, goal) );
+
+	while( !_open.empty() )
+	{
+		std::pop_heap( _open.begin(), _open.end(), std::greater<OpenEntry>() );
+		int currentId = _open.back().ID;
+		_open.pop_back();
+
+		//Nodes can be on the open list more than once if a shorter way to
+		// them turned up; only the first one off counts
+		NodeRecord& current = _records[currentId];
+		if( current.Closed )
+			continue;
+		current.Closed = true;
+		_nodesExpanded++;
+
+		SpatialGraphKDNode* pNode = graph->GetNodeById( currentId );
+		if( pNode == pDestNode )
+		{
+			_solution.clear();
+			for( int id = currentId; id != -1; id = _records[id].Parent )
+			{
+				_solution.push_back( id );
+			}
+			for( int i = (int)_solution.size() - 1; i >= 0; i-- )
+			{
+				path.push_back( graph->GetNodeById(_solution[i])->Centroid );
+			}
+			return true;
+		}
+
+		for( unsigned int i = 0; i < pNode->Neighbors.size(); i++ )
+		{
+			SpatialGraphKDNode* pNeighbor = pNode->Neighbors[i];
+			if( pNeighbor->bBlocked || !pNode->NeighborLOS[i] )
+				continue;
+			if( regions != NULL && (*regions)[pNeighbor->ID] != region )
+				continue;
+
+			NodeRecord& neighbor = _records[pNeighbor->ID];
+			float g = current.G + Vector2::Distance( pNode->Centroid, pNeighbor->Centroid );
+			if( neighbor.Generation == _generation )
+			{
+				//The heuristic is consistent, so closed nodes are final
+				if( neighbor.Closed || g >= neighbor.G )
+					continue;
+			}
+			else
+			{
+				neighbor.Generation = _generation;
+				neighbor.Closed = false;
+			}
+
+			Open( pNeighbor->ID, currentId, g, Vector2::Distance(pNeighbor->Centroid, goal) );
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,116 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../AI/SpatialGraph.h"
+
+///A reusable A* search over the leaves of a SpatialGraph
+/** 
+ * Rather than allocating fresh bookkeeping for every query, a PathSearch 
+ *  keeps one record per graph node (looked up by SpatialGraphKDNode::ID) 
+ *  and a binary heap for the open list, and reuses them from one search to
+ *  the next. Records are stamped with the search they belong to, so 
+ *  starting a new search doesn't have to clear anything. 
+ * 
+ * A PathSearch isn't thread-safe, but separate ones can search the same 
+ *  graph at the same time. The SpatialGraphManager keeps one per JobSystem
+ *  thread for SpatialGraphManager::GetPath. 
+ */
+class PathSearch
+{
+public:
+	PathSearch();
+
+	/**
+	 * Finds the shortest path between two leaf nodes, moving from centroid
+	 *  to centroid through neighbors that have line of sight. 
+	 * 
+	 * @param graph The graph the nodes belong to
+	 * @param pSourceNode Where to start
+	 * @param pDestNode Where to end up
+	 * @param path The centroids along the way, from source to dest, are 
+	 *   added to the end of this list
+	 * @return False if there's no way to get there
+	 */
+	bool FindPath( SpatialGraph* graph, SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode, Vector2List& path );
+
+	/**
+	 * Like FindPath, but only goes through nodes in one region, for 
+	 *  searching inside a cluster of the PathHierarchy. 
+	 * 
+	 * @param graph The graph the nodes belong to
+	 * @param pSourceNode Where to start
+	 * @param pDestNode Where to end up
+	 * @param regions The region of every node, by ID
+	 * @param region The region the path has to stay in
+	 * @param path The centroids along the way are added to the end of this
+	 * @return False if there's no way to get there without leaving
+	 */
+	bool FindPathInRegion( SpatialGraph* graph, SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode, const std::vector<int>& regions, int region, Vector2List& path );
+
+	/**
+	 * Find out how much work the last search did. 
+	 * 
+	 * @return The number of nodes taken off the open list
+	 */
+	const int GetNodesExpanded() const { return _nodesExpanded; }
+
+private:
+	struct NodeRecord
+	{
+		float G;
+		int Parent;
+		unsigned int Generation;
+		bool Closed;
+	};
+
+	struct OpenEntry
+	{
+		float F;
+		int ID;
+
+		bool operator>( const OpenEntry& other ) const
+		{
+			//Break ties by ID so results don't depend on heap order
+			if( F != other.F )
+				return F > other.F;
+			return ID > other.ID;
+		}
+	};
+
+	bool Search( SpatialGraph* graph, SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode, const std::vector<int>* regions, int region, Vector2List& path );
+	void Open( int id, int parent, float g, float h );
+
+	std::vector<NodeRecord> _records;
+	std::vector<OpenEntry> _open;
+	std::vector<int> _solution;
+	unsigned int _generation;
+	int _nodesExpanded;
+};
@@ -36,6 +36,8 @@
 Sentient::Sentient()
 {
 	_brain.SetActor(this);
+	// Our debug drawing goes on top of our own sprite
+	SetBatchable(false);
 }
 
 
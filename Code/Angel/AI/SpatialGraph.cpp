@@ -32,12 +32,17 @@
 
 #include "../Infrastructure/TextRendering.h"
 #include "../Infrastructure/World.h"
+#include "../AI/PathSearch.h"
+#include "../AI/PathHierarchy.h"
 #include "../AI/Ray2.h"
 #include "../Util/DrawUtil.h"
 #include "../Util/StringUtil.h"
 #include "../Util/MathUtil.h"
+#include "../Infrastructure/JobSystem.h"
+#include "../Infrastructure/Log.h"
 
 #include <Box2D/Box2D.h>
+#include <chrono>
 
 void SpatialGraphKDNode::Render()
 {
@@ -64,7 +69,7 @@ void SpatialGraphKDNode::Render()
 	}
 
 
-	Vector2 centroid = BBox.Centroid();
+	Vector2 centroid = Centroid;
 
 	if( theSpatialGraph.GetDrawNodeIndex() )
 	{
@@ -87,7 +92,7 @@ void SpatialGraphKDNode::Render()
 				continue;
 
 			//draw centroid to centroid half way point
-			Vector2 neighbor = Neighbors[i]->BBox.Centroid();
+			Vector2 neighbor = Neighbors[i]->Centroid;
 			neighbor = centroid + ((neighbor - centroid) * 0.6f);
 			
 			linePoints[0] = centroid.X;
@@ -161,9 +166,201 @@ void SpatialGraphKDNode::GetGridPoints( Vector2List& points, int& xPoints, int&
 }
 
 
+// A physics fixture copied out into world space, so the tree can be built 
+//  without touching the physics world -- and from more than one thread. 
+struct SpatialGraphObstacle
+{
+	// Already grown by Radius
+	BoundingBox Bounds;
+	b2Shape::Type Type;
+	b2Vec2 Vertices[b2_maxPolygonVertices];
+	b2Vec2 Normals[b2_maxPolygonVertices];
+	int VertexCount;
+	b2Vec2 Center;
+	// The shape's skin (or circle radius) plus the skin Box2D would give a 
+	//  polygon made from the node's box, so results match b2Collide*
+	float Radius;
+};
+
+static bool MakeObstacle( b2Fixture* fixture, SpatialGraphObstacle& obstacle )
+{
+	obstacle.Type = fixture->GetType();
+	const b2Transform& xf = fixture->GetBody()->GetTransform();
+
+	if( obstacle.Type == b2Shape::e_polygon )
+	{
+		b2PolygonShape* pPolyShape = (b2PolygonShape*)fixture->GetShape();
+		obstacle.VertexCount = pPolyShape->m_vertexCount;
+		obstacle.Radius = pPolyShape->m_radius + b2_polygonRadius;
+		b2Vec2 lower( MathUtil::MaxFloat, MathUtil::MaxFloat );
+		b2Vec2 upper( -MathUtil::MaxFloat, -MathUtil::MaxFloat );
+		for( int i = 0; i < obstacle.VertexCount; i++ )
+		{
+			obstacle.Vertices[i] = b2Mul( xf, pPolyShape->m_vertices[i] );
+			obstacle.Normals[i] = b2Mul( xf.q, pPolyShape->m_normals[i] );
+			lower = b2Min( lower, obstacle.Vertices[i] );
+			upper = b2Max( upper, obstacle.Vertices[i] );
+		}
+		obstacle.Bounds = BoundingBox( Vector2(lower.x, lower.y), Vector2(upper.x, upper.y) );
+	}
+	else if( obstacle.Type == b2Shape::e_circle )
+	{
+		b2CircleShape* pCircleShape = (b2CircleShape*)fixture->GetShape();
+		obstacle.VertexCount = 0;
+		obstacle.Center = b2Mul( xf, pCircleShape->m_p );
+		obstacle.Radius = pCircleShape->m_radius + b2_polygonRadius;
+		obstacle.Bounds = BoundingBox( Vector2(obstacle.Center.x, obstacle.Center.y), Vector2(obstacle.Center.x, obstacle.Center.y) );
+	}
+	else
+	{
+		//Edges and chains never blocked anything before either
+		return false;
+	}
+
+	obstacle.Bounds.Min -= Vector2( obstacle.Radius );
+	obstacle.Bounds.Max += Vector2( obstacle.Radius );
+	return true;
+}
+
+//Assumes the obstacle's bounds already overlap the box
+static bool ObstacleOverlaps( const BoundingBox& bbox, const SpatialGraphObstacle& obstacle )
+{
+	if( obstacle.Type == b2Shape::e_circle )
+	{
+		//Distance from the center to the closest point in the box
+		float dx = obstacle.Center.x - MathUtil::Clamp( obstacle.Center.x, bbox.Min.X, bbox.Max.X );
+		float dy = obstacle.Center.y - MathUtil::Clamp( obstacle.Center.y, bbox.Min.Y, bbox.Max.Y );
+		return (dx * dx) + (dy * dy) <= obstacle.Radius * obstacle.Radius;
+	}
+
+	//The box's own axes were covered by the bounds check, so only the 
+	// polygon's faces can still separate them
+	for( int i = 0; i < obstacle.VertexCount; i++ )
+	{
+		const b2Vec2& normal = obstacle.Normals[i];
+		b2Vec2 deepest( normal.x > 0.0f ? bbox.Min.X : bbox.Max.X, normal.y > 0.0f ? bbox.Min.Y : bbox.Max.Y );
+		if( b2Dot( normal, deepest - obstacle.Vertices[i] ) > obstacle.Radius )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static b2AABB ToPhysicsBounds( const BoundingBox& bounds )
+{
+	b2AABB physBounds;
+	physBounds.lowerBound = b2Vec2( bounds.Min.X, bounds.Min.Y );
+	physBounds.upperBound = b2Vec2( bounds.Max.X, bounds.Max.Y );
+	return physBounds;
+}
+
+class SpatialGraphBuilder : public b2QueryCallback
+{
+public:
+	SpatialGraphBuilder( const BoundingBox& bounds )
+	{
+		theWorld.GetPhysicsWorld().QueryAABB(this, ToPhysicsBounds(bounds));
+
+		AllObstacles.resize(Obstacles.size());
+		for( unsigned int i = 0; i < Obstacles.size(); i++ )
+		{
+			AllObstacles[i] = i;
+		}
+	}
+
+	bool ReportFixture(b2Fixture* fixture)
+	{
+		SpatialGraphObstacle obstacle;
+		if( MakeObstacle( fixture, obstacle ) )
+		{
+			Obstacles.push_back( obstacle );
+		}
+		return true;
+	}
+
+	/**
+	 * Tests a node's box against the obstacles that overlapped its parent. 
+	 *  Any whose bounds overlap this box are written to overlapping, since
+	 *  those are the only ones the node's children could hit. 
+	 */
+	bool IsBlocked( const BoundingBox& bbox, const std::vector<int>& candidates, std::vector<int>& overlapping ) const
+	{
+		bool blocked = false;
+		for( unsigned int i = 0; i < candidates.size(); i++ )
+		{
+			const SpatialGraphObstacle& obstacle = Obstacles[candidates[i]];
+			if( !obstacle.Bounds.Intersects( bbox ) )
+			{
+				continue;
+			}
+
+			overlapping.push_back( candidates[i] );
+			if( !blocked )
+			{
+				blocked = ObstacleOverlaps( bbox, obstacle );
+			}
+		}
+		return blocked;
+	}
+
+	std::vector<SpatialGraphObstacle> Obstacles;
+	std::vector<int> AllObstacles;
+};
+
+//A one-off blocked test that stops at the first shape it hits, for big 
+// nodes where copying out every fixture would be a waste
+class SpatialGraphBlockedQuery : public b2QueryCallback
+{
+public:
+	SpatialGraphBlockedQuery( const BoundingBox& bbox )
+		: Blocked(false)
+		, _bbox(bbox)
+	{
+		theWorld.GetPhysicsWorld().QueryAABB(this, ToPhysicsBounds(bbox));
+	}
+
+	bool ReportFixture(b2Fixture* fixture)
+	{
+		SpatialGraphObstacle obstacle;
+		if( MakeObstacle( fixture, obstacle ) && obstacle.Bounds.Intersects( _bbox ) && ObstacleOverlaps( _bbox, obstacle ) )
+		{
+			Blocked = true;
+			return false;
+		}
+		return true;
+	}
+
+	bool Blocked;
+
+private:
+	BoundingBox _bbox;
+};
+
+//Graphs are only built and changed with the graph mutex held
+static int s_lastRevision = 0;
+
+static int NextRevision()
+{
+	return ++s_lastRevision;
+}
+
+static double GetBuildClockSeconds()
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+struct SubtreeJobContext
+{
+	SpatialGraph* Graph;
+	SpatialGraphBuilder* Builder;
+	void* Jobs;
+};
+
 SpatialGraph::SpatialGraph(float entityWidth, const BoundingBox& startBox )
 {
 	_entityWidth = entityWidth;
+	_revision = NextRevision();
 	float maxDimension = MathUtil::Max( startBox.Max.Y - startBox.Min.Y, startBox.Max.X - startBox.Min.X );
 	int depth = 0;
 	while( maxDimension > _entityWidth )
@@ -182,8 +379,6 @@ SpatialGraph::SpatialGraph(float entityWidth, const BoundingBox& startBox )
 	_dirMasks[2] = 0xaaaaaaaa & depthMask;
 	_dirMasks[3] = _dirMasks[2] >> 1;
 
-	_root = CreateTree(_depth+1, startBox, NULL);
-
 	//Get smallest dimension
 	_smallestDimensions = startBox.Max - startBox.Min;
 	for( int i = 0; i < _depth; i++ )
@@ -194,8 +389,58 @@ SpatialGraph::SpatialGraph(float entityWidth, const BoundingBox& startBox )
 			_smallestDimensions.X *= 0.5f;
 	}
 
-	ComputeNeighbors( _root );
-	ValidateNeighbors( _root );
+	double startTime = GetBuildClockSeconds();
+
+	//Copy the physics shapes out once, rather than querying Box2D per node
+	SpatialGraphBuilder builder( startBox );
+	_buildStats.NumObstacles = (int)builder.Obstacles.size();
+
+	//Build the top of the tree here, and hand the subtrees below it to the 
+	// JobSystem -- aim for a few per thread so uneven ones balance out
+	int numThreads = theJobSystem.GetThreadCount();
+	std::vector<SubtreeJob> subtreeJobs;
+	_visits.resize( numThreads );
+	_jobDepth = 0;
+	while( (1 << _jobDepth) < numThreads * 8 )
+	{
+		_jobDepth++;
+	}
+	_root = CreateTree(builder, _depth+1, startBox, builder.AllObstacles, NULL, 0, numThreads > 1 ? &subtreeJobs : NULL);
+	if( !subtreeJobs.empty() )
+	{
+		SubtreeJobContext context;
+		context.Graph = this;
+		context.Builder = &builder;
+		context.Jobs = &subtreeJobs;
+		theJobSystem.ParallelFor( (int)subtreeJobs.size(), 1, BuildSubtreesJob, &context );
+		PruneFullyBlocked( _root, _jobDepth );
+	}
+	_buildStats.NumSubtreeJobs = (int)subtreeJobs.size();
+	BuildFlatTree();
+
+	double treeTime = GetBuildClockSeconds();
+	_buildStats.TreeSeconds = (float)(treeTime - startTime);
+
+	//Each leaf only writes its own neighbor lists, so they can all go at once
+	SpatialGraphNeighborList leaves;
+	GatherLeaves( _root, NULL, leaves );
+	_buildStats.NumLeaves = (int)leaves.size();
+	//Every split makes exactly two children
+	_buildStats.NumNodes = (2 * _buildStats.NumLeaves) - 1;
+	for( unsigned int i = 0; i < leaves.size(); i++ )
+	{
+		AssignNodeId( leaves[i] );
+		if( leaves[i]->bBlocked )
+			_buildStats.NumBlockedLeaves++;
+	}
+	theJobSystem.ParallelFor( (int)leaves.size(), 64, ComputeNeighborsJob, &leaves );
+
+	double neighborTime = GetBuildClockSeconds();
+	_buildStats.NeighborSeconds = (float)(neighborTime - treeTime);
+
+	theJobSystem.ParallelFor( (int)leaves.size(), 64, ValidateNeighborsJob, &leaves );
+
+	_buildStats.ValidateSeconds = (float)(GetBuildClockSeconds() - neighborTime);
 }
 
 SpatialGraph::~SpatialGraph()
@@ -211,6 +456,12 @@ void SpatialGraph::DeleteNode( SpatialGraphKDNode* pNode )
 	DeleteNode( pNode->LHC );
 	DeleteNode( pNode->RHC );
 
+	if( pNode->ID >= 0 )
+	{
+		_nodesById[pNode->ID] = NULL;
+		_freeNodeIds.push_back( pNode->ID );
+	}
+
 	delete pNode;
 }
 
@@ -268,106 +519,111 @@ SpatialGraphKDNode* SpatialGraph::FindNode(const BoundingBox& bbox)
 
 SpatialGraphKDNode* SpatialGraph::FindNode(const Vector2& point)
 {
-	return FindNode(_root, point);
-}
+	if( _flatTree.empty() )
+		return FindNode(_root, point);
 
-void SpatialGraph::Render()
-{
-	bool bDrawAny = theSpatialGraph.GetDrawBounds() || theSpatialGraph.GetDrawGridPoints() || theSpatialGraph.GetDrawGraph() || theSpatialGraph.GetDrawBlocked();
+	if( !_root->BBox.Contains(point) )
+		return NULL;
 
-	if( bDrawAny && _root)
+	//A leaf's Index is its path down the tree, one bit per split, so the 
+	// point's cell at full depth says which way to go at every level 
+	// without comparing against the splits
+	unsigned int cell[2];
+	cell[0] = MathUtil::Min( (unsigned int)((point.X - _root->BBox.Min.X) * _cellScale.X), _cellCounts[0] - 1 );
+	cell[1] = MathUtil::Min( (unsigned int)((point.Y - _root->BBox.Min.Y) * _cellScale.Y), _cellCounts[1] - 1 );
+
+	int i = 0;
+	while( _flatTree[i].Child >= 0 )
 	{
-		_root->Render();
+		const FlatNode& flat = _flatTree[i];
+		i = flat.Child + ((cell[flat.Axis] >> flat.Shift) & 1);
 	}
-}
 
-const int __maxFixtureCount = 1024;
-b2Fixture* __spatialGraphTempFixtures[__maxFixtureCount];
-int __spatialGraphNumFixtures = 0;
+	//Points right on a split belong to the left side, which rounding 
+	// can't promise, so those (and anything float error pushed out) take 
+	// the split planes down instead
+	const BoundingBox& leafBox = _flatTree[i].Node->BBox;
+	if(    point.X > leafBox.Min.X || leafBox.Min.X == _root->BBox.Min.X )
+	{
+		if( point.Y > leafBox.Min.Y || leafBox.Min.Y == _root->BBox.Min.Y )
+		{
+			if( point.X <= leafBox.Max.X && point.Y <= leafBox.Max.Y )
+				return _flatTree[i].Node;
+		}
+	}
 
-bool SpatialGraphManager::ReportFixture(b2Fixture* fixture)
-{
-	if (__spatialGraphNumFixtures >= __maxFixtureCount - 1)
+	const float coords[2] = { point.X, point.Y };
+	i = 0;
+	while( _flatTree[i].Child >= 0 )
 	{
-		return false;
+		const FlatNode& flat = _flatTree[i];
+		i = flat.Child + (coords[flat.Axis] > flat.Split ? 1 : 0);
 	}
-	__spatialGraphTempFixtures[__spatialGraphNumFixtures++] = fixture;
-	return true;
+	return _flatTree[i].Node;
 }
 
-bool IsBlocked( const BoundingBox& bbox )
+void SpatialGraph::BuildFlatTree()
 {
-	
-	b2AABB physBounds;
-	physBounds.lowerBound = b2Vec2( bbox.Min.X, bbox.Min.Y ); 
-	physBounds.upperBound = b2Vec2( bbox.Max.X, bbox.Max.Y );
-	
-	__spatialGraphNumFixtures = 0;
-	theWorld.GetPhysicsWorld().QueryAABB(&theSpatialGraph, physBounds);
-
-	//No bodies here
-	if( __spatialGraphNumFixtures == 0 )
-		return false;
-
-	b2PolygonShape shapeBoundsPoly;
-	b2Vec2 vertices[4];
-	vertices[0].Set( physBounds.lowerBound.x, physBounds.lowerBound.y );
-	vertices[1].Set( physBounds.upperBound.x, physBounds.lowerBound.y );
-	vertices[2].Set( physBounds.upperBound.x, physBounds.upperBound.y );
-	vertices[3].Set( physBounds.lowerBound.x, physBounds.upperBound.y );
-	shapeBoundsPoly.Set(vertices, 4);
-
-	b2BodyDef fakeBodyDef;
-	//b2Vec2 center = physBounds.lowerBound + (0.5f * shapeBoundsDef.extents);
-	fakeBodyDef.position.Set(0.0f, 0.0f );
-	b2Body* fakeBody = theWorld.GetPhysicsWorld().CreateBody(&fakeBodyDef);
-	b2FixtureDef fakeFixtureDef;
-	fakeFixtureDef.shape = &shapeBoundsPoly;
-	b2Fixture* shapeBounds = fakeBody->CreateFixture(&fakeFixtureDef);
-	
-	for( int i = 0; i < __spatialGraphNumFixtures; i++ )
-	{
-		b2Fixture* pFix = __spatialGraphTempFixtures[i];
-		if( pFix->GetType() == b2Shape::e_polygon  )
-		{
-			b2PolygonShape* pPolyShape = (b2PolygonShape*)pFix->GetShape();
+	//Work out which bit of the cell coordinates each depth splits on; 
+	// the axes alternate, counting down from the bottom of the tree
+	std::vector<int> shifts( _depth, 0 );
+	int counts[2] = { 0, 0 };
+	for( int depth = _depth - 1; depth >= 0; depth-- )
+	{
+		int axis = ((_depth - depth) % 2) ? 0 : 1;
+		shifts[depth] = counts[axis]++;
+	}
+	_cellCounts[0] = 1 << counts[0];
+	_cellCounts[1] = 1 << counts[1];
+	Vector2 rootSize = _root->BBox.Max - _root->BBox.Min;
+	_cellScale = Vector2( _cellCounts[0] / rootSize.X, _cellCounts[1] / rootSize.Y );
+
+	//Breadth first, so siblings always land next to each other
+	_flatTree.clear();
+	FlatNode flat;
+	flat.Split = 0.0f;
+	flat.Child = -1;
+	flat.Axis = 0;
+	flat.Shift = 0;
+	flat.Node = _root;
+	_flatTree.push_back( flat );
+	for( unsigned int i = 0; i < _flatTree.size(); i++ )
+	{
+		SpatialGraphKDNode* node = _flatTree[i].Node;
+		if( !node->HasChildren() )
+			continue;
 
-			b2Manifold m0;
-			b2CollidePolygons(&m0, (b2PolygonShape*)shapeBounds->GetShape(), fakeBody->GetTransform(), pPolyShape, pFix->GetBody()->GetTransform());
+		int axis = ((_depth - node->Depth) % 2) ? 0 : 1;
+		_flatTree[i].Axis = axis;
+		_flatTree[i].Shift = shifts[node->Depth];
+		_flatTree[i].Split = axis == 0 ? node->LHC->BBox.Max.X : node->LHC->BBox.Max.Y;
+		_flatTree[i].Child = (int)_flatTree.size();
 
-			if( m0.pointCount > 0 )
-			{
-				theWorld.GetPhysicsWorld().DestroyBody(fakeBody);
-				return true;	
-			}
-		}
-		else if( pFix->GetType() == b2Shape::e_circle )
-		{
-			b2CircleShape* pCircleShape = (b2CircleShape*)pFix->GetShape();
-			b2Manifold m0;
-			b2CollidePolygonAndCircle( &m0, (b2PolygonShape*)shapeBounds->GetShape(), fakeBody->GetTransform(), pCircleShape, pFix->GetBody()->GetTransform());
-			if( m0.pointCount > 0 )
-			{
-				theWorld.GetPhysicsWorld().DestroyBody(fakeBody);
-				return true;				
-			}
-		}
+		flat.Node = node->LHC;
+		_flatTree.push_back( flat );
+		flat.Node = node->RHC;
+		_flatTree.push_back( flat );
 	}
+}
 
-	theWorld.GetPhysicsWorld().DestroyBody(fakeBody);
-
-	return false;
+void SpatialGraph::Render()
+{
+	bool bDrawAny = theSpatialGraph.GetDrawBounds() || theSpatialGraph.GetDrawGridPoints() || theSpatialGraph.GetDrawGraph() || theSpatialGraph.GetDrawBlocked();
 
+	if( bDrawAny && _root)
+	{
+		_root->Render();
+	}
 }
 
-SpatialGraphKDNode* SpatialGraph::CreateTree(int depth, const BoundingBox& bbox, SpatialGraphKDNode* parent, int index)
+SpatialGraphKDNode* SpatialGraph::CreateTree(SpatialGraphBuilder& builder, int depth, const BoundingBox& bbox, const std::vector<int>& obstacles, SpatialGraphKDNode* parent, int index, std::vector<SubtreeJob>* deferred)
 {
 	SpatialGraphKDNode* node = new SpatialGraphKDNode(bbox, parent);
 	node->Tree = this;
-	node->bBlocked = false;
 
-	//query physics to see if we're blocked
-	node->bBlocked = IsBlocked( bbox );
+	//check the physics shapes to see if we're blocked
+	std::vector<int> overlapping;
+	node->bBlocked = builder.IsBlocked( bbox, obstacles, overlapping );
 
 	//Calculate my index
 	if( parent )
@@ -384,26 +640,256 @@ SpatialGraphKDNode* SpatialGraph::CreateTree(int depth, const BoundingBox& bbox,
 	node->Depth = _depth - depth;
 	if (depth > 0 && node->bBlocked )
 	{
-		BoundingBox LHSbbox, RHSbbox;
-		MathUtil::SplitBoundingBox( bbox, depth % 2 ? MathUtil::AA_X : MathUtil::AA_Y, LHSbbox, RHSbbox );
-		node->LHC = CreateTree(depth, LHSbbox, node, node->Index << 1);
-		node->RHC = CreateTree(depth, RHSbbox, node, (node->Index << 1) + 1);
+		if( deferred != NULL && node->Depth >= _jobDepth )
+		{
+			SubtreeJob job;
+			job.Node = node;
+			job.Depth = depth;
+			deferred->push_back( job );
+			deferred->back().Obstacles.swap( overlapping );
+		}
+		else
+		{
+			CreateChildren( builder, node, depth, overlapping, deferred );
+		}
+	}
+
+	return node;
+}
+
+void SpatialGraph::CreateChildren(SpatialGraphBuilder& builder, SpatialGraphKDNode* node, int depth, const std::vector<int>& obstacles, std::vector<SubtreeJob>* deferred)
+{
+	BoundingBox LHSbbox, RHSbbox;
+	MathUtil::SplitBoundingBox( node->BBox, depth % 2 ? MathUtil::AA_X : MathUtil::AA_Y, LHSbbox, RHSbbox );
+	node->LHC = CreateTree(builder, depth, LHSbbox, obstacles, node, node->Index << 1, deferred);
+	node->RHC = CreateTree(builder, depth, RHSbbox, obstacles, node, (node->Index << 1) + 1, deferred);
+
+	int iMask = ~(0xFFFFFFFF << depth );
+	//If I have children, pad my index
+	node->Index = (node->Index << depth) | iMask;
+
+	//If all my children are blocked, then destroy my children (unless 
+	// some of them are still waiting on jobs; PruneFullyBlocked gets 
+	// those once they're done)
+	if( deferred == NULL && IsFullyBlocked(node) )
+	{
+		DeleteNode( node->LHC );
+		node->LHC = NULL;
+		DeleteNode( node->RHC );
+		node->RHC = NULL;
+	}
+}
+
+void SpatialGraph::PruneFullyBlocked( SpatialGraphKDNode* node, int maxDepth )
+{
+	if( node == NULL || !node->HasChildren() || node->Depth >= maxDepth )
+		return;
+
+	PruneFullyBlocked( node->LHC, maxDepth );
+	PruneFullyBlocked( node->RHC, maxDepth );
+
+	if( IsFullyBlocked(node) )
+	{
+		DeleteNode( node->LHC );
+		node->LHC = NULL;
+		DeleteNode( node->RHC );
+		node->RHC = NULL;
+	}
+}
+
+void SpatialGraph::BuildSubtreesJob( void* context, int begin, int end )
+{
+	SubtreeJobContext* jobContext = (SubtreeJobContext*)context;
+	std::vector<SubtreeJob>& jobs = *(std::vector<SubtreeJob>*)jobContext->Jobs;
+	for( int i = begin; i < end; i++ )
+	{
+		jobContext->Graph->CreateChildren( *jobContext->Builder, jobs[i].Node, jobs[i].Depth, jobs[i].Obstacles, NULL );
+	}
+}
+
+void SpatialGraph::ComputeNeighborsJob( void* context, int begin, int end )
+{
+	SpatialGraphNeighborList& leaves = *(SpatialGraphNeighborList*)context;
+	for( int i = begin; i < end; i++ )
+	{
+		leaves[i]->Tree->ComputeNeighbors( leaves[i] );
+	}
+}
 
-		int iMask = ~(0xFFFFFFFF << depth );
-		//If I have children, pad my index
-		node->Index = (node->Index << depth) | iMask;
+void SpatialGraph::ValidateNeighborsJob( void* context, int begin, int end )
+{
+	SpatialGraphNeighborList& leaves = *(SpatialGraphNeighborList*)context;
+	for( int i = begin; i < end; i++ )
+	{
+		leaves[i]->Tree->ValidateNeighbors( leaves[i] );
+	}
+}
 
-		//If all my children are blocked, then destroy my children
-		if( IsFullyBlocked(node) )
+static bool IntersectsAny( const BoundingBox& bbox, const std::vector<BoundingBox>& regions )
+{
+	for( unsigned int i = 0; i < regions.size(); i++ )
+	{
+		if( bbox.Intersects(regions[i]) )
+			return true;
+	}
+	return false;
+}
+
+void SpatialGraph::GatherLeaves( SpatialGraphKDNode* node, const std::vector<BoundingBox>* within, SpatialGraphNeighborList& leaves )
+{
+	if( within != NULL && !IntersectsAny(node->BBox, *within) )
+		return;
+
+	if( node->HasChildren() )
+	{
+		GatherLeaves( node->LHC, within, leaves );
+		GatherLeaves( node->RHC, within, leaves );
+		return;
+	}
+
+	leaves.push_back( node );
+}
+
+void SpatialGraph::AssignNodeId( SpatialGraphKDNode* node )
+{
+	if( _freeNodeIds.empty() )
+	{
+		node->ID = (int)_nodesById.size();
+		_nodesById.push_back( node );
+	}
+	else
+	{
+		node->ID = _freeNodeIds.back();
+		_freeNodeIds.pop_back();
+		_nodesById[node->ID] = node;
+	}
+}
+
+int GetPathIndex( SpatialGraphKDNode* node )
+{
+	//One bit per level, set when we went right
+	int index = 0;
+	int bit = 0;
+	for( ; node->Parent != NULL; node = node->Parent )
+	{
+		if( node->Parent->RHC == node )
+			index |= 1 << bit;
+		bit++;
+	}
+	return index;
+}
+
+void SpatialGraph::FindInvalidSubtrees( SpatialGraphKDNode* node, const std::vector<BoundingBox>& regions, SpatialGraphNeighborList& subtrees, SpatialGraphNeighborList& ancestors )
+{
+	if( !IntersectsAny(node->BBox, regions) )
+		return;
+
+	bool within = !node->HasChildren();
+	for( unsigned int i = 0; i < regions.size() && !within; i++ )
+	{
+		within = (regions[i].Contains(node->BBox) == Within);
+	}
+	if( within )
+	{
+		subtrees.push_back( node );
+		return;
+	}
+
+	ancestors.push_back( node );
+	FindInvalidSubtrees( node->LHC, regions, subtrees, ancestors );
+	FindInvalidSubtrees( node->RHC, regions, subtrees, ancestors );
+}
+
+void SpatialGraph::InvalidateRegion( const BoundingBox& region )
+{
+	InvalidateRegions( std::vector<BoundingBox>(1, region) );
+}
+
+void SpatialGraph::InvalidateRegions( const std::vector<BoundingBox>& regions )
+{
+	double startTime = GetBuildClockSeconds();
+	_changedRegions.clear();
+
+	//Shapes block anything within their skin, so look a little past the edges
+	Vector2 skin( 2.0f * b2_polygonRadius );
+	std::vector<BoundingBox> grownRegions;
+	for( unsigned int i = 0; i < regions.size(); i++ )
+	{
+		grownRegions.push_back( BoundingBox(regions[i].Min - skin, regions[i].Max + skin) );
+	}
+
+	SpatialGraphNeighborList subtrees;
+	SpatialGraphNeighborList ancestors;
+	FindInvalidSubtrees( _root, grownRegions, subtrees, ancestors );
+	if( subtrees.empty() )
+		return;
+
+	//Everything that gets rebuilt or collapsed, to find neighbors around
+	std::vector<BoundingBox> dirty;
+
+	//Rebuild each subtree from scratch in the same spot
+	for( unsigned int i = 0; i < subtrees.size(); i++ )
+	{
+		SpatialGraphKDNode* oldNode = subtrees[i];
+		dirty.push_back( oldNode->BBox );
+		SpatialGraphBuilder builder( oldNode->BBox );
+		SpatialGraphKDNode* parent = oldNode->Parent;
+		SpatialGraphKDNode* newNode = CreateTree( builder, _depth - oldNode->Depth + 1, oldNode->BBox, builder.AllObstacles, parent, GetPathIndex(oldNode), NULL );
+		if( parent == NULL )
+			_root = newNode;
+		else if( parent->LHC == oldNode )
+			parent->LHC = newNode;
+		else
+			parent->RHC = newNode;
+		DeleteNode( oldNode );
+	}
+
+	//Then work back up, deepest first, collapsing anything that was only 
+	// split because of a shape that's gone, or that's now blocked solid
+	for( int i = (int)ancestors.size() - 1; i >= 0; i-- )
+	{
+		SpatialGraphKDNode* node = ancestors[i];
+		node->bBlocked = SpatialGraphBlockedQuery( node->BBox ).Blocked;
+		if( node->bBlocked && !IsFullyBlocked(node) )
+			continue;
+
+		DeleteNode( node->LHC );
+		node->LHC = NULL;
+		DeleteNode( node->RHC );
+		node->RHC = NULL;
+		if( !node->bBlocked )
 		{
-			DeleteNode( node->LHC );
-			node->LHC = NULL;
-			DeleteNode( node->RHC );
-			node->RHC = NULL;
+			//Leaves don't pad their index
+			node->Index = GetPathIndex( node );
 		}
+		dirty.push_back( node->BBox );
 	}
+	BuildFlatTree();
 
-	return node;
+	//Anything touching what changed needs its neighbors found again, since
+	// some of them were just deleted
+	std::vector<BoundingBox> neighborhood;
+	for( unsigned int i = 0; i < dirty.size(); i++ )
+	{
+		neighborhood.push_back( BoundingBox(dirty[i].Min - _smallestDimensions, dirty[i].Max + _smallestDimensions) );
+	}
+	SpatialGraphNeighborList leaves;
+	GatherLeaves( _root, &neighborhood, leaves );
+	for( unsigned int i = 0; i < leaves.size(); i++ )
+	{
+		//New leaves (and ancestors that just collapsed) need IDs
+		if( leaves[i]->ID < 0 )
+			AssignNodeId( leaves[i] );
+		leaves[i]->Neighbors.clear();
+		leaves[i]->NeighborLOS.clear();
+	}
+	theJobSystem.ParallelFor( (int)leaves.size(), 64, ComputeNeighborsJob, &leaves );
+	theJobSystem.ParallelFor( (int)leaves.size(), 64, ValidateNeighborsJob, &leaves );
+
+	_changedRegions.swap( neighborhood );
+	_revision = NextRevision();
+	_buildStats.InvalidateSeconds = (float)(GetBuildClockSeconds() - startTime);
+	_buildStats.NumInvalidatedLeaves = (int)leaves.size();
 }
 
 bool SpatialGraph::IsFullyBlocked( SpatialGraphKDNode* node )
@@ -414,10 +900,37 @@ bool SpatialGraph::IsFullyBlocked( SpatialGraphKDNode* node )
 	return node->bBlocked && IsFullyBlocked(node->LHC) && IsFullyBlocked(node->RHC);
 }
 
-bool QuickContainsNode( hashmap_ns::hash_map<SpatialGraphKDNode*, int>& NodeList, SpatialGraphKDNode* pNode )
+unsigned int SpatialGraph::BeginVisit( VisitStamps& visits )
 {
-	hashmap_ns::hash_map<SpatialGraphKDNode*, int>::iterator itr = NodeList.find( pNode );
-	return itr != NodeList.end();
+	if( (int)visits.Stamps.size() < GetNodeIdCount() )
+	{
+		visits.Stamps.resize( GetNodeIdCount(), 0 );
+	}
+
+	//Start over if the generation wraps, so old stamps can't match
+	if( ++visits.Generation == 0 )
+	{
+		std::fill( visits.Stamps.begin(), visits.Stamps.end(), 0 );
+		visits.Generation = 1;
+	}
+	return visits.Generation;
+}
+
+//How far along from + (delta * t) we get before leaving the box
+float GetExitDistance( const BoundingBox& BBox, const Vector2& vFrom, const Vector2& vDelta )
+{
+	float fExit = MathUtil::MaxFloat;
+	if( vDelta.X > 0.0f )
+		fExit = (BBox.Max.X - vFrom.X) / vDelta.X;
+	else if( vDelta.X < 0.0f )
+		fExit = (BBox.Min.X - vFrom.X) / vDelta.X;
+
+	if( vDelta.Y > 0.0f )
+		fExit = MathUtil::Min( fExit, (BBox.Max.Y - vFrom.Y) / vDelta.Y );
+	else if( vDelta.Y < 0.0f )
+		fExit = MathUtil::Min( fExit, (BBox.Min.Y - vFrom.Y) / vDelta.Y );
+
+	return fExit;
 }
 
 void NudgePointOnPlane( const BoundingBox& BBox, Vector2& vPointOnPlane )
@@ -472,32 +985,63 @@ bool SpatialGraph::CanGoInternal( const Vector2& vFrom, const Vector2 vTo, Spati
 	NudgePointOnPlane( pDestNode->BBox, vUseTo );
 
 	Ray2 ray = Ray2::CreateRayFromTo( vUseFrom, vUseTo );
+	Vector2 vDelta = vUseTo - vUseFrom;
+	//Small enough to stay inside the next leaf, big enough to get off the shared plane
+	Vector2 vStep = Vector2::Normalize( vDelta ) * (MathUtil::Min( _smallestDimensions.X, _smallestDimensions.Y ) * 0.01f);
+
+	//Visited leaves get stamped by ID rather than going in a set, so a walk
+	// doesn't allocate anything
+	//Threads outside the JobSystem keep their own stamps too, so they
+	// don't reallocate a full set on every call
+	static thread_local VisitStamps s_localVisits;
+	int thread = theJobSystem.GetCurrentThreadIndex();
+	VisitStamps& visits = (thread >= 0 && thread < (int)_visits.size()) ? _visits[thread] : s_localVisits;
+	unsigned int stamp = BeginVisit( visits );
 
-	hashmap_ns::hash_map<SpatialGraphKDNode*, int> NodeList;
 	SpatialGraphKDNode* pCurrent = pSourceNode;
 
 	while( true )
 	{
 		//Mark current as visited
-		NodeList[pCurrent] = 1;
+		visits.Stamps[pCurrent->ID] = stamp;
 		SpatialGraphKDNode* pNearestNeighbor = NULL;
-		float fNearestNeighborDistance = MathUtil::MaxFloat;
-		//iterate over currents neighbors to see if they intersect the ray
+
+		//Step across the face the line leaves through, and see which 
+		// neighbor that lands in (like stepping a grid DDA)
+		float fExit = GetExitDistance( pCurrent->BBox, vUseFrom, vDelta );
+		Vector2 vExit = vUseFrom + (vDelta * fExit) + vStep;
 		for( unsigned int i = 0; i < pCurrent->Neighbors.size(); i++ )
 		{
 			SpatialGraphKDNode* pNeighbor = pCurrent->Neighbors[i];
+			if( visits.Stamps[pNeighbor->ID] != stamp && pNeighbor->BBox.Contains( vExit ) )
+			{
+				pNearestNeighbor = pNeighbor;
+				break;
+			}
+		}
 
-			//Ignore neighbors we've already visited
-			if( QuickContainsNode( NodeList, pNeighbor) )
-				continue;
-
-			float fDistanceAlongRay;
-			if( pNeighbor->BBox.Intersects( ray, fDistanceAlongRay ) )
+		//Leaving through a corner can land in a leaf that only touches 
+		// diagonally, so fall back to the nearest neighbor along the ray
+		if( pNearestNeighbor == NULL )
+		{
+			float fNearestNeighborDistance = MathUtil::MaxFloat;
+			//iterate over currents neighbors to see if they intersect the ray
+			for( unsigned int i = 0; i < pCurrent->Neighbors.size(); i++ )
 			{
-				if( fDistanceAlongRay < fNearestNeighborDistance )
+				SpatialGraphKDNode* pNeighbor = pCurrent->Neighbors[i];
+
+				//Ignore neighbors we've already visited
+				if( visits.Stamps[pNeighbor->ID] == stamp )
+					continue;
+
+				float fDistanceAlongRay;
+				if( pNeighbor->BBox.Intersects( ray, fDistanceAlongRay ) )
 				{
-					fNearestNeighborDistance = fDistanceAlongRay;
-					pNearestNeighbor = pNeighbor;
+					if( fDistanceAlongRay < fNearestNeighborDistance )
+					{
+						fNearestNeighborDistance = fDistanceAlongRay;
+						pNearestNeighbor = pNeighbor;
+					}
 				}
 			}
 		}
@@ -519,7 +1063,7 @@ bool SpatialGraph::CanGoInternal( const Vector2& vFrom, const Vector2 vTo, Spati
 
 bool SpatialGraph::CanGoNodeToNode( SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode )
 {
-	return CanGoInternal( pSourceNode->BBox.Centroid(), pDestNode->BBox.Centroid(), pSourceNode, pDestNode );
+	return CanGoInternal( pSourceNode->Centroid, pDestNode->Centroid, pSourceNode, pDestNode );
 }
 
 
@@ -561,8 +1105,6 @@ void SpatialGraph::ComputeNeighbors( SpatialGraphKDNode* node )
 	Vector2 checkE = Vector2::UnitX * _smallestDimensions.X;
 	Vector2 checkW = Vector2::UnitX * -_smallestDimensions.X;
 
-	/* Vector2 centroid = */ node->BBox.Centroid();
-
 	Vector2List gridPoints;
 	int xPoints, yPoints;
 	node->GetGridPoints(gridPoints, xPoints, yPoints );
@@ -626,6 +1168,10 @@ SpatialGraphManager & SpatialGraphManager::GetInstance()
 
 SpatialGraphManager::SpatialGraphManager():
 _spatialGraph(NULL),
+_invalidateOnPhysicsChanges(false),
+_hierarchicalPaths(false),
+_pathHierarchy(NULL),
+_pathHierarchyRevision(0),
 _drawBounds(false),
 _drawBlocked(false),
 _drawGridPoints(false),
@@ -637,15 +1183,74 @@ _drawNodeIndex(false)
 
 SpatialGraphManager::~SpatialGraphManager()
 {
-
+	for( unsigned int i = 0; i < _pathSearches.size(); i++ )
+	{
+		delete _pathSearches[i];
+	}
+	delete _pathHierarchy;
 }
 
 void SpatialGraphManager::CreateGraph( float entityWidth, const BoundingBox& bounds )
 {
+	std::lock_guard<std::mutex> lock( _graphMutex );
+
 	if( _spatialGraph != NULL )
 		delete _spatialGraph;
 
+	//The new graph already sees every shape that's out there
+	_physicsChanges.clear();
+	delete _pathHierarchy;
+	_pathHierarchy = NULL;
 	_spatialGraph = new SpatialGraph( entityWidth, bounds );
+
+	while( (int)_pathSearches.size() < theJobSystem.GetThreadCount() )
+	{
+		_pathSearches.push_back( new PathSearch() );
+	}
+
+	const SpatialGraphBuildStats& stats = _spatialGraph->GetBuildStats();
+	sysLog.Printf( "Built spatial graph: %d nodes (%d leaves, %d blocked) from %d obstacles in %.1fms (tree %.1fms, neighbors %.1fms, line of sight %.1fms)", 
+		stats.NumNodes, stats.NumLeaves, stats.NumBlockedLeaves, stats.NumObstacles, stats.GetTotalSeconds() * 1000.0f, 
+		stats.TreeSeconds * 1000.0f, stats.NeighborSeconds * 1000.0f, stats.ValidateSeconds * 1000.0f );
+
+	//Build it now rather than in the middle of the first path query
+	if( _hierarchicalPaths )
+		BuildPathHierarchy();
+}
+
+void SpatialGraphManager::InvalidateRegion( const BoundingBox& region )
+{
+	std::lock_guard<std::mutex> lock( _graphMutex );
+	if( _spatialGraph != NULL )
+	{
+		int revision = _spatialGraph->GetRevision();
+		_spatialGraph->InvalidateRegion( region );
+		UpdatePathHierarchy( revision );
+	}
+}
+
+void SpatialGraphManager::AddPhysicsChange( const BoundingBox& region )
+{
+	if( _invalidateOnPhysicsChanges && _spatialGraph != NULL )
+		_physicsChanges.push_back( region );
+}
+
+void SpatialGraphManager::ProcessPhysicsChanges()
+{
+	if( _physicsChanges.empty() )
+		return;
+
+	//All of this frame's changes go in one rebuild
+	{
+		std::lock_guard<std::mutex> lock( _graphMutex );
+		if( _spatialGraph != NULL )
+		{
+			int revision = _spatialGraph->GetRevision();
+			_spatialGraph->InvalidateRegions( _physicsChanges );
+			UpdatePathHierarchy( revision );
+		}
+	}
+	_physicsChanges.clear();
 }
 
 //Vector2List s_tempPath;
@@ -666,123 +1271,155 @@ bool ContainsNode( SpatialGraphNeighborList& path, const SpatialGraphKDNode* nod
 	return false;
 }
 
-#include "stlastar.h"
-
-struct SearchInterface
+bool SpatialGraphManager::GetPath( const Vector2& source, const Vector2& dest, Vector2List& path )
 {
-	SpatialGraphKDNode* pNode;
+	if( _spatialGraph == NULL )
+		return false;
 
-	SearchInterface( SpatialGraphKDNode* node )
-	{
-		pNode = node;
-	}
+	//Get source cell
+	SpatialGraphKDNode* pSourceNode = _spatialGraph->FindNode( source );
+	if( pSourceNode == NULL )
+		return false;
 
-	SearchInterface()
-	{
-		pNode = NULL;
-	}
+	SpatialGraphKDNode* pDestNode = _spatialGraph->FindNode( dest );
+	if( pDestNode == NULL )
+		return false;
 
-	~SearchInterface()
+	path.push_back(source);
+	if( pSourceNode == pDestNode )
 	{
+		path.push_back(dest);
+		return true;
 	}
 
-	float GoalDistanceEstimate( const SearchInterface& goal )
+	//Go through the hierarchy if we've got one, filling in the whole way
+	PathHierarchy* pHierarchy = GetPathHierarchy();
+	if( pHierarchy != NULL )
 	{
-		return GetCost( goal );
+		PathCorridor corridor;
+		bool found = pHierarchy->FindCorridor( pSourceNode, pDestNode, dest, corridor );
+		while( found && !corridor.IsComplete() )
+		{
+			found = corridor.RefineNext( path );
+		}
+		if( !found )
+			path.clear();
+		return found;
 	}
 
-	bool IsGoal( const SearchInterface& goal )
+	//Compute A*
+	//Searches are stamped by generation, so a thread outside the JobSystem
+	// can reuse one across calls (and graphs) instead of building a new one
+	static thread_local PathSearch s_localSearch;
+	PathSearch* pSearch = GetThreadPathSearch();
+	if( pSearch == NULL )
+		pSearch = &s_localSearch;
+	bool retVal = pSearch->FindPath(_spatialGraph, pSourceNode, pDestNode, path);
+	if( retVal == false )
 	{
-		return IsSameState(goal);
+		path.clear();
+		return false;
 	}
 
-	bool IsSameState( const SearchInterface& goal )
-	{
-		return pNode == goal.pNode;
-	}
+	//otherwise, put dest on the pathlist
+	path.push_back(dest);
 
-	bool GetSuccessors( AStarSearch<SearchInterface>* pSearch, SearchInterface* pParent )
+	return true;
+}
+
+void SpatialGraphManager::EnableHierarchicalPaths(bool enable)
+{
+	_hierarchicalPaths = enable;
+	if( !_hierarchicalPaths )
 	{
-		for( unsigned int i = 0; i < pNode->Neighbors.size(); i++ )
-		{
-			SpatialGraphKDNode* successor = pNode->Neighbors[i];
-			if( (!pParent || pParent->pNode != successor) && !successor->bBlocked && pNode->NeighborLOS[i])
-			{
-				SearchInterface si(successor);
-				if( !pSearch->AddSuccessor(si) )
-					return false;
-			}
-		}
-		return true;
+		delete _pathHierarchy;
+		_pathHierarchy = NULL;
 	}
-
-	float GetCost( const SearchInterface& successor )
+	else if( _pathHierarchy == NULL && _spatialGraph != NULL )
 	{
-		return Vector2::Distance( pNode->BBox.Centroid(), successor.pNode->BBox.Centroid() );
+		BuildPathHierarchy();
 	}
-};
+}
 
-bool ComputeAStar( SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode, Vector2List& path )
+PathHierarchy* SpatialGraphManager::GetPathHierarchy()
 {
-	AStarSearch<SearchInterface> search;
-	SearchInterface pStart(pSourceNode);
-	SearchInterface pEnd(pDestNode);
-	
-	search.SetStartAndGoalStates( pStart, pEnd );
+	if( !_hierarchicalPaths || _spatialGraph == NULL || theJobSystem.GetCurrentThreadIndex() != 0 )
+		return NULL;
 
-	while( AStarSearch<SearchInterface>::SEARCH_STATE_SEARCHING == search.SearchStep() )
-	{
+	//Only if the graph changed somewhere UpdatePathHierarchy couldn't 
+	// follow it (off the main thread, say)
+	if( _pathHierarchy == NULL || _pathHierarchyRevision != _spatialGraph->GetRevision() )
+		BuildPathHierarchy();
 
-	}
+	return _pathHierarchy;
+}
 
-	int curState = search.GetState();
-	if( curState == AStarSearch<SearchInterface>::SEARCH_STATE_SUCCEEDED )
-	{
-		//Get path
-		for( SearchInterface* pCur = search.GetSolutionStart(); pCur != NULL; pCur = search.GetSolutionNext() )
-		{
-			path.push_back( pCur->pNode->BBox.Centroid() );
-		}
-		search.FreeSolutionNodes();
-		return true;
-	}
+void SpatialGraphManager::BuildPathHierarchy()
+{
+	delete _pathHierarchy;
 
-	return false;
+	//Clusters are the subtrees eight levels up from the bottom, so 
+	// about 16x16 of the smallest leaves
+	int clusterDepth = MathUtil::Max( 0, _spatialGraph->GetDepth() - 8 );
+	_pathHierarchy = new PathHierarchy( _spatialGraph, clusterDepth );
+	_pathHierarchyRevision = _spatialGraph->GetRevision();
+
+	const PathHierarchyStats& stats = _pathHierarchy->GetStats();
+	sysLog.Printf( "Built path hierarchy: %d clusters, %d portals, %d portal edges in %.1fms", 
+		stats.NumClusters, stats.NumPortals, stats.NumPortalEdges, stats.BuildSeconds * 1000.0f );
 }
 
-bool SpatialGraphManager::GetPath( const Vector2& source, const Vector2& dest, Vector2List& path )
+void SpatialGraphManager::UpdatePathHierarchy( int previousRevision )
 {
-	if( _spatialGraph == NULL )
-		return false;
+	//The changed regions only cover the last invalidation, so the 
+	// hierarchy has to have been up to date right before it. It's also 
+	// only ever touched from the main thread.
+	if( _pathHierarchy == NULL || _pathHierarchyRevision != previousRevision || theJobSystem.GetCurrentThreadIndex() != 0 )
+		return;
+	if( _spatialGraph->GetRevision() == previousRevision )
+		return;
 
-	//Get source cell
-	SpatialGraphKDNode* pSourceNode = _spatialGraph->FindNode( source );
-	if( pSourceNode == NULL )
+	_pathHierarchy->Update( _spatialGraph->GetLastChangedRegions() );
+	_pathHierarchyRevision = _spatialGraph->GetRevision();
+}
+
+bool SpatialGraphManager::GetHierarchicalPath( const Vector2& source, const Vector2& dest, PathCorridor& corridor, Vector2List& path )
+{
+	corridor.Clear();
+
+	PathHierarchy* pHierarchy = GetPathHierarchy();
+	if( pHierarchy == NULL )
 		return false;
 
+	SpatialGraphKDNode* pSourceNode = _spatialGraph->FindNode( source );
 	SpatialGraphKDNode* pDestNode = _spatialGraph->FindNode( dest );
-	if( pDestNode == NULL )
+	if( pSourceNode == NULL || pDestNode == NULL )
 		return false;
 
-	path.push_back(source);
-	if( pSourceNode == pDestNode )
-	{
-		path.push_back(dest);
-		return true;
-	}
+	if( !pHierarchy->FindCorridor( pSourceNode, pDestNode, dest, corridor ) )
+		return false;
 
-	//Compute A*
-	bool retVal = ComputeAStar(pSourceNode, pDestNode, path);
-	if( retVal == false )
+	//The start's centroid, then the first stretch
+	path.push_back( source );
+	for( int i = 0; i < 2 && !corridor.IsComplete(); i++ )
 	{
-		path.clear();
-		return false;
+		if( !corridor.RefineNext( path ) )
+		{
+			corridor.Clear();
+			path.clear();
+			return false;
+		}
 	}
+	return true;
+}
 
-	//otherwise, put dest on the pathlist
-	path.push_back(dest);
+PathSearch* SpatialGraphManager::GetThreadPathSearch()
+{
+	int thread = theJobSystem.GetCurrentThreadIndex();
+	if( thread < 0 || thread >= (int)_pathSearches.size() )
+		return NULL;
 
-	return true;
+	return _pathSearches[thread];
 }
 
 bool SpatialGraphManager::CanGo( const Vector2& from, const Vector2 to )
@@ -818,7 +1455,7 @@ bool SpatialGraphManager::FindNearestNonBlocked( const Vector2& fromPoint, Vecto
 		if( pNeighbor->bBlocked )
 			continue;
 
-		Vector2 vDir = pNeighbor->BBox.Centroid() - fromPoint;
+		Vector2 vDir = pNeighbor->Centroid - fromPoint;
 		Ray2 ray( fromPoint, Vector2::Normalize(vDir) );
 
 		float distanceToBBox;
@@ -834,7 +1471,7 @@ bool SpatialGraphManager::FindNearestNonBlocked( const Vector2& fromPoint, Vecto
 
 	if( pNearestNeighbor != NULL )
 	{
-		goTo = pNearestNeighbor->BBox.Centroid();
+		goTo = pNearestNeighbor->Centroid;
 		return true;
 	}
 
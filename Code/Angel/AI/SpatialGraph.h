@@ -32,9 +32,14 @@
 #include "../AI/BoundingShapes.h"
 
 #include <Box2D/Box2D.h>
+#include <mutex>
 
 class SpatialGraph;
 class SpatialGraphKDNode;
+class SpatialGraphBuilder;
+class PathSearch;
+class PathHierarchy;
+class PathCorridor;
 
 typedef std::vector<SpatialGraphKDNode*>	SpatialGraphNeighborList;
 typedef std::vector<Vector2>				Vector2List;
@@ -45,9 +50,11 @@ public:
 
 	SpatialGraphKDNode( const BoundingBox& bb, SpatialGraphKDNode* _parent )
 		: BBox(bb)
+		, Centroid(bb.Centroid())
 		, LHC(NULL)
 		, RHC(NULL)
 		, Parent(_parent)
+		, ID(-1)
 	{
 	}
 
@@ -57,12 +64,16 @@ public:
 	void GetGridPoints( Vector2List& points, int& xPoints, int& yPoints );
 
 	BoundingBox BBox;
+	Vector2 Centroid;
 	SpatialGraphKDNode* LHC;
 	SpatialGraphKDNode* RHC;
 	SpatialGraphKDNode* Parent;
 	SpatialGraph*		Tree;
 	int Index;
 	int Depth;
+	// Dense index for leaves, so searches can keep per-node data in arrays; 
+	//  -1 for nodes with children
+	int ID;
 	bool bBlocked;
 
 	SpatialGraphNeighborList	Neighbors;
@@ -82,6 +93,50 @@ namespace hashmap_ns {
 }
 #endif
 
+///Timings and counts from building a SpatialGraph
+/** 
+ * Filled in by the SpatialGraph constructor, so you can see where the time
+ *  goes when a level's graph is slow to build. Times are wall-clock 
+ *  seconds. 
+ */
+struct SpatialGraphBuildStats
+{
+	// Subdividing the KD tree against the physics shapes
+	float TreeSeconds;
+	// Finding each leaf's neighbors
+	float NeighborSeconds;
+	// Line-of-sight checks between neighbors
+	float ValidateSeconds;
+	
+	// Physics fixtures that overlapped the graph's bounds
+	int NumObstacles;
+	int NumNodes;
+	int NumLeaves;
+	int NumBlockedLeaves;
+	// Subtrees that were handed off to the JobSystem
+	int NumSubtreeJobs;
+	
+	// From the most recent SpatialGraph::InvalidateRegion
+	float InvalidateSeconds;
+	int NumInvalidatedLeaves;
+	
+	SpatialGraphBuildStats()
+		: TreeSeconds(0.0f)
+		, NeighborSeconds(0.0f)
+		, ValidateSeconds(0.0f)
+		, NumObstacles(0)
+		, NumNodes(0)
+		, NumLeaves(0)
+		, NumBlockedLeaves(0)
+		, NumSubtreeJobs(0)
+		, InvalidateSeconds(0.0f)
+		, NumInvalidatedLeaves(0)
+	{
+	}
+	
+	const float GetTotalSeconds() const { return TreeSeconds + NeighborSeconds + ValidateSeconds; }
+};
+
 class SpatialGraph
 {
 public:
@@ -95,11 +150,104 @@ public:
 	void Render();
 
 	int GetDepth() {return _depth;}
+	SpatialGraphKDNode* GetRoot() {return _root;}
 	Vector2 GetSmallestDimensions() {return _smallestDimensions;}
 	bool CanGo( const Vector2& vFrom, const Vector2 vTo );
+	const SpatialGraphBuildStats& GetBuildStats() {return _buildStats;}
+	
+	/**
+	 * Rebuilds just the part of the graph that overlaps a region, for when
+	 *  physics shapes there have been added, removed, or moved (a door 
+	 *  opening, a wall getting knocked down). Nodes are re-subdivided 
+	 *  against the shapes that are there now, and everything touching the
+	 *  region has its neighbors and line-of-sight checks redone. 
+	 * 
+	 * Any SpatialGraphKDNode pointers into the changed area are no longer
+	 *  valid afterward. 
+	 * 
+	 * @param region The world-space area that changed
+	 */
+	void InvalidateRegion( const BoundingBox& region );
+	
+	/**
+	 * Like InvalidateRegion, but for several areas at once. They all get 
+	 *  rebuilt together, with one pass over the neighbors and one new 
+	 *  revision, which is much cheaper than invalidating them one by one. 
+	 * 
+	 * @param regions The world-space areas that changed
+	 */
+	void InvalidateRegions( const std::vector<BoundingBox>& regions );
+	
+	/**
+	 * Changes every time InvalidateRegion changes the graph, so anything 
+	 *  holding on to results from it can tell they're stale. Revisions 
+	 *  come from one counter shared by every graph, so a graph built by 
+	 *  CreateGraph never matches one from the graph it replaced (even if 
+	 *  it lands at the same address). 
+	 * 
+	 * @return The graph's current revision
+	 */
+	const int GetRevision() {return _revision;}
+	
+	/**
+	 * The areas the last InvalidateRegions call rebuilt or found neighbors 
+	 *  for again. Leaves entirely outside them are exactly as they were, 
+	 *  with the same IDs and neighbors, which is what lets the 
+	 *  PathHierarchy only redo the clusters that changed. 
+	 * 
+	 * @return The world-space areas touched by the last invalidation 
+	 *  (empty if it didn't change anything)
+	 */
+	const std::vector<BoundingBox>& GetLastChangedRegions() {return _changedRegions;}
+	
+	SpatialGraphKDNode* GetNodeById(int id) {return _nodesById[id];}
+	// One more than the highest leaf ID; IDs freed by InvalidateRegion are
+	//  reused, so there can be gaps (GetNodeById returns NULL for them)
+	const int GetNodeIdCount() {return (int)_nodesById.size();}
 
 private:
-	SpatialGraphKDNode* CreateTree(int depth, const BoundingBox& bbox, SpatialGraphKDNode* parent = NULL, int index = 0 );
+	struct SubtreeJob
+	{
+		SpatialGraphKDNode* Node;
+		int Depth;
+		std::vector<int> Obstacles;
+	};
+	
+	// The tree laid out in one array for point lookups, with each node's 
+	//  children next to each other
+	struct FlatNode
+	{
+		// Where the node is split, along Axis
+		float Split;
+		// Index of the left child in _flatTree (the right one follows it); 
+		//  -1 for leaves
+		int Child;
+		// 0 for X, 1 for Y
+		int Axis;
+		// Which bit of a point's cell coordinate on Axis picks the child
+		int Shift;
+		SpatialGraphKDNode* Node;
+	};
+	
+	struct VisitStamps
+	{
+		// Leaf ID -> the Generation it was last visited in
+		std::vector<unsigned int> Stamps;
+		unsigned int Generation;
+		
+		VisitStamps() : Generation(0) {}
+	};
+	
+	SpatialGraphKDNode* CreateTree(SpatialGraphBuilder& builder, int depth, const BoundingBox& bbox, const std::vector<int>& obstacles, SpatialGraphKDNode* parent, int index, std::vector<SubtreeJob>* deferred );
+	void CreateChildren(SpatialGraphBuilder& builder, SpatialGraphKDNode* node, int depth, const std::vector<int>& obstacles, std::vector<SubtreeJob>* deferred );
+	void PruneFullyBlocked( SpatialGraphKDNode* node, int maxDepth );
+	void GatherLeaves( SpatialGraphKDNode* node, const std::vector<BoundingBox>* within, SpatialGraphNeighborList& leaves );
+	void AssignNodeId( SpatialGraphKDNode* node );
+	void BuildFlatTree();
+	void FindInvalidSubtrees( SpatialGraphKDNode* node, const std::vector<BoundingBox>& regions, SpatialGraphNeighborList& subtrees, SpatialGraphNeighborList& ancestors );
+	static void BuildSubtreesJob( void* context, int begin, int end );
+	static void ComputeNeighborsJob( void* context, int begin, int end );
+	static void ValidateNeighborsJob( void* context, int begin, int end );
 	void AddNeighbor( SpatialGraphKDNode* node, const Vector2& pos );
 	void ComputeNeighbors( SpatialGraphKDNode* node );
 	void ValidateNeighbors( SpatialGraphKDNode* node );
@@ -107,6 +255,7 @@ private:
 	bool IsFullyBlocked( SpatialGraphKDNode* pNode );
 	bool CanGoInternal( const Vector2& vFrom, const Vector2 vTo, SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode );
 	bool CanGoNodeToNode( SpatialGraphKDNode* pSourceNode, SpatialGraphKDNode* pDestNode );
+	unsigned int BeginVisit( VisitStamps& visits );
 
 private:
 	int _depth;
@@ -114,24 +263,109 @@ private:
 	Vector2 _smallestDimensions;
 	SpatialGraphKDNode* _root;
 	int _dirMasks[4];
+	// Subtrees below this depth get built as jobs
+	int _jobDepth;
+	int _revision;
+	std::vector<BoundingBox> _changedRegions;
+	SpatialGraphBuildStats _buildStats;
+	std::vector<SpatialGraphKDNode*> _nodesById;
+	std::vector<int> _freeNodeIds;
+	std::vector<FlatNode> _flatTree;
+	// Cells along each axis at full depth, and the scale from world space to them
+	unsigned int _cellCounts[2];
+	Vector2 _cellScale;
+	// Used by CanGoInternal; one per JobSystem thread, indexed by GetCurrentThreadIndex
+	std::vector<VisitStamps> _visits;
 
 };
 
 #define theSpatialGraph SpatialGraphManager::GetInstance()
 
-class SpatialGraphManager : public b2QueryCallback
+class SpatialGraphManager
 {
 public:
 	static SpatialGraphManager &GetInstance();
 
-	bool ReportFixture(b2Fixture* fixture);
-	
 	SpatialGraph* GetGraph() {return _spatialGraph;}
 	void CreateGraph( float entityWidth, const BoundingBox& bounds );
+	void InvalidateRegion( const BoundingBox& region );
+
+	/**
+	 * When this is on, creating or destroying a PhysicsActor invalidates 
+	 *  the part of the graph it covers, so paths route around new 
+	 *  obstacles and through old ones without a full CreateGraph. The 
+	 *  changes are batched up and applied once per frame, before the 
+	 *  Actors update. Off by default. 
+	 * 
+	 * @param enable Whether physics changes should update the graph
+	 */
+	void SetInvalidateOnPhysicsChanges(bool enable) {_invalidateOnPhysicsChanges = enable;}
+	const bool GetInvalidateOnPhysicsChanges() {return _invalidateOnPhysicsChanges;}
+	
+	/**
+	 * INTERNAL: Called by PhysicsActors when their bodies come and go. 
+	 */
+	void AddPhysicsChange( const BoundingBox& region );
+	
+	/**
+	 * INTERNAL: Called by the World once per frame to apply the changes 
+	 *  held by AddPhysicsChange. 
+	 */
+	void ProcessPhysicsChanges();
+	
+	/**
+	 * INTERNAL: Held by CreateGraph and InvalidateRegion while they change 
+	 *  the graph, and by the PathRequestQueue's worker thread while it 
+	 *  searches it. 
+	 */
+	std::mutex& GetGraphMutex() {return _graphMutex;}
 
 	void Render();
 
 	bool GetPath( const Vector2& source, const Vector2& dest, Vector2List& path );
+	PathSearch* GetThreadPathSearch();
+	
+	/**
+	 * Turns on the PathHierarchy, which searches between clusters of the 
+	 *  graph first and fills in the details afterward (HPA*). It's a lot 
+	 *  less work for long paths on big maps, at the cost of paths that 
+	 *  aren't always the very shortest. GetPath uses it, and PathFinders 
+	 *  use it to refine their paths a cluster at a time as they go. Off by
+	 *  default. 
+	 * 
+	 * The hierarchy is built right away (and again whenever CreateGraph 
+	 *  makes a new graph), which costs a search inside every cluster -- 
+	 *  the log says how long it took. After that, InvalidateRegion and 
+	 *  physics changes only redo the clusters they touched, and corridors 
+	 *  through the rest stay good. It's only used from the main thread; 
+	 *  paths found anywhere else are flat A*. 
+	 * 
+	 * @param enable Whether to use the hierarchy
+	 */
+	void EnableHierarchicalPaths(bool enable);
+	const bool GetHierarchicalPaths() {return _hierarchicalPaths;}
+	
+	/**
+	 * Gets the PathHierarchy for the current graph. It's normally kept up 
+	 *  to date as the graph changes, but if the graph was invalidated off 
+	 *  the main thread it gets rebuilt in full here, which is slow. 
+	 * 
+	 * @return The hierarchy, or NULL if it's turned off, there's no graph,
+	 *   or this isn't the main thread
+	 */
+	PathHierarchy* GetPathHierarchy();
+	
+	/**
+	 * Finds a path through the PathHierarchy, but only fills in its first 
+	 *  stretch; PathCorridor::RefineNext adds the rest as it's needed. 
+	 * 
+	 * @param source Where to start
+	 * @param dest Where to end up
+	 * @param corridor Keeps track of the rest of the trip
+	 * @param path The path so far gets added to the end of this
+	 * @return False if there's no way there, or no hierarchy to use
+	 */
+	bool GetHierarchicalPath( const Vector2& source, const Vector2& dest, PathCorridor& corridor, Vector2List& path );
 
 	bool CanGo( const Vector2& from, const Vector2 to );
 	bool IsInPathableSpace( const Vector2& point );
@@ -162,6 +396,19 @@ protected:
 private:
 	SpatialGraph*				_spatialGraph;
 	
+	bool _invalidateOnPhysicsChanges;
+	std::vector<BoundingBox> _physicsChanges;
+	// One per JobSystem thread, indexed by GetCurrentThreadIndex
+	std::vector<PathSearch*> _pathSearches;
+	bool _hierarchicalPaths;
+	PathHierarchy* _pathHierarchy;
+	int _pathHierarchyRevision;
+	std::mutex _graphMutex;
+	
+	void BuildPathHierarchy();
+	// Catches the hierarchy up with one invalidation, if it was current before it
+	void UpdatePathHierarchy( int previousRevision );
+	
 	bool _drawBounds;
 	bool _drawBlocked;
 	bool _drawGridPoints;
@@ -32,6 +32,7 @@
 
 #include "../AI/Sentient.h"
 #include "../AI/PathFinder.h"
+#include "../AI/FlowField.h"
 
 #include <Box2D/Box2D.h>
 
@@ -41,11 +42,24 @@ GotoAIEvent* GotoAIEvent::Initialize(const Vector2& destination, float moveSpeed
 	_moveSpeed = moveSpeed;
 	_arrivalDist = arrivalDist;
 	_moveFailed = false;
+	_useFlowField = false;
+	return this;
+}
+
+GotoAIEvent* GotoAIEvent::SetUseFlowField( bool useFlowField )
+{
+	_useFlowField = useFlowField;
 	return this;
 }
 
 void GotoAIEvent::Update(float /*dt*/)
 {
+	if( _useFlowField )
+	{
+		UpdateFlowField();
+		return;
+	}
+
 	Sentient* pActor = GetActor();
 
 	PathFinderMove move;
@@ -68,6 +82,30 @@ void GotoAIEvent::Update(float /*dt*/)
 
 }
 
+void GotoAIEvent::UpdateFlowField()
+{
+	Sentient* pActor = GetActor();
+
+	float arrivalDistSq = _arrivalDist * _arrivalDist;
+	if( Vector2::DistanceSquared( pActor->GetPosition(), _destination ) <= arrivalDistSq )
+	{
+		_moveFailed = false;
+		IssueCallback();
+		return;
+	}
+
+	Vector2 moveDir;
+	if( theFlowFields.GetMoveDirection( pActor->GetPosition(), _destination, moveDir ) )
+	{
+		pActor->ApplyLinearImpulse( moveDir * _moveSpeed * pActor->GetBody()->GetMass(), Vector2::Zero );
+	}
+	else
+	{
+		_moveFailed = true;
+		IssueCallback();
+	}
+}
+
 PathFinder& GotoAIEvent::GetPathfinder()
 {
 	return GetActor()->GetPathfinder();
@@ -41,11 +41,17 @@ public:
 	virtual GotoAIEvent* Initialize( const Vector2& destination, float moveSpeed, float arrivalDist = 0.2f );
 	virtual void Update(float dt);
 
+	// Steer by a FlowField shared with everyone else headed to the same 
+	//  place, instead of searching for our own path. Call after Initialize.
+	GotoAIEvent* SetUseFlowField( bool useFlowField );
+
 protected:
 	PathFinder& GetPathfinder();
+	void UpdateFlowField();
 
 protected:
 	bool			_moveFailed;
+	bool			_useFlowField;
 	Vector2			_destination;
 	float			_moveSpeed;
 	float			_arrivalDist;
@@ -33,7 +33,6 @@
 #include "../AI/Sentient.h"
 #include "../AI/PathFinder.h"
 #include "../AI/SpatialGraph.h"
-#include "../Infrastructure/TagCollection.h"
 
 #include <Box2D/Box2D.h>
 
@@ -41,14 +40,14 @@
 GotoTargetAIEvent* GotoTargetAIEvent::Initialize( const String& targetTag, float moveSpeed, float arrivalDist )
 {
 	_targetTag = targetTag;
+	_targetQuery = TagQuery(targetTag);
 	GotoAIEvent::Initialize( Vector2::Zero, moveSpeed, arrivalDist );
 	return this;
 }
 
 void GotoTargetAIEvent::Update(float dt)
 {
-	ActorSet taggedActors = theTagList.GetObjectsTagged(_targetTag);
-	for( ActorSet::iterator itr = taggedActors.begin(); itr != taggedActors.end(); itr++ )
+	for( TagQuery::iterator itr = _targetQuery.begin(); itr != _targetQuery.end(); ++itr )
 	{
 		Actor* pTargetActor = (*itr);
 		if( theSpatialGraph.IsInPathableSpace( pTargetActor->GetPosition() ) )
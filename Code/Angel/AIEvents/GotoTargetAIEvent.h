@@ -30,6 +30,7 @@
 #pragma once
 
 #include "../AIEvents/GotoAIEvent.h"
+#include "../Infrastructure/TagCollection.h"
 #include "../Util/StringUtil.h"
 
 class GotoTargetAIEvent : public GotoAIEvent
@@ -41,6 +42,7 @@ public:
 
 protected:
 	String			_targetTag;
+	TagQuery		_targetQuery;
 };
 
 DECLARE_AIEVENT_BASE( GotoTargetAIEvent )
@@ -31,6 +31,8 @@
 #include "../Actors/Actor.h"
 
 #include "../Infrastructure/TagCollection.h"
+#include "../Infrastructure/SpatialIndex.h"
+#include "../Infrastructure/SpriteBatch.h"
 #include "../Infrastructure/Textures.h"
 #include "../Infrastructure/TextRendering.h"
 #include "../Infrastructure/Log.h"
@@ -55,7 +57,22 @@ float Actor::_circleTextureCoords[(CIRCLE_DRAW_SECTIONS+2)*2];
 Actor* Actor::_scriptCreatedActor = NULL;
 bool __inittedActorCirclePoints = false;
 
-std::map<String, Actor*> Actor::_nameList;
+hashmap_ns::hash_map<String, Actor*> Actor::_nameList;
+
+// 20 bits of index (about a million live Actors) and 12 of generation. 
+#define ACTOR_HANDLE_INDEX_BITS 20
+#define ACTOR_HANDLE_INDEX_MASK ((1u << ACTOR_HANDLE_INDEX_BITS) - 1)
+#define ACTOR_HANDLE_CHUNK_BITS 10
+#define ACTOR_HANDLE_CHUNK_SIZE (1 << ACTOR_HANDLE_CHUNK_BITS)
+#define ACTOR_HANDLE_NUM_CHUNKS (1 << (ACTOR_HANDLE_INDEX_BITS - ACTOR_HANDLE_CHUNK_BITS))
+// Freed slots wait this long before reuse, so a stale handle would have to 
+//  survive a lot of churn before its generation could come around again.
+#define ACTOR_HANDLE_MIN_FREE_SLOTS 1024
+
+Actor::HandleSlot* Actor::_handleChunks[ACTOR_HANDLE_NUM_CHUNKS];
+std::atomic<int> Actor::_numHandleSlots(0);
+std::deque<int> Actor::_freeHandleSlots;
+std::mutex Actor::_handleMutex;
 
 Actor::Actor()
 {
@@ -92,10 +109,56 @@ Actor::Actor()
 	_layer = 0;
 
 	_drawShape = ADS_Square;
+
+	// Our Render only hands sprites to the batch. Subclasses that draw for 
+	//  themselves turn this back off.
+	_batchable = true;
+
+	std::lock_guard<std::mutex> lock(_handleMutex);
+	int index;
+	if (_freeHandleSlots.size() > ACTOR_HANDLE_MIN_FREE_SLOTS)
+	{
+		index = _freeHandleSlots.front();
+		_freeHandleSlots.pop_front();
+	}
+	else if (_numHandleSlots.load(std::memory_order_relaxed) <= (int)ACTOR_HANDLE_INDEX_MASK)
+	{
+		index = _numHandleSlots.load(std::memory_order_relaxed);
+		HandleSlot*& chunk = _handleChunks[index >> ACTOR_HANDLE_CHUNK_BITS];
+		if (chunk == NULL)
+		{
+			chunk = new HandleSlot[ACTOR_HANDLE_CHUNK_SIZE];
+		}
+		HandleSlot& slot = GetHandleSlot(index);
+		slot._actor.store(NULL, std::memory_order_relaxed);
+		slot._generation.store(1, std::memory_order_relaxed);
+		// Lookups check the count first, so the slot has to be ready by then
+		_numHandleSlots.store(index + 1, std::memory_order_release);
+	}
+	else if (!_freeHandleSlots.empty())
+	{
+		// Out of fresh slots, so reuse one early rather than overflow
+		index = _freeHandleSlots.front();
+		_freeHandleSlots.pop_front();
+	}
+	else
+	{
+		sysLog.Printf("ERROR: Out of Actor handles (%d Actors alive); this one won't have a handle.", _numHandleSlots.load(std::memory_order_relaxed));
+		_handle = INVALID_ACTOR_HANDLE;
+		return;
+	}
+	HandleSlot& slot = GetHandleSlot(index);
+	slot._actor.store(this, std::memory_order_release);
+	_handle = (slot._generation.load(std::memory_order_relaxed) << ACTOR_HANDLE_INDEX_BITS) | (unsigned int)index;
 }
 
 Actor::~Actor()
 {
+	if (_inSpatialIndex)
+	{
+		theSpatialIndex.Remove(this);
+	}
+
 	StringSet::iterator it = _tags.begin();
 	while (it != _tags.end())
 	{
@@ -104,7 +167,28 @@ Actor::~Actor()
 		Untag(tag);
 	}
 
-	Actor::_nameList.erase(_name);
+	if (GetNamed(_name) == this)
+	{
+		Actor::_nameList.erase(_name);
+	}
+
+	if (_handle == INVALID_ACTOR_HANDLE)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(_handleMutex);
+	int index = GetHandleIndex();
+	HandleSlot& slot = GetHandleSlot(index);
+	slot._actor.store(NULL, std::memory_order_release);
+	// Generation 0 would make index 0's handle look like INVALID_ACTOR_HANDLE.
+	unsigned int generation = (slot._generation.load(std::memory_order_relaxed) + 1) & (~0u >> ACTOR_HANDLE_INDEX_BITS);
+	if (generation == 0)
+	{
+		generation = 1;
+	}
+	slot._generation.store(generation, std::memory_order_release);
+	_freeHandleSlots.push_back(index);
 }
 
 void Actor::Update(float dt)
@@ -118,7 +202,7 @@ void Actor::Update(float dt)
 		{
 			if (_positionIntervalMessage != "")
 			{
-				theSwitchboard.Broadcast(new Message(_positionIntervalMessage, this));
+				theSwitchboard.Broadcast(_positionIntervalMessage, this);
 			}
 		}
 	}
@@ -129,7 +213,7 @@ void Actor::Update(float dt)
 		{
 			if (_rotationIntervalMessage != "")
 			{
-				theSwitchboard.Broadcast(new Message(_rotationIntervalMessage, this));
+				theSwitchboard.Broadcast(_rotationIntervalMessage, this);
 			}
 		}
 	}
@@ -140,7 +224,7 @@ void Actor::Update(float dt)
 		{
 			if (_colorIntervalMessage != "")
 			{
-				theSwitchboard.Broadcast(new Message(_colorIntervalMessage, this));
+				theSwitchboard.Broadcast(_colorIntervalMessage, this);
 			}
 		}
 	}
@@ -152,7 +236,7 @@ void Actor::Update(float dt)
 		{
 			if (_sizeIntervalMessage != "")
 			{
-				theSwitchboard.Broadcast(new Message(_sizeIntervalMessage, this));
+				theSwitchboard.Broadcast(_sizeIntervalMessage, this);
 			}
 		}
 	}
@@ -267,13 +351,25 @@ void Actor::ChangeSizeTo(float newSize, float duration, bool smooth, String onCo
 
 void Actor::Render()
 {
+	int textureReference = _spriteTextureReferences[_spriteCurrentFrame];
+	// Anything that isn't batchable has already had the batch flushed, 
+	//  and might draw on top of us after this, so it has to draw now.
+	if (_batchable)
+	{
+		// Let the batch handle it if it's open
+		if ((_drawShape == ADS_Square) && theSpriteBatch.AddSprite(textureReference, _position, _size, _rotation, _color, _UV))
+		{
+			return;
+		}
+		theSpriteBatch.Flush();
+	}
+
 	glPushMatrix();
 	glTranslatef(_position.X, _position.Y, 0.0f);
 	glRotatef(_rotation, 0, 0, 1);
 	glScalef(_size.X, _size.Y, 1.0f);
 	glColor4f(_color.R, _color.G, _color.B, _color.A);
 
-	int textureReference = _spriteTextureReferences[_spriteCurrentFrame];
 	if (textureReference >= 0)
 	{
 		glEnable(GL_TEXTURE_2D);
@@ -335,6 +431,11 @@ void Actor::SetSize(float x, float y)
 	else
 		sizeY = y;
 	_size = Vector2(sizeX, sizeY);
+	
+	if (_inSpatialIndex)
+	{
+		theSpatialIndex.Update(this);
+	}
 }
 
 void Actor::SetSize(const Vector2& newSize)
@@ -348,6 +449,11 @@ void Actor::SetSize(const Vector2& newSize)
 	{
 		_size.Y = 0.0f;
 	}
+	
+	if (_inSpatialIndex)
+	{
+		theSpatialIndex.Update(this);
+	}
 }
 
 const Vector2& Actor::GetSize() const
@@ -357,9 +463,19 @@ const Vector2& Actor::GetSize() const
 
 BoundingBox Actor::GetBoundingBox() const
 {
+	Vector2 halfSize = _size / 2.0f;
+	if (_rotation != 0.0f)
+	{
+		// Make room for the corners of the rotated quad
+		float radians = MathUtil::ToRadians(_rotation);
+		float c = fabs(cos(radians));
+		float s = fabs(sin(radians));
+		halfSize = Vector2((halfSize.X * c) + (halfSize.Y * s), (halfSize.X * s) + (halfSize.Y * c));
+	}
+
 	BoundingBox forReturn;
-	forReturn.Min = _position - (_size / 2.0f);
-	forReturn.Max = _position + (_size / 2.0f);
+	forReturn.Min = _position - halfSize;
+	forReturn.Max = _position + halfSize;
 	return forReturn;
 }
 
@@ -367,11 +483,21 @@ void Actor::SetPosition(float x, float y)
 {
 	_position.X = x;
 	_position.Y = y;
+	
+	if (_inSpatialIndex)
+	{
+		theSpatialIndex.Update(this);
+	}
 }
 
 void Actor::SetPosition(const Vector2& pos)
 {
 	_position = pos;
+	
+	if (_inSpatialIndex)
+	{
+		theSpatialIndex.Update(this);
+	}
 }
 
 const Vector2& Actor::GetPosition() const
@@ -382,6 +508,12 @@ const Vector2& Actor::GetPosition() const
 void Actor::SetRotation(float rotation)
 {
 	_rotation = rotation;
+	
+	// Rotating changes our bounding box
+	if (_inSpatialIndex)
+	{
+		theSpatialIndex.Update(this);
+	}
 }
 
 const float Actor::GetRotation() const
@@ -648,6 +780,12 @@ const String& Actor::SetName(String newName)
 	
 	newName[0] = toupper(newName[0]);
 	
+	// Don't leave our old name pointing at us.
+	if ((_name.length() > 0) && (GetNamed(_name) == this))
+	{
+		Actor::_nameList.erase(_name);
+	}
+	
 	const Actor* preNamed = Actor::GetNamed(newName);
 	if ((preNamed == NULL) || (preNamed == this))
 	{
@@ -670,7 +808,7 @@ const String& Actor::GetName() const
 
 Actor* const Actor::GetNamed(const String& nameLookup)
 {
-	std::map<String,Actor*>::iterator it = _nameList.find(nameLookup);
+	hashmap_ns::hash_map<String, Actor*>::iterator it = _nameList.find(nameLookup);
 	if (it == _nameList.end())
 	{
 		return NULL;
@@ -681,6 +819,52 @@ Actor* const Actor::GetNamed(const String& nameLookup)
 	}
 }
 
+Actor::HandleSlot& Actor::GetHandleSlot(int index)
+{
+	return _handleChunks[index >> ACTOR_HANDLE_CHUNK_BITS][index & (ACTOR_HANDLE_CHUNK_SIZE - 1)];
+}
+
+Actor* const Actor::GetFromHandle(ActorHandle handle)
+{
+	int index = (int)(handle & ACTOR_HANDLE_INDEX_MASK);
+	if ((handle == INVALID_ACTOR_HANDLE) || (index >= _numHandleSlots.load(std::memory_order_acquire)))
+	{
+		return NULL;
+	}
+	const HandleSlot& slot = GetHandleSlot(index);
+	unsigned int generation = handle >> ACTOR_HANDLE_INDEX_BITS;
+	if (slot._generation.load(std::memory_order_acquire) != generation)
+	{
+		return NULL;
+	}
+	Actor* actor = slot._actor.load(std::memory_order_acquire);
+	// The slot might have been freed (and even reused) while we looked
+	if (slot._generation.load(std::memory_order_acquire) != generation)
+	{
+		return NULL;
+	}
+	return actor;
+}
+
+const int Actor::GetHandleIndex() const
+{
+	return (int)(_handle & ACTOR_HANDLE_INDEX_MASK);
+}
+
+Actor* const Actor::GetFromHandleIndex(int index)
+{
+	if ((index < 0) || (index >= _numHandleSlots.load(std::memory_order_acquire)))
+	{
+		return NULL;
+	}
+	return GetHandleSlot(index)._actor.load(std::memory_order_acquire);
+}
+
+const int Actor::GetMaxHandleIndex()
+{
+	return _numHandleSlots.load(std::memory_order_acquire);
+}
+
 Actor* Actor::Create(const String& archetype)
 {
 	lua_State* L = LuaScriptingModule::GetLuaState();
@@ -38,6 +38,22 @@
 #define MAX_SPRITE_FRAMES 64
 #define CIRCLE_DRAW_SECTIONS 32
 
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+/**
+ * A 32-bit reference to an Actor that knows when the Actor is gone. The low
+ *  bits are the Actor's index (see Actor::GetHandleIndex) and the high bits
+ *  are a generation count that changes whenever the index is reused, so a 
+ *  handle to a deleted Actor never finds the one that replaced it. 
+ * 
+ * @see Actor::GetHandle, Actor::GetFromHandle
+ */
+typedef unsigned int ActorHandle;
+
+#define INVALID_ACTOR_HANDLE 0
+
 /**
  * An enumeration for the type of animations that can be given to an Actor. 
  */
@@ -115,12 +131,22 @@ public:
 	const Vector2& GetSize() const;
 	
 	/**
-	 * Return the BoundingBox for this Actor.
+	 * Return the BoundingBox for this Actor. If it's rotated, the box is 
+	 *  big enough to hold the rotated quad. 
 	 *
 	 * @return Actor's bounding box
 	 */
 	virtual BoundingBox GetBoundingBox() const;
 	
+	/**
+	 * Whether this Actor is positioned in screen space rather than in the
+	 *  world. Screen-space Actors (like HUDActors) are left out of the 
+	 *  SpatialIndex. 
+	 * 
+	 * @return False for a regular Actor
+	 */
+	virtual const bool IsScreenSpace() const { return false; }
+	
 	/**
 	 * Set the position of the Actor in world coordinates. 
 	 * 
@@ -481,6 +507,53 @@ public:
 	 */
 	static Actor* const GetNamed(const String& nameLookup);
 	
+	/**
+	 * Get a handle for this Actor. Unlike a pointer, it's safe to hang on to
+	 *  one after the Actor might have been destroyed; Actor::GetFromHandle 
+	 *  will just return NULL. 
+	 * 
+	 * @return The Actor's handle, or INVALID_ACTOR_HANDLE if there were 
+	 *   none left to give it (in which case it can't be found by tag or 
+	 *   by the SpatialIndex either)
+	 */
+	const ActorHandle GetHandle() const { return _handle; }
+	
+	/**
+	 * A static function of the Actor class which looks an Actor up from a 
+	 *  handle. It doesn't take any locks, so it's cheap to call from 
+	 *  anywhere, including the parallel update. 
+	 * 
+	 * @param handle The handle, as returned from GetHandle
+	 * @return The Actor, or NULL if it's been destroyed (or the handle was 
+	 *   never valid)
+	 */
+	static Actor* const GetFromHandle(ActorHandle handle);
+	
+	/**
+	 * Get this Actor's index in the handle table. Indices are dense and 
+	 *  reused after an Actor is destroyed, which makes them handy for 
+	 *  indexing your own arrays of per-Actor data. 
+	 * 
+	 * @return The index part of this Actor's handle
+	 */
+	const int GetHandleIndex() const;
+	
+	/**
+	 * Get the Actor that currently has a particular handle index. Together
+	 *  with GetMaxHandleIndex, it lets you walk every Actor in existence. 
+	 * 
+	 * @param index The index to look at
+	 * @return The Actor there, or NULL if the slot's free
+	 */
+	static Actor* const GetFromHandleIndex(int index);
+	
+	/**
+	 * Get one more than the highest handle index that's been handed out. 
+	 * 
+	 * @return The size of the handle table
+	 */
+	static const int GetMaxHandleIndex();
+	
 	/**
 	 * An implementation of the MessageListener interface, which will be 
 	 *  called when a message gets delivered. 
@@ -534,6 +607,12 @@ public:
 	 *  subclass if necessary. 
 	 * 
 	 * This will get called on every Actor once per frame, after the #Update. 
+	 * 
+	 * Square Actors drawn by the World are handed to the SpriteBatch rather
+	 *  than drawn right away, unless they've been marked as not batchable. 
+	 *  If you override this to do your own drawing, call 
+	 *  SetBatchable(false) in your constructor. (See 
+	 *  Renderable::SetBatchable.)
 	 */
 	virtual void Render();
 	
@@ -632,7 +711,7 @@ protected:
 	StringSet _tags;
 
 	String _name;
-	static std::map<String, Actor*> _nameList;
+	static hashmap_ns::hash_map<String, Actor*> _nameList;
 
 	String _currentAnimName;
 	static Actor* _scriptCreatedActor;
@@ -645,6 +724,23 @@ private:
 	Interval<float> _rotationInterval; String _rotationIntervalMessage;
 	Interval<Color> _colorInterval; String _colorIntervalMessage;
 	Interval<Vector2> _sizeInterval; String _sizeIntervalMessage;
+	
+	struct HandleSlot
+	{
+		std::atomic<Actor*> _actor;
+		std::atomic<unsigned int> _generation;
+	};
+	static HandleSlot& GetHandleSlot(int index);
+	// Slots are allocated a chunk at a time and never move, so lookups can
+	//  read them without the lock
+	static HandleSlot* _handleChunks[];
+	static std::atomic<int> _numHandleSlots;
+	static std::deque<int> _freeHandleSlots;
+	// Actors can be created and destroyed during the parallel update
+	static std::mutex _handleMutex;
+	ActorHandle _handle;
+	
+	friend class SpatialIndex;
 };
 
 typedef std::vector<Actor*>		ActorList;
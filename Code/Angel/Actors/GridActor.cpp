@@ -41,6 +41,9 @@ GridActor::GridActor()
 	_minCoord = Vector2(-20.0f, -20.0f);
 	_maxCoord = Vector2(20.0f, 20.0f);
 
+	// The lines go well past our own bounds
+	SetCullable(false);
+	SetBatchable(false);
 	RecalculatePoints();
 }
 
@@ -52,6 +55,8 @@ GridActor::GridActor(const Color& lines, const Color& axis, float interval, cons
 	_minCoord = minCoord;
 	_maxCoord = maxCoord;
 
+	SetCullable(false);
+	SetBatchable(false);
 	RecalculatePoints();
 }
 
@@ -35,6 +35,12 @@
 #include "../Util/MathUtil.h"
 #include "../Infrastructure/Log.h"
 
+HUDActor::HUDActor()
+{
+	// We draw ourselves in screen space, so the batch can't have us
+	SetBatchable(false);
+}
+
 void HUDActor::Render()
 {
 	Vec2i winDimensions;
@@ -52,11 +52,25 @@ class HUDActor : public Actor
 {
 public:
 	
+	/**
+	 * The default constructor; same as Actor's, except that HUDActors 
+	 *  never go through the SpriteBatch. 
+	 */
+	HUDActor();
+	
 	/**
 	 * Override of the Renderable::Render function to handle drawing in screen-space.
 	 */
 	virtual void Render();
 	
+	/**
+	 * HUDActors are positioned in screen space. Overridden from 
+	 *  Actor::IsScreenSpace.
+	 * 
+	 * @return True
+	 */
+	virtual const bool IsScreenSpace() const { return true; }
+	
 	/**
 	 * Used by the SetName function to create a basename for this class. 
 	 *  Overridden from Actor::GetClassName.
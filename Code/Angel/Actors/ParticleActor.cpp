@@ -30,17 +30,28 @@
 #include "stdafx.h"
 #include "../Actors/ParticleActor.h"
 
+#include "../Infrastructure/ParticleSystemManager.h"
 #include "../Util/MathUtil.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define ANGEL_PARTICLES_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define ANGEL_PARTICLES_SSE2 0
+#endif
+
 ParticleActor::ParticleActor()
 {
 	_maxParticlesAlive = 0;
-	_particles = 0;
+	_poolOffset = -1;
+	_emissionAllowance = -1;
 
 	_particlesPerSecond = 20.0f;
 
 	_generationResidue = 0.0f;
 	_numParticlesAlive = 0;
+	_numParticlesSpawned = 0;
+	_numParticlesExpired = 0;
 
 	_systemLifetime = 0.0f;
 	_particleLifetime = 2.0f;
@@ -55,70 +66,42 @@ ParticleActor::ParticleActor()
 	_endScale = 1.0f;
 
 	_gravity = Vector2(0.0f, -4.0f);
+
+	// Particles wander well outside our own bounding box
+	SetCullable(false);
+	SetBatchable(false);
 	_attractor = Vector2(0.0f, 0.0f);
 	_attractorStrength = 0.0f;
 }
 
 ParticleActor::~ParticleActor()
 {
-	delete [] _particles;
+	if (_poolOffset >= 0)
+	{
+		theParticleSystems.FreeRange(_poolOffset, _maxParticlesAlive);
+	}
+	theParticleSystems.RemoveEmitter(this);
 }
 
 void ParticleActor::Update(float dt)
 {
 	Actor::Update(dt);
 
+	_numParticlesSpawned = 0;
+
 	if (_maxParticlesAlive == 0)
 		return;
 
-	//
-	// Update existing particles.
-	//
-	_numParticlesAlive = 0;
-	for (int i=0; i<_maxParticlesAlive; ++i)
+	// Our range may have been turned down during the parallel update; 
+	//  there's room for it by now.
+	if (_poolOffset < 0)
 	{
-		Particle& currentParticle = _particles[i];
-
-		if (currentParticle._age < 0.0f)
-			continue;
-
-		if (currentParticle._age < currentParticle._lifetime)
-		{
-			currentParticle._age += dt;
-
-			if (currentParticle._age < currentParticle._lifetime)
-			{
-				// Where are we in our lifespan? (0..1)
-				float lifePercent = currentParticle._age / currentParticle._lifetime;
-
-				// Determine current position based on last known position, velocity and
-				// current time delta.
-				currentParticle._pos = currentParticle._pos + currentParticle._vel * dt;
-
-				// Update our current velocity, which will be used next update.
-				currentParticle._vel = currentParticle._vel + _gravity * dt;
-				if (!MathUtil::FuzzyEquals(_attractorStrength, 0.0f))
-				{
-					Vector2 attractorShift = _attractor - currentParticle._pos;
-					attractorShift.Normalize();
-					attractorShift *= _attractorStrength;
-					currentParticle._vel += attractorShift * dt;
-				}
-
-				currentParticle._color = MathUtil::Lerp(_color, _endColor, lifePercent);
-
-				currentParticle._scale = MathUtil::Lerp(1.0f, _endScale, lifePercent);
-				
-				++_numParticlesAlive;
-			}
-			else 
-			{
-				currentParticle._age = -1.0f;
-				
-			}
-		}
+		_poolOffset = theParticleSystems.AllocateRange(_maxParticlesAlive);
 	}
 
+	// Existing particles have already been stepped by the 
+	//  ParticleSystemManager at this point.
+
 	// Systems with 0.0f lifetime live forever.
 	if (_systemLifetime > 0.0f)
 	{
@@ -146,44 +129,297 @@ void ParticleActor::Update(float dt)
 	float particlesToGenerate = _particlesPerSecond * dt + _generationResidue;
 	int numParticlesToGenerate = int(floorf(particlesToGenerate));
 	_generationResidue = particlesToGenerate - float(numParticlesToGenerate);
-	
-	if (numParticlesToGenerate > 0)
+
+	// New particles go on the end of the live range, if there's room (and 
+	//  if the global particle budget allows).
+	numParticlesToGenerate = MathUtil::Min(numParticlesToGenerate, _maxParticlesAlive - _numParticlesAlive);
+	if (_emissionAllowance >= 0)
+	{
+		numParticlesToGenerate = MathUtil::Min(numParticlesToGenerate, _emissionAllowance);
+	}
+	if ((numParticlesToGenerate > 0) && (_poolOffset >= 0))
 	{		
+		ParticleArrays particles = theParticleSystems.GetArrays(_poolOffset);
+
 		float rot = MathUtil::ToRadians(GetRotation());
 		float particleRot;
 
-		int particlesGenerated = 0;
-		for (int i=0; i<_maxParticlesAlive; ++i)
+		for (int generated=0; generated<numParticlesToGenerate; ++generated)
+		{
+			int index = _numParticlesAlive++;
+			++_numParticlesSpawned;
+
+			particles.Age[index] = 0.0f;
+			particles.MaxAge[index] = _particleLifetime;
+			particles.PosX[index] = _position.X;
+			particles.PosY[index] = _position.Y;
+			particles.Scale[index] = 1.0f;
+			particles.R[index] = _color.R;
+			particles.G[index] = _color.G;
+			particles.B[index] = _color.B;
+			particles.A[index] = _color.A;
+			
+			particleRot = MathUtil::RandomFloatWithError(rot, _spreadRadians);
+			float speed = MathUtil::RandomFloatInRange(_minSpeed, _maxSpeed); 
+			particles.VelX[index] = speed*cos(particleRot);
+			particles.VelY[index] = speed*sin(particleRot);
+		}
+	}
+}
+
+void ParticleActor::SimulateParticles(float dt)
+{
+	_numParticlesExpired = 0;
+
+	if (_numParticlesAlive == 0)
+		return;
+
+	ParticleArrays particles = theParticleSystems.GetArrays(_poolOffset);
+
+	//
+	// Retire expired particles.
+	//
+	// Live particles are kept packed at the front of the arrays. When one
+	//  dies, the last live particle is moved into its slot, so nothing ever
+	//  has to scan for holes.
+	int i = 0;
+	while (i < _numParticlesAlive)
+	{
+		particles.Age[i] += dt;
+		if (particles.Age[i] >= particles.MaxAge[i])
+		{
+			--_numParticlesAlive;
+			++_numParticlesExpired;
+			MoveParticle(particles, _numParticlesAlive, i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	//
+	// Update existing particles.
+	//
+	int simulated = IntegrateParticlesSIMD(particles, dt);
+	IntegrateParticles(particles, dt, simulated, _numParticlesAlive);
+}
+
+int ParticleActor::GetEmissionDemand(float dt) const
+{
+	if ((_maxParticlesAlive == 0) || (_systemLifetime < 0.0f))
+		return 0;
+
+	int demand = int(floorf(_particlesPerSecond * dt + _generationResidue));
+	return MathUtil::Min(demand, _maxParticlesAlive - _numParticlesAlive);
+}
+
+void ParticleActor::SetEmissionAllowance(int allowance)
+{
+	_emissionAllowance = allowance;
+}
+
+void ParticleActor::CullParticles(int keep)
+{
+	if (keep < _numParticlesAlive)
+	{
+		_numParticlesAlive = MathUtil::Max(keep, 0);
+	}
+}
+
+void ParticleActor::MoveParticle(const ParticleArrays& particles, int from, int to)
+{
+	particles.PosX[to] = particles.PosX[from];
+	particles.PosY[to] = particles.PosY[from];
+	particles.VelX[to] = particles.VelX[from];
+	particles.VelY[to] = particles.VelY[from];
+	particles.Age[to] = particles.Age[from];
+	particles.MaxAge[to] = particles.MaxAge[from];
+	particles.Scale[to] = particles.Scale[from];
+	particles.R[to] = particles.R[from];
+	particles.G[to] = particles.G[from];
+	particles.B[to] = particles.B[from];
+	particles.A[to] = particles.A[from];
+}
+
+void ParticleActor::IntegrateParticles(const ParticleArrays& particles, float dt, int first, int last)
+{
+	bool useAttractor = !MathUtil::FuzzyEquals(_attractorStrength, 0.0f);
+	for (int i=first; i<last; ++i)
+	{
+		// Where are we in our lifespan? (0..1)
+		float lifePercent = particles.Age[i] / particles.MaxAge[i];
+
+		// Determine current position based on last known position, velocity and
+		// current time delta.
+		particles.PosX[i] += particles.VelX[i] * dt;
+		particles.PosY[i] += particles.VelY[i] * dt;
+
+		// Update our current velocity, which will be used next update.
+		particles.VelX[i] += _gravity.X * dt;
+		particles.VelY[i] += _gravity.Y * dt;
+		if (useAttractor)
+		{
+			Vector2 attractorShift(_attractor.X - particles.PosX[i], _attractor.Y - particles.PosY[i]);
+			attractorShift.Normalize();
+			attractorShift *= _attractorStrength * dt;
+			particles.VelX[i] += attractorShift.X;
+			particles.VelY[i] += attractorShift.Y;
+		}
+
+		particles.R[i] = MathUtil::Lerp(_color.R, _endColor.R, lifePercent);
+		particles.G[i] = MathUtil::Lerp(_color.G, _endColor.G, lifePercent);
+		particles.B[i] = MathUtil::Lerp(_color.B, _endColor.B, lifePercent);
+		particles.A[i] = MathUtil::Lerp(_color.A, _endColor.A, lifePercent);
+
+		particles.Scale[i] = MathUtil::Lerp(1.0f, _endScale, lifePercent);
+	}
+}
+
+#if ANGEL_PARTICLES_SSE2
+int ParticleActor::IntegrateParticlesSIMD(const ParticleArrays& particles, float dt)
+{
+	// Same math as IntegrateParticles, four particles at a time. Whatever
+	//  doesn't fill out a group of four is left for the scalar loop.
+	int count = _numParticlesAlive & ~3;
+	if (count == 0)
+		return 0;
+
+	bool useAttractor = !MathUtil::FuzzyEquals(_attractorStrength, 0.0f);
+
+	const __m128 step = _mm_set1_ps(dt);
+	const __m128 gravityX = _mm_set1_ps(_gravity.X * dt);
+	const __m128 gravityY = _mm_set1_ps(_gravity.Y * dt);
+	const __m128 attractorX = _mm_set1_ps(_attractor.X);
+	const __m128 attractorY = _mm_set1_ps(_attractor.Y);
+	const __m128 attractorStep = _mm_set1_ps(_attractorStrength * dt);
+	const __m128 minLength = _mm_set1_ps(1e-7f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 startR = _mm_set1_ps(_color.R);
+	const __m128 startG = _mm_set1_ps(_color.G);
+	const __m128 startB = _mm_set1_ps(_color.B);
+	const __m128 startA = _mm_set1_ps(_color.A);
+	const __m128 deltaR = _mm_set1_ps(_endColor.R - _color.R);
+	const __m128 deltaG = _mm_set1_ps(_endColor.G - _color.G);
+	const __m128 deltaB = _mm_set1_ps(_endColor.B - _color.B);
+	const __m128 deltaA = _mm_set1_ps(_endColor.A - _color.A);
+	const __m128 deltaScale = _mm_set1_ps(_endScale - 1.0f);
+
+	float* posX = particles.PosX;
+	float* posY = particles.PosY;
+	float* velX = particles.VelX;
+	float* velY = particles.VelY;
+	const float* age = particles.Age;
+	const float* maxAge = particles.MaxAge;
+
+	for (int i=0; i<count; i+=4)
+	{
+		__m128 lifePercent = _mm_div_ps(_mm_loadu_ps(age + i), _mm_loadu_ps(maxAge + i));
+
+		__m128 vx = _mm_loadu_ps(velX + i);
+		__m128 vy = _mm_loadu_ps(velY + i);
+		__m128 px = _mm_add_ps(_mm_loadu_ps(posX + i), _mm_mul_ps(vx, step));
+		__m128 py = _mm_add_ps(_mm_loadu_ps(posY + i), _mm_mul_ps(vy, step));
+		vx = _mm_add_ps(vx, gravityX);
+		vy = _mm_add_ps(vy, gravityY);
+
+		if (useAttractor)
 		{
-			Particle& currentParticle = _particles[i];
-
-			if (currentParticle._age < 0.0f)
-			{
-				currentParticle._age = 0.0f;
-				currentParticle._lifetime = _particleLifetime;
-				currentParticle._pos = _position;
-				currentParticle._scale = 1.0f;
-				currentParticle._color = _color;
-				
-				particleRot = MathUtil::RandomFloatWithError(rot, _spreadRadians);
-				float speed = MathUtil::RandomFloatInRange(_minSpeed, _maxSpeed); 
-				currentParticle._vel = Vector2(speed*cos(particleRot), speed*sin(particleRot));
-
-				++particlesGenerated;
-
-				// If we've generated enough, break out.
-				if (particlesGenerated == numParticlesToGenerate)
-					break;
-			}
+			__m128 dx = _mm_sub_ps(attractorX, px);
+			__m128 dy = _mm_sub_ps(attractorY, py);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+			// Vector2::Normalize falls back to a unit axis for degenerate 
+			//  vectors; do the same so both paths agree.
+			__m128 degenerate = _mm_cmplt_ps(length, minLength);
+			__m128 pickY = _mm_and_ps(degenerate, _mm_cmpgt_ps(dy, dx));
+			__m128 pickX = _mm_andnot_ps(pickY, degenerate);
+			__m128 safeLength = _mm_or_ps(_mm_andnot_ps(degenerate, length), _mm_and_ps(degenerate, one));
+			dx = _mm_or_ps(_mm_andnot_ps(degenerate, _mm_div_ps(dx, safeLength)), _mm_and_ps(pickX, one));
+			dy = _mm_or_ps(_mm_andnot_ps(degenerate, _mm_div_ps(dy, safeLength)), _mm_and_ps(pickY, one));
+
+			vx = _mm_add_ps(vx, _mm_mul_ps(dx, attractorStep));
+			vy = _mm_add_ps(vy, _mm_mul_ps(dy, attractorStep));
 		}
+
+		_mm_storeu_ps(posX + i, px);
+		_mm_storeu_ps(posY + i, py);
+		_mm_storeu_ps(velX + i, vx);
+		_mm_storeu_ps(velY + i, vy);
+
+		_mm_storeu_ps(particles.R + i, _mm_add_ps(startR, _mm_mul_ps(deltaR, lifePercent)));
+		_mm_storeu_ps(particles.G + i, _mm_add_ps(startG, _mm_mul_ps(deltaG, lifePercent)));
+		_mm_storeu_ps(particles.B + i, _mm_add_ps(startB, _mm_mul_ps(deltaB, lifePercent)));
+		_mm_storeu_ps(particles.A + i, _mm_add_ps(startA, _mm_mul_ps(deltaA, lifePercent)));
+		_mm_storeu_ps(particles.Scale + i, _mm_add_ps(one, _mm_mul_ps(deltaScale, lifePercent)));
 	}
+
+	return count;
+}
+#else
+int ParticleActor::IntegrateParticlesSIMD(const ParticleArrays& /*particles*/, float /*dt*/)
+{
+	// No vector unit to lean on; IntegrateParticles handles everything.
+	return 0;
 }
+#endif
 
 void ParticleActor::Render()
 {
-	if (!_particles)
+	if (_numParticlesAlive == 0)
 		return;
 
+	// Corners of a unit quad, split into two triangles so every particle
+	//  can go into the same draw call.
+	const static float corners[] = {
+		-0.5f,  0.5f,
+		-0.5f, -0.5f,
+		 0.5f,  0.5f,
+		 0.5f,  0.5f,
+		-0.5f, -0.5f,
+		 0.5f, -0.5f,
+	};
+
+	// Every particle shares our rotation and base size, so rotate the corners
+	//  once up front; each particle just scales and offsets them.
+	float rot = MathUtil::ToRadians(_rotation);
+	float cosRot = cos(rot);
+	float sinRot = sin(rot);
+	float offsetX[6];
+	float offsetY[6];
+	for (int c=0; c<6; ++c)
+	{
+		float localX = corners[c*2] * _size.X;
+		float localY = corners[(c*2)+1] * _size.Y;
+		offsetX[c] = (localX * cosRot) - (localY * sinRot);
+		offsetY[c] = (localX * sinRot) + (localY * cosRot);
+	}
+
+	ParticleArrays particles = theParticleSystems.GetArrays(_poolOffset);
+	float* vertices;
+	float* texCoords;
+	float* colors;
+	theParticleSystems.GetRenderBuffers(_numParticlesAlive, vertices, texCoords, colors);
+
+	float* vert = vertices;
+	float* col = colors;
+	for (int i=0; i<_numParticlesAlive; ++i)
+	{
+		float x = particles.PosX[i];
+		float y = particles.PosY[i];
+		float scale = particles.Scale[i];
+		for (int c=0; c<6; ++c)
+		{
+			*vert++ = x + (offsetX[c] * scale);
+			*vert++ = y + (offsetY[c] * scale);
+			*col++ = particles.R[i];
+			*col++ = particles.G[i];
+			*col++ = particles.B[i];
+			*col++ = particles.A[i];
+		}
+	}
+	int numVertices = _numParticlesAlive * 6;
+
 	int textureReference = _spriteTextureReferences[_spriteCurrentFrame];
 	if (textureReference >= 0)
 	{
@@ -191,45 +427,14 @@ void ParticleActor::Render()
 		glBindTexture(GL_TEXTURE_2D, textureReference);
 	}
 
-	// Render all of our particles.
-	for (int i=0; i<_maxParticlesAlive; ++i)
-	{
-		Particle& currentParticle = _particles[i];
-
-		if (currentParticle._age < 0.0f)
-			continue;
-
-		glPushMatrix();
-
-		glTranslatef(currentParticle._pos.X, currentParticle._pos.Y, 0.0f);
-		glRotatef(_rotation, 0, 0, 1);
-		glScalef(_size.X * currentParticle._scale, _size.Y * currentParticle._scale, 1.0f);
-
-		glColor4f(	currentParticle._color.R, 
-					currentParticle._color.G, 
-					currentParticle._color.B, 
-					currentParticle._color.A);
-		
-		const static float vertices[] = {
-			-0.5f,  0.5f,
-			-0.5f, -0.5f,
-			 0.5f,  0.5f,
-			 0.5f, -0.5f,
-		};
-		const static float texCoords[] = {
-			0.0f, 1.0f,
-			0.0f, 0.0f,
-			1.0f, 1.0f,
-			1.0f, 0.0f,
-		};
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-		glVertexPointer(2, GL_FLOAT, 0, vertices);
-		glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
-		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-		glPopMatrix();
-	}
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, vertices);
+	glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+	glColorPointer(4, GL_FLOAT, 0, colors);
+	glDrawArrays(GL_TRIANGLES, 0, numVertices);
+	glDisableClientState(GL_COLOR_ARRAY);
 
 	if (textureReference >= 0)
 	{
@@ -321,17 +526,40 @@ void ParticleActor::SetMaxParticles(int maxParticles)
 		maxParticles = 1;
 	}
 
-	if (_particles)
+	// Trade our old range in the shared arena for one of the new size.
+	if (_poolOffset >= 0)
 	{
-		delete [] _particles;
+		theParticleSystems.FreeRange(_poolOffset, _maxParticlesAlive);
 	}
 	_maxParticlesAlive = maxParticles;
-	_particles = new Particle[_maxParticlesAlive];
+	_numParticlesAlive = 0;
+	_poolOffset = theParticleSystems.AllocateRange(_maxParticlesAlive);
+}
 
-	// Make them all available.   Age < 0.0f = free.
-	for (int i=0; i<_maxParticlesAlive; ++i)
-	{
-		_particles[i]._age = -1.0f;
-	}
+const int ParticleActor::GetMaxParticles() const
+{
+	return _maxParticlesAlive;
 }
 
+const int ParticleActor::GetNumParticlesAlive() const
+{
+	return _numParticlesAlive;
+}
+
+const float ParticleActor::GetPoolOccupancy() const
+{
+	if (_maxParticlesAlive == 0)
+		return 0.0f;
+
+	return (float)_numParticlesAlive / (float)_maxParticlesAlive;
+}
+
+const int ParticleActor::GetNumParticlesSpawned() const
+{
+	return _numParticlesSpawned;
+}
+
+const int ParticleActor::GetNumParticlesExpired() const
+{
+	return _numParticlesExpired;
+}
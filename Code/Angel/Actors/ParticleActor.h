@@ -31,6 +31,7 @@
 #pragma once
 
 #include "../Actors/Actor.h"
+#include "../Infrastructure/ParticleSystemManager.h"
 
 
 ///An Actor that draws and keeps track of drawing a particle system on screen. 
@@ -54,7 +55,7 @@ public:
 	ParticleActor();
 	
 	/** 
-	 * Deletes all the particles this Actor is keeping track of. 
+	 * Gives this Actor's particles back to the ParticleSystemManager. 
 	 */
 	~ParticleActor();
 	
@@ -188,6 +189,44 @@ public:
 	 * @param maxParticles The maximum number of particles for this system. 
 	 */
 	void SetMaxParticles(int maxParticles);
+
+	/**
+	 * Get the maximum number of particles this system can keep track of. 
+	 * 
+	 * @return The size of the particle pool, as set by SetMaxParticles
+	 */
+	const int GetMaxParticles() const;
+	
+	/**
+	 * Get the number of particles currently alive in this system. Useful
+	 *  for profiling -- if this sits at GetMaxParticles, the system is 
+	 *  dropping emissions and you may want a bigger pool (or a lower rate). 
+	 * 
+	 * @return The number of live particles
+	 */
+	const int GetNumParticlesAlive() const;
+	
+	/**
+	 * Get how full the particle pool is. 
+	 * 
+	 * @return The fraction of the pool in use, from 0.0 (empty) to 1.0 (full)
+	 */
+	const float GetPoolOccupancy() const;
+	
+	/**
+	 * Get the number of particles spawned during the last Update. 
+	 * 
+	 * @return The number of particles emitted last frame
+	 */
+	const int GetNumParticlesSpawned() const;
+	
+	/**
+	 * Get the number of particles that reached the end of their lifetime
+	 *  during the last Update. 
+	 * 
+	 * @return The number of particles retired last frame
+	 */
+	const int GetNumParticlesExpired() const;
 	
 	/**
 	 * Used by the SetName function to create a basename for this class. 
@@ -198,19 +237,30 @@ public:
 	virtual const String GetClassName() const { return "ParticleActor"; }
 
 protected:
-    struct Particle
-    {
-        Vector2 _pos;
-        Vector2 _vel;
-        float _age;
-        float _lifetime;
-        Color _color;
-        float _scale;
-    };
-    
-	Particle* _particles;
+	friend class ParticleSystemManager;
+
+	// Called by the ParticleSystemManager each frame, before Update
+	void SimulateParticles(float dt);
+	int GetEmissionDemand(float dt) const;
+	void SetEmissionAllowance(int allowance);
+	void CullParticles(int keep);
+
+	void MoveParticle(const ParticleArrays& particles, int from, int to);
+	void IntegrateParticles(const ParticleArrays& particles, float dt, int first, int last);
+	int IntegrateParticlesSIMD(const ParticleArrays& particles, float dt);
+
+	// Our particles live in the ParticleSystemManager's shared arena, as a 
+	//  structure of arrays -- one array per field -- so the update can run 
+	//  straight through memory a few particles at a time. Live particles are
+	//  always packed into [0, _numParticlesAlive) of our range, which is -1
+	//  until the arena has been able to hand one out.
+	int		_poolOffset;
+	int		_emissionAllowance;
+
 	int		_maxParticlesAlive;
 	int		_numParticlesAlive;
+	int		_numParticlesSpawned;
+	int		_numParticlesExpired;
 
 	float	_particlesPerSecond;
 	int		_maxParticlesToGenerate;
@@ -31,7 +31,9 @@
 #include "../Actors/PhysicsActor.h"
 
 #include "../Infrastructure/World.h"
+#include "../Infrastructure/SpatialIndex.h"
 #include "../Infrastructure/Log.h"
+#include "../AI/SpatialGraph.h"
 #include "../Util/MathUtil.h"
 
 #include <Box2D/Box2D.h>
@@ -40,6 +42,19 @@
 #define POST_PHYSICS_INIT_WARNING "WARNING: %s had no effect; don't change an actor after its physics have been initialized."
 #define PRE_PHYSICS_INIT_WARNING "WARNING: %s had no effect; this actor's physics were not initialized."
 
+// Lets the pathing graph know this body's space has changed
+static void AddSpatialGraphChange(b2Body* body)
+{
+	if (!theSpatialGraph.GetInvalidateOnPhysicsChanges())
+		return;
+
+	for (b2Fixture* fixture = body->GetFixtureList(); fixture != NULL; fixture = fixture->GetNext())
+	{
+		const b2AABB& bounds = fixture->GetAABB(0);
+		theSpatialGraph.AddPhysicsChange(BoundingBox(Vector2(bounds.lowerBound.x, bounds.lowerBound.y), Vector2(bounds.upperBound.x, bounds.upperBound.y)));
+	}
+}
+
 PhysicsActor::PhysicsActor(void) :	
 _physBody(NULL),
 _density(1.f),
@@ -48,7 +63,10 @@ _restitution(0.0f),
 _shapeType(SHAPETYPE_BOX),
 _isSensor(false),
 _groupIndex(0), 
-_fixedRotation(false)
+_fixedRotation(false),
+_collisionStartId(INVALID_MESSAGE_ID),
+_collisionEndId(INVALID_MESSAGE_ID),
+_collisionNameCount(-1)
 {
 }
 
@@ -57,6 +75,7 @@ PhysicsActor::~PhysicsActor()
 	if( _physBody != NULL )
 	{
 		_physBody->SetUserData(NULL);
+		AddSpatialGraphChange(_physBody);
 		theWorld.GetPhysicsWorld().DestroyBody(_physBody);
 	}
 }
@@ -176,6 +195,7 @@ void PhysicsActor::InitPhysics()
 	_physBody->CreateFixture(&fixtureDef);
 	_physBody->SetUserData(this);
 	CustomInitPhysics();
+	AddSpatialGraphChange(_physBody);
 }
 
 void PhysicsActor::ApplyForce(const Vector2& force, const Vector2& point)
@@ -272,5 +292,27 @@ void PhysicsActor::_syncPosRot(float x, float y, float rotation)
 		_rotation -= 360.f;
 	while (_rotation < -180.f)
 		_rotation += 360.f;
+	
+	if (_inSpatialIndex)
+	{
+		theSpatialIndex.Update(this);
+	}
+}
+
+const MessageId PhysicsActor::_getCollisionMessageId(bool beginning)
+{
+	// Names can change (and start out empty until SetName finds a unique 
+	//  one), so make sure we're still caching the right ones. Names are 
+	//  never removed from the table, so a missing one only needs another 
+	//  look once something new has been interned (like a subscription).
+	bool missing = (_collisionStartId == INVALID_MESSAGE_ID) || (_collisionEndId == INVALID_MESSAGE_ID);
+	if ((_collisionMessageName != GetName()) || (missing && (_collisionNameCount != theMessageNames.GetCount())))
+	{
+		_collisionMessageName = GetName();
+		_collisionNameCount = theMessageNames.GetCount();
+		_collisionStartId = theMessageNames.Find("CollisionStartWith" + _collisionMessageName);
+		_collisionEndId = theMessageNames.Find("CollisionEndWith" + _collisionMessageName);
+	}
+	return beginning ? _collisionStartId : _collisionEndId;
 }
 
@@ -337,5 +337,16 @@ private:
 	friend class World;
 
 	void _syncPosRot(float x, float y, float rotation);
+	const MessageId _getCollisionMessageId(bool beginning);
+
+	// "CollisionStartWith"/"CollisionEndWith" + our name, looked up instead
+	//  of being rebuilt for every contact. They're only found (never 
+	//  interned) so uniquely named Actors don't grow the name table; 
+	//  INVALID_MESSAGE_ID means nobody has subscribed to them. 
+	String _collisionMessageName;
+	MessageId _collisionStartId;
+	MessageId _collisionEndId;
+	// How many names were interned when we last looked
+	int _collisionNameCount;
 };
 
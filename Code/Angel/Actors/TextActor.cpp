@@ -32,6 +32,7 @@
 
 #include "../Infrastructure/TextRendering.h"
 #include "../Infrastructure/Camera.h"
+#include "../Infrastructure/SpatialIndex.h"
 #include "../Util/StringUtil.h"
 #include "../Util/MathUtil.h"
 #include "../Messaging/Switchboard.h"
@@ -48,6 +49,7 @@ TextActor::TextActor(const String& fontNickname, const String& displayString, Te
 	_extents.Max = Vector2::Zero;
 
 	SetDisplayString(displayString);
+	SetBatchable(false);
 	
 	theSwitchboard.SubscribeTo(this, "CameraChange");
 }
@@ -224,4 +226,9 @@ void TextActor::CalculatePosition()
 			_extents.Max = Vector2(maxX, maxY); 
 			break;
 	}
+	
+	if (_inSpatialIndex)
+	{
+		theSpatialIndex.Update(this);
+	}
 }
@@ -524,6 +524,18 @@
  * c->Untag("person");
  * \endcode
  * 
+ * If you're going to ask the same question every frame, make a TagQuery 
+ *  instead. It looks its tags up once and then walks the matching Actors 
+ *  in place, without building a new ActorSet each time:
+ * 
+ * \code
+ * TagQuery anyPeople("person, robot", true); //true: match either tag
+ * for (TagQuery::iterator it = anyPeople.begin(); it != anyPeople.end(); ++it)
+ * {
+ *     (*it)->SetAlpha(0.5f);
+ * }
+ * \endcode
+ * 
  * Tags and names give you a lot of flexibility in how you manage groups of
  *  Actors. Depending on your specific need, it can be a lot easier to just
  *  use tags and names instead of managing your own pointers and groups of
@@ -673,6 +685,16 @@
  *  to do anything with it afterwards. It's not a good idea to hang on to 
  *  Message pointers for this reason. 
  * 
+ * If you don't need a Message subclass of your own, you can skip the \c new
+ *  and let the Switchboard build the Message for you. These come out of a 
+ *  per-frame arena instead of the heap, which adds up when you're sending 
+ *  a lot of them:
+ * 
+ * \code
+ * theSwitchboard.Broadcast("ReadyToGo");
+ * theSwitchboard.Broadcast("StartingSpot", a->GetPosition(), a);
+ * \endcode
+ * 
  * Controller and keyboard input is performed using Messages -- by making 
  *  changes to the \c input_bindings.ini file in your \Config directory, you
  *  designate what Messages get sent when keys or buttons are pressed. (See 
@@ -946,10 +968,37 @@
  *  See the IntroGame's Pathfinding screen for an example of how to build an
  *  Actor that follows a path to a given point. 
  * 
+ * If lots of Actors are going to be asking for paths at once, the 
+ *  PathRequestQueue can spread the searches out over a few frames (or 
+ *  move them to a worker thread) so they don't cause a hitch. Sentients 
+ *  will use it if you call PathFinder::EnableAsyncPaths. 
+ * 
+ * And if a whole crowd is headed to the same place, the FlowFieldManager 
+ *  can work out the way there from everywhere at once, so they can all 
+ *  share it instead of each searching on their own. See 
+ *  GotoAIEvent::SetUseFlowField. 
+ * 
+ * On really big maps, long paths can mean searching a huge number of nodes.
+ *  SpatialGraphManager::EnableHierarchicalPaths groups the graph into 
+ *  clusters and searches between those first (see PathHierarchy), and 
+ *  PathFinders fill in the details of the path as they go. 
+ * 
  * (Note that even in a large space, generating the spatial graph is fairly 
  *  quick. While you definitely shouldn't call it every frame, calling it when
  *  something major has changed in your world is not inappropriate.)
  * 
+ * For smaller changes, like a door opening or a wall getting knocked down, 
+ *  you can rebuild just the part of the graph that changed, once the 
+ *  physics shapes are where they're going to be:
+ * 
+ * \code
+ * theSpatialGraph.InvalidateRegion(door->GetBoundingBox());
+ * \endcode
+ * 
+ * Or turn on SpatialGraphManager::SetInvalidateOnPhysicsChanges, and the 
+ *  graph will keep itself up to date as PhysicsActors are created and 
+ *  destroyed. 
+ * 
  * @subsection other_ai Other AI
  * The good news is that there are other AI functions in Angel, like a 
  *  simple state machine that can let you give different goals to an Actor
@@ -1242,7 +1291,11 @@
 
 #include "AI/BoundingShapes.h"
 #include "AI/Brain.h"
+#include "AI/FlowField.h"
 #include "AI/PathFinder.h"
+#include "AI/PathHierarchy.h"
+#include "AI/PathRequestQueue.h"
+#include "AI/PathSearch.h"
 #include "AI/Ray2.h"
 #include "AI/Sentient.h"
 #include "AI/SpatialGraph.h"
@@ -1259,11 +1312,15 @@
 #include "Infrastructure/Common.h"
 #include "Infrastructure/GameManager.h"
 #include "Infrastructure/Interval.h"
+#include "Infrastructure/JobSystem.h"
 #include "Infrastructure/Log.h"
+#include "Infrastructure/ParticleSystemManager.h"
 #include "Infrastructure/Preferences.h"
 #include "Infrastructure/Renderable.h"
 #include "Infrastructure/RenderableIterator.h"
 #include "Infrastructure/SoundDevice.h"
+#include "Infrastructure/SpatialIndex.h"
+#include "Infrastructure/SpriteBatch.h"
 #include "Infrastructure/TagCollection.h"
 #include "Infrastructure/TextRendering.h"
 #include "Infrastructure/Textures.h"
@@ -1283,6 +1340,8 @@
 #include "Input/MultiTouch.h" 
 
 #include "Messaging/Message.h"
+#include "Messaging/MessageArena.h"
+#include "Messaging/MessageNameTable.h"
 #include "Messaging/Switchboard.h"
 
 #include "UI/UserInterface.h"
@@ -103,7 +103,7 @@ void Camera::Resize(int width, int height)
 	gluPerspective(_aperture, aspect, _zNearClip, _zFarClip);
 	glMatrixMode(GL_MODELVIEW);
 
-	theSwitchboard.Broadcast(new Message("CameraChange"));
+	theSwitchboard.Broadcast("CameraChange");
 }
 
 const int Camera::GetWindowHeight() const
@@ -159,7 +159,7 @@ void Camera::Update(float dt)
 		}
 		if (change)
 		{
-			theSwitchboard.Broadcast(new Message("CameraChange"));
+			theSwitchboard.Broadcast("CameraChange");
 		}
 	}
     else
@@ -171,7 +171,7 @@ void Camera::Update(float dt)
             {
                 if (_3dPositionIntervalMessage != "")
                 {
-                    theSwitchboard.Broadcast(new Message(_3dPositionIntervalMessage, this));
+                    theSwitchboard.Broadcast(_3dPositionIntervalMessage, this);
                 }
             }
         }
@@ -198,28 +198,28 @@ void Camera::SetPosition(float x, float y, float z)
 {
 	_camera3DPosition = Vector3(x, y, z);
 	_position = Vector2(_camera3DPosition.X, _camera3DPosition.Y);
-	theSwitchboard.Broadcast(new Message("CameraChange"));
+	theSwitchboard.Broadcast("CameraChange");
 }
 
 void Camera::SetPosition(float x, float y)
 {
 	_camera3DPosition = Vector3(x, y, _camera3DPosition.Z);
 	_position = Vector2(_camera3DPosition.X, _camera3DPosition.Y);
-	theSwitchboard.Broadcast(new Message("CameraChange"));
+	theSwitchboard.Broadcast("CameraChange");
 }
 
 void Camera::SetPosition(const Vector2& v2)
 {
 	_camera3DPosition = Vector3(v2.X, v2.Y, _camera3DPosition.Z);
 	_position = Vector2(_camera3DPosition.X, _camera3DPosition.Y);
-	theSwitchboard.Broadcast(new Message("CameraChange"));
+	theSwitchboard.Broadcast("CameraChange");
 }
 
 void Camera::SetPosition(const Vector3& v3)
 {
 	_camera3DPosition = v3;
 	_position = Vector2(_camera3DPosition.X, _camera3DPosition.Y);
-	theSwitchboard.Broadcast(new Message("CameraChange"));
+	theSwitchboard.Broadcast("CameraChange");
 }
 
 void Camera::MoveTo(const Vector3& newPosition, float duration, bool smooth, String onCompletionMessage)
@@ -236,7 +236,7 @@ float Camera::GetZ() const
 void Camera::SetRotation(float newRotation)
 {
 	Actor::SetRotation(newRotation);
-	theSwitchboard.Broadcast(new Message("CameraChange"));
+	theSwitchboard.Broadcast("CameraChange");
 }
 
 float Camera::GetZForViewRadius(float radius)
@@ -276,7 +276,7 @@ void Camera::SetFarClipDist(float dist)
 void Camera::SetViewCenter(float x, float y, float z)
 {
 	_view = Vector3(x, y, z);
-	theSwitchboard.Broadcast(new Message("CameraChange"));
+	theSwitchboard.Broadcast("CameraChange");
 }
 
 const Vector3& Camera::GetViewCenter() const
@@ -0,0 +1,277 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "../Infrastructure/JobSystem.h"
+
+JobSystem* JobSystem::s_JobSystem = NULL;
+
+// Set once per thread, so looking it up never touches shared state.
+static thread_local int s_threadIndex = -1;
+
+JobSystem::JobSystem()
+{
+	_workersStarted = false;
+	_shuttingDown = false;
+	_queuedJobs = 0;
+	_stealCount = 0;
+
+	// Leave a core for the main thread.
+	int cores = (int)std::thread::hardware_concurrency();
+	_numWorkers = (cores > 1) ? cores - 1 : 0;
+
+	// Thread 0's queue; the thread itself is picked by SetMainThread.
+	_queues.push_back(new WorkQueue());
+}
+
+JobSystem& JobSystem::GetInstance()
+{
+	if (s_JobSystem == NULL)
+	{
+		s_JobSystem = new JobSystem();
+	}
+	return *s_JobSystem;
+}
+
+void JobSystem::SetWorkerCount(int numWorkers)
+{
+	if (numWorkers < 0)
+	{
+		numWorkers = 0;
+	}
+
+	StopWorkers();
+	_numWorkers = numWorkers;
+}
+
+void JobSystem::Shutdown()
+{
+	StopWorkers();
+}
+
+void JobSystem::StartWorkers()
+{
+	_shuttingDown = false;
+	for (int i=1; i<=_numWorkers; i++)
+	{
+		_queues.push_back(new WorkQueue());
+	}
+	for (int i=1; i<=_numWorkers; i++)
+	{
+		_workers.push_back(new std::thread(&JobSystem::WorkerLoop, this, i));
+	}
+	_workersStarted = true;
+}
+
+void JobSystem::StopWorkers()
+{
+	std::lock_guard<std::mutex> startLock(_startMutex);
+	if (!_workersStarted)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_wakeMutex);
+		_shuttingDown = true;
+	}
+	_wakeCondition.notify_all();
+
+	for (unsigned int i=0; i<_workers.size(); i++)
+	{
+		_workers[i]->join();
+		delete _workers[i];
+	}
+	_workers.clear();
+
+	// Keep the main thread's queue.
+	for (unsigned int i=1; i<_queues.size(); i++)
+	{
+		delete _queues[i];
+	}
+	_queues.resize(1);
+
+	_workersStarted = false;
+}
+
+const int JobSystem::GetCurrentThreadIndex() const
+{
+	return s_threadIndex;
+}
+
+void JobSystem::SetMainThread()
+{
+	s_threadIndex = 0;
+}
+
+void JobSystem::ParallelFor(int count, int grainSize, JobFunction function, void* context)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	if (grainSize < 1)
+	{
+		grainSize = 1;
+	}
+
+	// Not worth waking anybody up for.
+	if ((_numWorkers == 0) || (count <= grainSize))
+	{
+		function(context, 0, count);
+		return;
+	}
+
+	if (!_workersStarted)
+	{
+		// Two threads could get here at once.
+		std::lock_guard<std::mutex> lock(_startMutex);
+		if (!_workersStarted)
+		{
+			StartWorkers();
+		}
+	}
+
+	_stealCount = 0;
+
+	// Only our own chunks count, so a call from inside a job (or from 
+	//  another thread) doesn't wait on anybody else's work.
+	std::atomic<int> remaining((count + grainSize - 1) / grainSize);
+
+	// Deal the chunks out round-robin so every thread starts with work of 
+	//  its own, and only has to steal once it runs dry. 
+	int numJobs = 0;
+	int numQueues = (int)_queues.size();
+	for (int begin=0; begin<count; begin+=grainSize)
+	{
+		Job job;
+		job._function = function;
+		job._context = context;
+		job._begin = begin;
+		job._end = (begin + grainSize < count) ? begin + grainSize : count;
+		job._remaining = &remaining;
+
+		WorkQueue* queue = _queues[numJobs % numQueues];
+		std::lock_guard<std::mutex> lock(queue->_mutex);
+		queue->_jobs.push_back(job);
+		++numJobs;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_wakeMutex);
+		_queuedJobs += numJobs;
+	}
+	_wakeCondition.notify_all();
+
+	// Help out until our chunks are done. That might mean running somebody
+	//  else's jobs, but never sitting idle while there's work queued. 
+	//  Threads that aren't ours have no queue of their own and just steal.
+	int helper = s_threadIndex;
+	if (helper >= numQueues)
+	{
+		helper = -1;
+	}
+	while (remaining > 0)
+	{
+		if (!RunJob(helper))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool JobSystem::RunJob(int threadIndex)
+{
+	Job job;
+	bool found = false;
+
+	// Our own queue first, newest job first, since it's likely still warm.
+	if (threadIndex >= 0)
+	{
+		WorkQueue* own = _queues[threadIndex];
+		std::lock_guard<std::mutex> lock(own->_mutex);
+		if (!own->_jobs.empty())
+		{
+			job = own->_jobs.back();
+			own->_jobs.pop_back();
+			found = true;
+		}
+	}
+
+	// Otherwise take the oldest job from somebody else. A thread with no 
+	//  queue of its own (-1) looks through all of them.
+	int numQueues = (int)_queues.size();
+	int start = (threadIndex >= 0) ? threadIndex + 1 : 0;
+	int numVictims = (threadIndex >= 0) ? numQueues - 1 : numQueues;
+	for (int i=0; (i<numVictims) && !found; i++)
+	{
+		WorkQueue* victim = _queues[(start + i) % numQueues];
+		std::lock_guard<std::mutex> lock(victim->_mutex);
+		if (!victim->_jobs.empty())
+		{
+			job = victim->_jobs.front();
+			victim->_jobs.pop_front();
+			found = true;
+			++_stealCount;
+		}
+	}
+
+	if (!found)
+	{
+		return false;
+	}
+
+	--_queuedJobs;
+	job._function(job._context, job._begin, job._end);
+	--(*job._remaining);
+	return true;
+}
+
+void JobSystem::WorkerLoop(int threadIndex)
+{
+	s_threadIndex = threadIndex;
+
+	while (true)
+	{
+		if (RunJob(threadIndex))
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_wakeMutex);
+		while (!_shuttingDown && (_queuedJobs <= 0))
+		{
+			_wakeCondition.wait(lock);
+		}
+		if (_shuttingDown)
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,189 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//singleton shortcut
+#define theJobSystem JobSystem::GetInstance()
+
+///A small pool of worker threads for splitting up per-frame work
+/** 
+ * The JobSystem keeps a handful of worker threads around (one fewer than 
+ *  the number of cores, by default) and lets the engine spread loops 
+ *  across them with ParallelFor. Each thread has its own queue of jobs; 
+ *  when a thread runs out, it steals from the others, so uneven chunks 
+ *  still keep everyone busy. The calling thread pitches in too, and 
+ *  doesn't return until every chunk has finished. 
+ * 
+ * The workers are only started the first time there's parallel work to 
+ *  do, so games that never use it don't pay for the threads. 
+ * 
+ * Job functions run at the same time as each other, so they must only 
+ *  touch data that belongs to their own range. ParallelFor can be called 
+ *  from any thread, including from inside another job: each call waits 
+ *  only for its own chunks, and runs other queued jobs while it waits. 
+ *  SetWorkerCount and Shutdown must not be called while a ParallelFor is 
+ *  still running. 
+ * 
+ * Like the World, it uses the singleton pattern; use "theJobSystem" to 
+ *  access it. 
+ */
+class JobSystem
+{
+public:
+	/**
+	 * The signature for a job. It gets called with the context pointer 
+	 *  passed to ParallelFor and a half-open range [begin, end) of indices
+	 *  to work on. 
+	 */
+	typedef void (*JobFunction)(void* context, int begin, int end);
+	
+	/**
+	 * Used to access the singleton instance of this class. As a shortcut, 
+	 *  you can just use "theJobSystem". 
+	 * 
+	 * @return The singleton
+	 */
+	static JobSystem& GetInstance();
+	
+	/**
+	 * Runs a function over the indices [0, count), split into chunks of 
+	 *  grainSize that are spread across the worker threads. Blocks until 
+	 *  every chunk is done. If there are no workers, or only one chunk, it 
+	 *  all just runs on the calling thread. 
+	 * 
+	 * @param count The number of items to process
+	 * @param grainSize How many items go in each chunk
+	 * @param function The function to call for each chunk
+	 * @param context Passed through to the function untouched
+	 */
+	void ParallelFor(int count, int grainSize, JobFunction function, void* context);
+	
+	/**
+	 * Changes the number of worker threads. Any existing workers are 
+	 *  stopped first. Setting it to 0 makes ParallelFor run everything on
+	 *  the calling thread. 
+	 * 
+	 * @param numWorkers The number of threads to run alongside the main one
+	 */
+	void SetWorkerCount(int numWorkers);
+	
+	/**
+	 * Get the number of worker threads (not counting the main thread). 
+	 * 
+	 * @return The number of workers
+	 */
+	const int GetWorkerCount() const { return _numWorkers; }
+	
+	/**
+	 * Get the number of threads that can be running jobs at once, 
+	 *  including the main thread. Thread indices from 
+	 *  GetCurrentThreadIndex are always less than this. 
+	 * 
+	 * @return The number of threads
+	 */
+	const int GetThreadCount() const { return _numWorkers + 1; }
+	
+	/**
+	 * Find out which thread we're on. The main thread is 0; the workers 
+	 *  are numbered from 1. 
+	 * 
+	 * @return The index of the calling thread, or -1 if it isn't one of ours
+	 */
+	const int GetCurrentThreadIndex() const;
+	
+	/**
+	 * INTERNAL: Makes the calling thread thread 0. Called by the World in 
+	 *  Initialize, so that whichever thread happens to touch the JobSystem 
+	 *  first (a loader, say) doesn't end up as the main thread. 
+	 */
+	void SetMainThread();
+	
+	/**
+	 * Get the number of jobs that were stolen from another thread's queue
+	 *  during the last ParallelFor. Handy for seeing how evenly the work 
+	 *  was split. 
+	 * 
+	 * @return The number of stolen jobs
+	 */
+	const int GetStealCount() const { return _stealCount; }
+	
+	/**
+	 * INTERNAL: Stops and joins the worker threads. Called by the World 
+	 *  when it's shutting down. 
+	 */
+	void Shutdown();
+	
+protected:
+	JobSystem();
+	static JobSystem* s_JobSystem;
+	
+private:
+	struct Job
+	{
+		JobFunction _function;
+		void* _context;
+		int _begin;
+		int _end;
+		// Owned by the ParallelFor call that queued us
+		std::atomic<int>* _remaining;
+	};
+	
+	struct WorkQueue
+	{
+		std::mutex _mutex;
+		std::deque<Job> _jobs;
+	};
+	
+	void StartWorkers();
+	void StopWorkers();
+	void WorkerLoop(int threadIndex);
+	bool RunJob(int threadIndex);
+	
+	int _numWorkers;
+	std::atomic<bool> _workersStarted;
+	std::mutex _startMutex;
+	
+	std::vector<std::thread*> _workers;
+	std::vector<WorkQueue*> _queues;
+	
+	std::mutex _wakeMutex;
+	std::condition_variable _wakeCondition;
+	bool _shuttingDown;
+	
+	std::atomic<int> _queuedJobs;
+	std::atomic<int> _stealCount;
+};
@@ -0,0 +1,354 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "../Infrastructure/ParticleSystemManager.h"
+
+#include "../Actors/ParticleActor.h"
+#include "../Infrastructure/Camera.h"
+#include "../Infrastructure/JobSystem.h"
+
+#include <algorithm>
+
+// Texture coordinates for the six vertices of a particle's two triangles
+static const float s_particleTexCoords[] = {
+	0.0f, 1.0f,
+	0.0f, 0.0f,
+	1.0f, 1.0f,
+	1.0f, 1.0f,
+	0.0f, 0.0f,
+	1.0f, 0.0f,
+};
+
+// The arena never starts out smaller than this
+static const int s_minimumArenaSize = 1024;
+
+// How many emitters each simulation job steps
+static const int s_emittersPerJob = 4;
+
+ParticleSystemManager* ParticleSystemManager::s_ParticleSystemManager = NULL;
+
+ParticleSystemManager::ParticleSystemManager()
+{
+	_arenaSize = 0;
+	_arenaInUse = 0;
+	_growthDeferred = false;
+	_deferredDemand = 0;
+	_budget = 0;
+	_numParticlesAlive = 0;
+	_numParticlesCulled = 0;
+	_simulationDT = 0.0f;
+}
+
+ParticleSystemManager& ParticleSystemManager::GetInstance()
+{
+	if (s_ParticleSystemManager == NULL)
+	{
+		s_ParticleSystemManager = new ParticleSystemManager();
+	}
+	return *s_ParticleSystemManager;
+}
+
+void ParticleSystemManager::SetParticleBudget(int maxParticles)
+{
+	if (maxParticles < 0)
+	{
+		maxParticles = 0;
+	}
+	_budget = maxParticles;
+}
+
+void ParticleSystemManager::Update(float dt)
+{
+	_numParticlesAlive = 0;
+	_numParticlesCulled = 0;
+
+	// Emitters only touch their own range of the arena, so they can all 
+	//  be stepped at once.
+	_simulationDT = dt;
+	theJobSystem.ParallelFor((int)_emitters.size(), s_emittersPerJob, SimulateEmittersJob, this);
+
+	ApplyBudget(dt);
+
+	for (unsigned int i=0; i<_emitters.size(); i++)
+	{
+		_numParticlesAlive += _emitters[i]->GetNumParticlesAlive();
+	}
+}
+
+void ParticleSystemManager::SimulateEmittersJob(void* context, int begin, int end)
+{
+	ParticleSystemManager* manager = (ParticleSystemManager*)context;
+	for (int i=begin; i<end; i++)
+	{
+		manager->_emitters[i]->SimulateParticles(manager->_simulationDT);
+	}
+}
+
+void ParticleSystemManager::ApplyBudget(float dt)
+{
+	if (_budget == 0)
+	{
+		for (unsigned int i=0; i<_emitters.size(); i++)
+		{
+			_emitters[i]->SetEmissionAllowance(-1);
+		}
+		return;
+	}
+
+	// Closest to the camera gets first claim on the budget.
+	Vector2 cameraPosition = theCamera.GetPosition();
+	_priorities.resize(_emitters.size());
+	for (unsigned int i=0; i<_emitters.size(); i++)
+	{
+		_priorities[i]._distanceSquared = Vector2::DistanceSquared(cameraPosition, _emitters[i]->GetPosition());
+		_priorities[i]._emitter = _emitters[i];
+	}
+	std::sort(_priorities.begin(), _priorities.end());
+
+	int remaining = _budget;
+	for (unsigned int i=0; i<_priorities.size(); i++)
+	{
+		ParticleActor* emitter = _priorities[i]._emitter;
+
+		int alive = emitter->GetNumParticlesAlive();
+		int kept = std::min(alive, remaining);
+		if (kept < alive)
+		{
+			emitter->CullParticles(kept);
+			_numParticlesCulled += alive - kept;
+		}
+		remaining -= kept;
+
+		int allowance = std::min(emitter->GetEmissionDemand(dt), remaining);
+		emitter->SetEmissionAllowance(allowance);
+		remaining -= allowance;
+	}
+}
+
+void ParticleSystemManager::AddEmitter(ParticleActor* emitter)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_emitters.push_back(emitter);
+}
+
+void ParticleSystemManager::RemoveEmitter(ParticleActor* emitter)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<ParticleActor*>::iterator it = std::find(_emitters.begin(), _emitters.end(), emitter);
+	if (it != _emitters.end())
+	{
+		*it = _emitters.back();
+		_emitters.pop_back();
+	}
+}
+
+int ParticleSystemManager::AllocateRange(int count)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	// First fit
+	for (unsigned int i=0; i<_freeBlocks.size(); i++)
+	{
+		FreeBlock& block = _freeBlocks[i];
+		if (block._count >= count)
+		{
+			int offset = block._offset;
+			block._offset += count;
+			block._count -= count;
+			if (block._count == 0)
+			{
+				_freeBlocks.erase(_freeBlocks.begin() + i);
+			}
+			_arenaInUse += count;
+			return offset;
+		}
+	}
+
+	// Nothing big enough, and growing would move the arena out from under 
+	//  anybody who's using it, so wait until it's safe.
+	if (_growthDeferred)
+	{
+		_deferredDemand += count;
+		return -1;
+	}
+
+	// Grow the arena. If the last free block runs up to the end, it 
+	//  becomes the start of the new range.
+	int offset = _arenaSize;
+	if (!_freeBlocks.empty())
+	{
+		FreeBlock& last = _freeBlocks.back();
+		if (last._offset + last._count == _arenaSize)
+		{
+			offset = last._offset;
+			_freeBlocks.pop_back();
+		}
+	}
+
+	GrowArena(offset + count);
+	if (_arenaSize > offset + count)
+	{
+		FreeBlock tail;
+		tail._offset = offset + count;
+		tail._count = _arenaSize - tail._offset;
+		_freeBlocks.push_back(tail);
+	}
+
+	_arenaInUse += count;
+	return offset;
+}
+
+void ParticleSystemManager::FreeRange(int offset, int count)
+{
+	if (count <= 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_arenaInUse -= count;
+
+	FreeBlock freed;
+	freed._offset = offset;
+	freed._count = count;
+
+	// Keep the list sorted by offset, and merge with whatever's adjacent.
+	unsigned int i = 0;
+	while ((i < _freeBlocks.size()) && (_freeBlocks[i]._offset < offset))
+	{
+		i++;
+	}
+	_freeBlocks.insert(_freeBlocks.begin() + i, freed);
+
+	if ((i + 1 < _freeBlocks.size()) && (_freeBlocks[i]._offset + _freeBlocks[i]._count == _freeBlocks[i+1]._offset))
+	{
+		_freeBlocks[i]._count += _freeBlocks[i+1]._count;
+		_freeBlocks.erase(_freeBlocks.begin() + i + 1);
+	}
+	if ((i > 0) && (_freeBlocks[i-1]._offset + _freeBlocks[i-1]._count == _freeBlocks[i]._offset))
+	{
+		_freeBlocks[i-1]._count += _freeBlocks[i]._count;
+		_freeBlocks.erase(_freeBlocks.begin() + i);
+	}
+}
+
+void ParticleSystemManager::GrowArena(int minimumSize)
+{
+	int newSize = std::max(_arenaSize * 2, s_minimumArenaSize);
+	while (newSize < minimumSize)
+	{
+		newSize *= 2;
+	}
+
+	_posX.resize(newSize, 0.0f);
+	_posY.resize(newSize, 0.0f);
+	_velX.resize(newSize, 0.0f);
+	_velY.resize(newSize, 0.0f);
+	_age.resize(newSize, 0.0f);
+	_maxAge.resize(newSize, 0.0f);
+	_scale.resize(newSize, 1.0f);
+	_r.resize(newSize, 0.0f);
+	_g.resize(newSize, 0.0f);
+	_b.resize(newSize, 0.0f);
+	_a.resize(newSize, 0.0f);
+
+	_arenaSize = newSize;
+}
+
+void ParticleSystemManager::DeferGrowth()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_growthDeferred = true;
+}
+
+void ParticleSystemManager::FlushDeferredGrowth()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_growthDeferred = false;
+	if (_deferredDemand == 0)
+	{
+		return;
+	}
+
+	// Put the room on the end, where the emitters that were turned down 
+	//  will find it when they try again.
+	int oldSize = _arenaSize;
+	GrowArena(_arenaSize + _deferredDemand);
+	if (!_freeBlocks.empty() && (_freeBlocks.back()._offset + _freeBlocks.back()._count == oldSize))
+	{
+		_freeBlocks.back()._count += _arenaSize - oldSize;
+	}
+	else
+	{
+		FreeBlock tail;
+		tail._offset = oldSize;
+		tail._count = _arenaSize - oldSize;
+		_freeBlocks.push_back(tail);
+	}
+	_deferredDemand = 0;
+}
+
+ParticleArrays ParticleSystemManager::GetArrays(int offset)
+{
+	ParticleArrays arrays;
+	arrays.PosX = &_posX[offset];
+	arrays.PosY = &_posY[offset];
+	arrays.VelX = &_velX[offset];
+	arrays.VelY = &_velY[offset];
+	arrays.Age = &_age[offset];
+	arrays.MaxAge = &_maxAge[offset];
+	arrays.Scale = &_scale[offset];
+	arrays.R = &_r[offset];
+	arrays.G = &_g[offset];
+	arrays.B = &_b[offset];
+	arrays.A = &_a[offset];
+	return arrays;
+}
+
+void ParticleSystemManager::GetRenderBuffers(int numParticles, float*& vertices, float*& texCoords, float*& colors)
+{
+	int filled = (int)_texCoordBuffer.size() / 12;
+	if (numParticles > filled)
+	{
+		_vertexBuffer.resize(numParticles * 12);
+		_colorBuffer.resize(numParticles * 24);
+		_texCoordBuffer.resize(numParticles * 12);
+		for (int i=filled; i<numParticles; i++)
+		{
+			for (int j=0; j<12; j++)
+			{
+				_texCoordBuffer[(i*12)+j] = s_particleTexCoords[j];
+			}
+		}
+	}
+
+	vertices = &_vertexBuffer[0];
+	texCoords = &_texCoordBuffer[0];
+	colors = &_colorBuffer[0];
+}
@@ -0,0 +1,273 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+
+class ParticleActor;
+
+//singleton shortcut
+#define theParticleSystems ParticleSystemManager::GetInstance()
+
+///Pointers to one emitter's slice of the shared particle arrays
+/** 
+ * Each field is its own array, and index 0 is the emitter's first 
+ *  particle. The pointers are only good until the next time the 
+ *  ParticleSystemManager hands out a range, since the arena may have to 
+ *  grow, so don't hang on to them across frames. 
+ */
+struct ParticleArrays
+{
+	float* PosX;
+	float* PosY;
+	float* VelX;
+	float* VelY;
+	float* Age;
+	float* MaxAge;
+	float* Scale;
+	float* R;
+	float* G;
+	float* B;
+	float* A;
+};
+
+///Owns the memory and the per-frame simulation for every ParticleActor
+/** 
+ * Instead of each ParticleActor allocating its own particles, they all 
+ *  share one big arena and get handed a range of it when their maximum is
+ *  set. Freed ranges are recycled for the next emitter that comes along, so
+ *  spawning a lot of short-lived effects (explosions, hits, etc.) doesn't 
+ *  churn the heap. 
+ * 
+ * Once per frame the World has the manager step the particles of every 
+ *  emitter that's in the World in a single pass, spread across the 
+ *  JobSystem's threads, before the Actors themselves get updated. 
+ * 
+ * Ranges can be handed out and given back from the World's parallel 
+ *  update phase, but the arena can't grow while it's running, since other
+ *  emitters may be holding pointers into it. A request that doesn't fit 
+ *  gets turned down until the phase is over, and the emitter tries again 
+ *  on its next Update. 
+ * 
+ * You can also set a global particle budget. When the emitters together 
+ *  want more particles than that, the ones closest to the camera get served
+ *  first; emitters further away have their emission throttled and, if 
+ *  they're still over, their existing particles culled. 
+ * 
+ * Like the World, it uses the singleton pattern; use "theParticleSystems" 
+ *  to access it. 
+ */
+class ParticleSystemManager
+{
+public:
+	/**
+	 * Used to access the singleton instance of this class. As a shortcut, 
+	 *  you can just use "theParticleSystems". 
+	 * 
+	 * @return The singleton
+	 */
+	static ParticleSystemManager& GetInstance();
+	
+	/**
+	 * Caps the total number of particles alive across every ParticleActor. 
+	 *  Useful for keeping effects-heavy scenes from falling off a cliff on 
+	 *  slower machines. 
+	 * 
+	 * @param maxParticles The most particles allowed at once; 0 (the default)
+	 *   means no limit beyond each emitter's own SetMaxParticles
+	 */
+	void SetParticleBudget(int maxParticles);
+	
+	/**
+	 * Get the current global particle budget. 
+	 * 
+	 * @return The most particles allowed at once, or 0 if there's no limit
+	 */
+	const int GetParticleBudget() const { return _budget; }
+	
+	/**
+	 * Get the total number of particles that were alive after the last 
+	 *  simulation pass. 
+	 * 
+	 * @return The number of live particles across all emitters
+	 */
+	const int GetNumParticlesAlive() const { return _numParticlesAlive; }
+	
+	/**
+	 * Get the number of particles removed last frame to stay within the 
+	 *  budget. 
+	 * 
+	 * @return The number of culled particles
+	 */
+	const int GetNumParticlesCulled() const { return _numParticlesCulled; }
+	
+	/**
+	 * Get the number of ParticleActors currently registered. 
+	 * 
+	 * @return The number of emitters
+	 */
+	const int GetNumEmitters() const { return (int)_emitters.size(); }
+	
+	/**
+	 * Get the number of particles the arena has room for. It grows as 
+	 *  needed, and never shrinks. 
+	 * 
+	 * @return The arena's capacity in particles
+	 */
+	const int GetArenaSize() const { return _arenaSize; }
+	
+	/**
+	 * Get the number of particle slots currently handed out to emitters. 
+	 * 
+	 * @return The number of allocated slots
+	 */
+	const int GetArenaInUse() const { return _arenaInUse; }
+	
+	/**
+	 * INTERNAL: Called by the World once per frame to step every emitter 
+	 *  and apply the particle budget. 
+	 * 
+	 * @param dt The amount of time that's elapsed since the last frame
+	 */
+	void Update(float dt);
+	
+	/**
+	 * INTERNAL: Called by the World when a ParticleActor is added to it. 
+	 */
+	void AddEmitter(ParticleActor* emitter);
+	
+	/**
+	 * INTERNAL: Called by the World when a ParticleActor is removed from 
+	 *  it, and by the ParticleActor itself when it's destroyed. 
+	 */
+	void RemoveEmitter(ParticleActor* emitter);
+	
+	/**
+	 * INTERNAL: Reserves a contiguous range of particles in the arena. 
+	 * 
+	 * @param count The number of particles needed
+	 * @return The offset of the range, to pass to GetArrays and FreeRange, 
+	 *   or -1 if it won't fit until the parallel update is over
+	 */
+	int AllocateRange(int count);
+	
+	/**
+	 * INTERNAL: Gives a range from AllocateRange back to the arena. 
+	 */
+	void FreeRange(int offset, int count);
+	
+	/**
+	 * INTERNAL: Gets pointers to the particles starting at the given offset. 
+	 */
+	ParticleArrays GetArrays(int offset);
+	
+	/**
+	 * INTERNAL: Gets scratch buffers big enough to draw the given number of
+	 *  particles as triangles (six vertices each). The texture coordinates 
+	 *  come pre-filled. They're shared between all emitters, so they're only
+	 *  good until the next call. 
+	 */
+	void GetRenderBuffers(int numParticles, float*& vertices, float*& texCoords, float*& colors);
+	
+	/**
+	 * INTERNAL: Called by the World before its parallel update. Until 
+	 *  FlushDeferredGrowth, the arena stays where it is, and ranges that 
+	 *  would need it to grow are turned down. 
+	 */
+	void DeferGrowth();
+	
+	/**
+	 * INTERNAL: Called by the World after its parallel update to make room
+	 *  for every range that was turned down while it was running. 
+	 */
+	void FlushDeferredGrowth();
+	
+protected:
+	ParticleSystemManager();
+	static ParticleSystemManager* s_ParticleSystemManager;
+	
+private:
+	struct FreeBlock
+	{
+		int _offset;
+		int _count;
+	};
+	
+	struct EmitterPriority
+	{
+		float _distanceSquared;
+		ParticleActor* _emitter;
+		
+		bool operator<(const EmitterPriority& other) const
+		{
+			return _distanceSquared < other._distanceSquared;
+		}
+	};
+	
+	void GrowArena(int minimumSize);
+	void ApplyBudget(float dt);
+	static void SimulateEmittersJob(void* context, int begin, int end);
+	
+	std::vector<ParticleActor*> _emitters;
+	std::vector<EmitterPriority> _priorities;
+	
+	// Guards the emitter list and the arena bookkeeping
+	std::mutex _mutex;
+	
+	// Unallocated ranges, kept sorted by offset so neighbors can be merged
+	std::vector<FreeBlock> _freeBlocks;
+	int _arenaSize;
+	int _arenaInUse;
+	bool _growthDeferred;
+	// Particles turned down while growth was deferred
+	int _deferredDemand;
+	
+	std::vector<float> _posX;
+	std::vector<float> _posY;
+	std::vector<float> _velX;
+	std::vector<float> _velY;
+	std::vector<float> _age;
+	std::vector<float> _maxAge;
+	std::vector<float> _scale;
+	std::vector<float> _r;
+	std::vector<float> _g;
+	std::vector<float> _b;
+	std::vector<float> _a;
+	
+	std::vector<float> _vertexBuffer;
+	std::vector<float> _texCoordBuffer;
+	std::vector<float> _colorBuffer;
+	
+	int _budget;
+	int _numParticlesAlive;
+	int _numParticlesCulled;
+	float _simulationDT;
+};
@@ -38,6 +38,7 @@
 class Renderable
 {
 	friend class World;
+	friend class SpatialIndex;
 
 public:
 	/**
@@ -46,7 +47,7 @@ public:
 	 * 
 	 * @param _deleteMe 
 	 */
-	Renderable() : _deleteMe(false) {}
+	Renderable() : _deleteMe(false), _threadSafe(false), _cullable(true), _batchable(false), _inSpatialIndex(false), _visibleStamp(0), _layerSlot(-1), _deferredAddSlot(-1) {}
 	
 	/**
 	 * Abstract base class needs a virtual destructor. 
@@ -101,6 +102,69 @@ public:
 	 * @return The world layer for this Renderable
 	 */
 	int GetLayer() {return _layer;}
+	
+	/**
+	 * Lets the World know that this Renderable's Update can safely run on 
+	 *  another thread at the same time as other Renderables' Updates. Only
+	 *  matters if World::SetParallelUpdate has been turned on. 
+	 * 
+	 * To be thread-safe, Update should only change this Renderable's own 
+	 *  state. Broadcasting messages and adding or removing Renderables from
+	 *  the World is fine (they get held until the parallel phase is over), 
+	 *  but anything else that touches shared state -- physics, sounds, 
+	 *  tags, names, subscriptions, other Actors -- is not. 
+	 * 
+	 * @param threadSafe Whether Update can run in parallel
+	 */
+	void SetThreadSafe(bool threadSafe) {_threadSafe = threadSafe;}
+	
+	/**
+	 * Find out whether this Renderable can be updated in parallel. 
+	 * 
+	 * @return True if it's been marked thread-safe
+	 */
+	bool IsThreadSafe() {return _threadSafe;}
+	
+	/**
+	 * Lets the World skip drawing this Renderable when its bounding box is
+	 *  entirely outside the camera's view. On by default, but only Actors 
+	 *  that the SpatialIndex is tracking are ever culled. Turn it off for 
+	 *  anything whose Render draws outside of its own bounds (the 
+	 *  ParticleActor does this itself). 
+	 * 
+	 * @param cullable Whether this Renderable can be culled
+	 */
+	void SetCullable(bool cullable) {_cullable = cullable;}
+	
+	/**
+	 * Find out whether this Renderable can be skipped when it's off-camera. 
+	 * 
+	 * @return True if it can be culled
+	 */
+	bool IsCullable() {return _cullable;}
+	
+	/**
+	 * Lets the World know that this Renderable only draws by handing 
+	 *  sprites to the SpriteBatch, the way the default Actor::Render does. 
+	 *  Anything that isn't batchable gets the batch flushed before it's 
+	 *  drawn, and Actor::Render draws it right away instead of batching, 
+	 *  so its own drawing stacks in order with the sprites around it. 
+	 * 
+	 * Actors turn this on in their constructor. If your Actor subclass 
+	 *  overrides Render to do any drawing of its own (even on top of 
+	 *  Actor::Render), turn it off in your constructor. 
+	 * 
+	 * @param batchable Whether this Renderable only draws through the batch
+	 */
+	void SetBatchable(bool batchable) {_batchable = batchable;}
+	
+	/**
+	 * Find out whether this Renderable can be drawn without flushing the 
+	 *  SpriteBatch first. 
+	 * 
+	 * @return True if it only draws through the batch
+	 */
+	bool IsBatchable() {return _batchable;}
 protected:
 	/**
 	 * Will get called before this Renderable is destroyed (if you do it via 
@@ -111,5 +175,17 @@ protected:
 
 protected:
 	bool _deleteMe;
+	bool _threadSafe;
+	bool _cullable;
+	bool _batchable;
+	// Set by the SpatialIndex while it's tracking us
+	bool _inSpatialIndex;
+	// Matches the World's cull stamp when we were in view this frame
+	unsigned int _visibleStamp;
 	int _layer;
+	
+	// Where we sit in our layer's list, or -1 if we're not in the World
+	int _layerSlot;
+	// Where we sit in the World's deferred adds, or -1 if we're not waiting
+	int _deferredAddSlot;
 };
@@ -34,21 +34,9 @@
 
 RenderableIterator& RenderableIterator::begin()
 {
-	if (theWorld.GetLayers().size() == 0)
-	{
-		return end();
-	}
-	_layerIterator = theWorld.GetLayers().begin();
-	while ((_layerIterator->second.size() == 0))
-	{
-		if (_layerIterator == theWorld.GetLayers().end())
-		{
-			return end();
-		}
-		_layerIterator++;
-	}
-	_myIterator = _layerIterator->second.begin();
-	_ptr = *_myIterator;
+	_layerIndex = 0;
+	_slotIndex = 0;
+	SeekLive();
 	return *this;
 }
 
@@ -66,67 +54,48 @@ bool RenderableIterator::operator!=( const RenderableIterator& iter ) const
 RenderableIterator& RenderableIterator::erase( RenderableIterator& item_to_remove )
 {
 	Renderable* pValueToErase = *item_to_remove;
-
-	RenderLayers::iterator layerElements = theWorld.GetLayers().find( pValueToErase->GetLayer() );
-	if (layerElements != theWorld.GetLayers().end())
+	if (pValueToErase != NULL)
 	{
-		RenderList::iterator element = (*layerElements).second.begin();
-
-		while ( element != (*layerElements).second.end() )
-		{
-			if ( *element == pValueToErase)
-			{					
-				_myIterator = (*layerElements).second.erase(element);
-
-				// Have to force to next layer.
-				// Let our ++ operator do it's magic.
-				if ( _myIterator == (*layerElements).second.end() )
-				{
-					++item_to_remove;
-				}
-				else
-				{
-					_ptr = *_myIterator;
-				}
-
-				return *this;
-			}
-			++element;
-		}
+		theWorld.ClearLayerSlot(pValueToErase);
+		++item_to_remove;
+	}
+	if (&item_to_remove != this)
+	{
+		*this = item_to_remove;
 	}
 	return *this;
 }
 
 const RenderableIterator& RenderableIterator::operator++()
 {
-	if (_myIterator == _layerIterator->second.end())
+	if (_ptr == NULL)
 	{
-		if (_layerIterator == theWorld.GetLayers().end())
-		{
-			_ptr = 0;
-			return *this;
-		}
+		return *this;
 	}
-	else
-		++_myIterator;
 
-	// See if we've reached the end of the vector for the current layer.
-	if (_myIterator == _layerIterator->second.end())
-	{
-		++_layerIterator;
-		// Go through layers until you reach the end or a non-empty layer.
-		while (_layerIterator != theWorld.GetLayers().end() && _layerIterator->second.size() == 0)
-			++_layerIterator;
+	++_slotIndex;
+	SeekLive();
+	return *this;
+}
 
-		if (_layerIterator != theWorld.GetLayers().end() && _layerIterator->second.size() > 0)
-		{	
-			_myIterator = _layerIterator->second.begin();
+void RenderableIterator::SeekLive()
+{
+	// Skip over empty slots and layers until we land on something.
+	RenderLayers& layers = theWorld.GetLayers();
+	while (_layerIndex < layers.size())
+	{
+		RenderList& renderables = layers[_layerIndex]._renderables;
+		while (_slotIndex < renderables.size())
+		{
+			if (renderables[_slotIndex] != NULL)
+			{
+				_ptr = renderables[_slotIndex];
+				return;
+			}
+			++_slotIndex;
 		}
-		else
-			_ptr = NULL;
+		++_layerIndex;
+		_slotIndex = 0;
 	}
-	if (_ptr)
-		_ptr = *_myIterator;
-
-	return *this;
-}
\ No newline at end of file
+	_ptr = NULL;
+}
@@ -32,7 +32,24 @@
 #include "../Infrastructure/Renderable.h"
 
 typedef std::vector<Renderable*>	RenderList;
-typedef std::map<int, RenderList>	RenderLayers;
+
+///A single layer of Renderables in the World
+/** 
+ * Removing a Renderable just clears its slot to NULL, so it's constant 
+ *  time; the World squeezes the holes out once per frame,
+ *  keeping everything else in the order it was added. Anything walking 
+ *  the list directly should skip NULL entries. 
+ */
+struct RenderLayer
+{
+	int			_layer;
+	RenderList	_renderables;
+	// Whether off-camera Actors in this layer are skipped when drawing
+	bool		_cull;
+};
+
+// Sorted by layer number, lowest first
+typedef std::vector<RenderLayer>	RenderLayers;
 
 ///An iterator class to access Renderables in the World
 /** 
@@ -43,7 +60,7 @@ typedef std::map<int, RenderList>	RenderLayers;
 class RenderableIterator: public std::iterator<std::forward_iterator_tag, Renderable*>
 {
 public:
-	RenderableIterator() : _ptr(NULL)
+	RenderableIterator() : _layerIndex(0), _slotIndex(0), _ptr(NULL)
 	{
 	}
 
@@ -60,7 +77,9 @@ public:
 	const RenderableIterator& operator++();
 
 private:	
-	RenderLayers::iterator _layerIterator;
-	RenderList::iterator _myIterator;
+	void SeekLive();
+
+	unsigned int _layerIndex;
+	unsigned int _slotIndex;
 	Renderable *_ptr;
 };
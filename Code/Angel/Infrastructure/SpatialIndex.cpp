@@ -0,0 +1,562 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "../Infrastructure/SpatialIndex.h"
+
+#include "../Infrastructure/JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Anything spanning more cells than this goes in the oversized list.
+static const int s_maxCellsPerEntry = 64;
+
+SpatialIndex* SpatialIndex::s_SpatialIndex = NULL;
+
+SpatialIndex& SpatialIndex::GetInstance()
+{
+	if (s_SpatialIndex == NULL)
+	{
+		s_SpatialIndex = new SpatialIndex();
+	}
+	return *s_SpatialIndex;
+}
+
+SpatialIndex::SpatialIndex()
+{
+	_cellSize = 4.0f;
+	_numTracked = 0;
+	_queryStamp = 0;
+	_deferring = false;
+}
+
+int SpatialIndex::GetCellCoord(float position) const
+{
+	return (int)floorf(position / _cellSize);
+}
+
+// The grid wraps every 65536 cells in each direction. Wrapped neighbors 
+//  only ever cost a wasted box test, since every candidate is checked.
+static unsigned int CellKey(int x, int y)
+{
+	return (((unsigned int)x & 0xFFFF) << 16) | ((unsigned int)y & 0xFFFF);
+}
+
+SpatialIndex::Cell* SpatialIndex::FindCell(int x, int y)
+{
+	hashmap_ns::hash_map<unsigned int, int>::iterator it = _cellLookup.find(CellKey(x, y));
+	if (it == _cellLookup.end())
+	{
+		return NULL;
+	}
+	return &_cells[it->second];
+}
+
+void SpatialIndex::Insert(int index)
+{
+	Entry& entry = _entries[index];
+	entry._box = entry._actor->GetBoundingBox();
+	entry._minX = GetCellCoord(entry._box.Min.X);
+	entry._minY = GetCellCoord(entry._box.Min.Y);
+	entry._maxX = GetCellCoord(entry._box.Max.X);
+	entry._maxY = GetCellCoord(entry._box.Max.Y);
+
+	long long numCells = (long long)(entry._maxX - entry._minX + 1) * (long long)(entry._maxY - entry._minY + 1);
+	if ((numCells > s_maxCellsPerEntry) || (numCells <= 0))
+	{
+		entry._oversizedSlot = (int)_oversized.size();
+		_oversized.push_back(index);
+		return;
+	}
+
+	entry._oversizedSlot = -1;
+	for (int x = entry._minX; x <= entry._maxX; x++)
+	{
+		for (int y = entry._minY; y <= entry._maxY; y++)
+		{
+			unsigned int key = CellKey(x, y);
+			hashmap_ns::hash_map<unsigned int, int>::iterator it = _cellLookup.find(key);
+			int cellIndex;
+			if (it != _cellLookup.end())
+			{
+				cellIndex = it->second;
+			}
+			else
+			{
+				if (_freeCells.empty())
+				{
+					cellIndex = (int)_cells.size();
+					_cells.push_back(Cell());
+				}
+				else
+				{
+					cellIndex = _freeCells.back();
+					_freeCells.pop_back();
+				}
+				_cells[cellIndex]._inUse = true;
+				_cellLookup[key] = cellIndex;
+			}
+			_cells[cellIndex]._entries.push_back(index);
+		}
+	}
+}
+
+void SpatialIndex::Extract(int index)
+{
+	Entry& entry = _entries[index];
+	if (entry._oversizedSlot >= 0)
+	{
+		int last = _oversized.back();
+		_oversized[entry._oversizedSlot] = last;
+		_entries[last]._oversizedSlot = entry._oversizedSlot;
+		_oversized.pop_back();
+		entry._oversizedSlot = -1;
+		return;
+	}
+
+	for (int x = entry._minX; x <= entry._maxX; x++)
+	{
+		for (int y = entry._minY; y <= entry._maxY; y++)
+		{
+			unsigned int key = CellKey(x, y);
+			hashmap_ns::hash_map<unsigned int, int>::iterator it = _cellLookup.find(key);
+			if (it == _cellLookup.end())
+			{
+				continue;
+			}
+			Cell& cell = _cells[it->second];
+			std::vector<int>::iterator found = std::find(cell._entries.begin(), cell._entries.end(), index);
+			if (found != cell._entries.end())
+			{
+				*found = cell._entries.back();
+				cell._entries.pop_back();
+			}
+			if (cell._entries.empty())
+			{
+				cell._inUse = false;
+				_freeCells.push_back(it->second);
+				_cellLookup.erase(it);
+			}
+		}
+	}
+}
+
+void SpatialIndex::Relocate(int index)
+{
+	Entry& entry = _entries[index];
+	BoundingBox box = entry._actor->GetBoundingBox();
+	if ((entry._oversizedSlot < 0) &&
+		(GetCellCoord(box.Min.X) == entry._minX) && (GetCellCoord(box.Min.Y) == entry._minY) &&
+		(GetCellCoord(box.Max.X) == entry._maxX) && (GetCellCoord(box.Max.Y) == entry._maxY))
+	{
+		// Still in the same cells; the common case for small moves.
+		entry._box = box;
+		return;
+	}
+	Extract(index);
+	Insert(index);
+}
+
+void SpatialIndex::Add(Actor* actor)
+{
+	// Without a handle it has no index of its own; it'd share slot 0
+	if ((actor == NULL) || actor->_inSpatialIndex || actor->IsScreenSpace() || (actor->GetHandle() == INVALID_ACTOR_HANDLE))
+	{
+		return;
+	}
+
+	int index = actor->GetHandleIndex();
+	if (index >= (int)_entries.size())
+	{
+		Entry blank;
+		blank._actor = NULL;
+		blank._minX = blank._minY = blank._maxX = blank._maxY = 0;
+		blank._oversizedSlot = -1;
+		blank._queryStamp = 0;
+		blank._tracked = false;
+		blank._dirty = false;
+		_entries.resize(index + 1, blank);
+	}
+
+	Entry& entry = _entries[index];
+	entry._actor = actor;
+	entry._tracked = true;
+	entry._dirty = false;
+	actor->_inSpatialIndex = true;
+	_numTracked++;
+	Insert(index);
+}
+
+void SpatialIndex::Remove(Actor* actor)
+{
+	if ((actor == NULL) || !actor->_inSpatialIndex)
+	{
+		return;
+	}
+
+	int index = actor->GetHandleIndex();
+	Extract(index);
+	Entry& entry = _entries[index];
+	entry._actor = NULL;
+	entry._tracked = false;
+	actor->_inSpatialIndex = false;
+	_numTracked--;
+}
+
+void SpatialIndex::Update(Actor* actor)
+{
+	if (!actor->_inSpatialIndex)
+	{
+		return;
+	}
+
+	int index = actor->GetHandleIndex();
+	if ((index >= (int)_entries.size()) || !_entries[index]._tracked)
+	{
+		return;
+	}
+
+	if (_deferring)
+	{
+		int thread = theJobSystem.GetCurrentThreadIndex();
+		if ((thread >= 0) && (thread < (int)_deferredUpdates.size()))
+		{
+			// Each Actor is only ever updated by one thread at a time, so 
+			//  its own flag is safe to touch.
+			Entry& entry = _entries[index];
+			if (!entry._dirty)
+			{
+				entry._dirty = true;
+				_deferredUpdates[thread].push_back(index);
+			}
+			return;
+		}
+	}
+
+	Relocate(index);
+}
+
+void SpatialIndex::DeferUpdates(int numThreads)
+{
+	if ((int)_deferredUpdates.size() < numThreads)
+	{
+		_deferredUpdates.resize(numThreads);
+	}
+	_deferring = true;
+}
+
+void SpatialIndex::FlushDeferredUpdates()
+{
+	_deferring = false;
+
+	_scratch.clear();
+	for (unsigned int i=0; i < _deferredUpdates.size(); i++)
+	{
+		_scratch.insert(_scratch.end(), _deferredUpdates[i].begin(), _deferredUpdates[i].end());
+		_deferredUpdates[i].clear();
+	}
+	std::sort(_scratch.begin(), _scratch.end());
+
+	for (unsigned int i=0; i < _scratch.size(); i++)
+	{
+		Entry& entry = _entries[_scratch[i]];
+		entry._dirty = false;
+		if (entry._tracked)
+		{
+			Relocate(_scratch[i]);
+		}
+	}
+	_scratch.clear();
+}
+
+void SpatialIndex::SetCellSize(float cellSize)
+{
+	if ((cellSize <= 0.0f) || (cellSize == _cellSize))
+	{
+		return;
+	}
+
+	_cellSize = cellSize;
+	_cells.clear();
+	_freeCells.clear();
+	_cellLookup.clear();
+	_oversized.clear();
+	for (unsigned int i=0; i < _entries.size(); i++)
+	{
+		if (_entries[i]._tracked)
+		{
+			Insert(i);
+		}
+	}
+}
+
+void SpatialIndex::Gather(const BoundingBox& box, std::vector<int>& indices)
+{
+	// Stamp each Entry as we see it, since big ones sit in several cells.
+	if (++_queryStamp == 0)
+	{
+		for (unsigned int i=0; i < _entries.size(); i++)
+		{
+			_entries[i]._queryStamp = 0;
+		}
+		_queryStamp = 1;
+	}
+
+	for (unsigned int i=0; i < _oversized.size(); i++)
+	{
+		Entry& entry = _entries[_oversized[i]];
+		entry._queryStamp = _queryStamp;
+		if (entry._box.Intersects(box))
+		{
+			indices.push_back(_oversized[i]);
+		}
+	}
+
+	int minX = GetCellCoord(box.Min.X);
+	int minY = GetCellCoord(box.Min.Y);
+	int maxX = GetCellCoord(box.Max.X);
+	int maxY = GetCellCoord(box.Max.Y);
+	long long numCells = (long long)(maxX - minX + 1) * (long long)(maxY - minY + 1);
+
+	// A big query is cheaper as a walk over the cells we actually have.
+	if ((numCells > (long long)_cellLookup.size()) || (numCells <= 0))
+	{
+		for (unsigned int c=0; c < _cells.size(); c++)
+		{
+			if (!_cells[c]._inUse)
+			{
+				continue;
+			}
+			const std::vector<int>& cellEntries = _cells[c]._entries;
+			for (unsigned int i=0; i < cellEntries.size(); i++)
+			{
+				Entry& entry = _entries[cellEntries[i]];
+				if (entry._queryStamp == _queryStamp)
+				{
+					continue;
+				}
+				entry._queryStamp = _queryStamp;
+				if (entry._box.Intersects(box))
+				{
+					indices.push_back(cellEntries[i]);
+				}
+			}
+		}
+		return;
+	}
+
+	for (int x = minX; x <= maxX; x++)
+	{
+		for (int y = minY; y <= maxY; y++)
+		{
+			Cell* cell = FindCell(x, y);
+			if (cell == NULL)
+			{
+				continue;
+			}
+			for (unsigned int i=0; i < cell->_entries.size(); i++)
+			{
+				Entry& entry = _entries[cell->_entries[i]];
+				if (entry._queryStamp == _queryStamp)
+				{
+					continue;
+				}
+				entry._queryStamp = _queryStamp;
+				if (entry._box.Intersects(box))
+				{
+					indices.push_back(cell->_entries[i]);
+				}
+			}
+		}
+	}
+}
+
+void SpatialIndex::QueryAABB(const BoundingBox& box, ActorList& results)
+{
+	_scratch.clear();
+	Gather(box, _scratch);
+	for (unsigned int i=0; i < _scratch.size(); i++)
+	{
+		results.push_back(_entries[_scratch[i]]._actor);
+	}
+}
+
+void SpatialIndex::QueryRadius(const Vector2& center, float radius, ActorList& results)
+{
+	_scratch.clear();
+	Gather(BoundingBox(center - Vector2(radius), center + Vector2(radius)), _scratch);
+	for (unsigned int i=0; i < _scratch.size(); i++)
+	{
+		Entry& entry = _entries[_scratch[i]];
+		if (entry._box.Intersects(center, radius))
+		{
+			results.push_back(entry._actor);
+		}
+	}
+}
+
+// Slab test; returns how far along the segment (0 to 1) it enters the box.
+static bool SegmentHitsBox(const Vector2& start, const Vector2& delta, const BoundingBox& box, float& entry)
+{
+	float tMin = 0.0f;
+	float tMax = 1.0f;
+	for (int axis=0; axis < 2; axis++)
+	{
+		float origin = (axis == 0) ? start.X : start.Y;
+		float dir = (axis == 0) ? delta.X : delta.Y;
+		float low = (axis == 0) ? box.Min.X : box.Min.Y;
+		float high = (axis == 0) ? box.Max.X : box.Max.Y;
+		if (fabsf(dir) < MathUtil::Epsilon)
+		{
+			if ((origin < low) || (origin > high))
+			{
+				return false;
+			}
+			continue;
+		}
+		float t1 = (low - origin) / dir;
+		float t2 = (high - origin) / dir;
+		if (t1 > t2)
+		{
+			float swap = t1;
+			t1 = t2;
+			t2 = swap;
+		}
+		tMin = MathUtil::Max(tMin, t1);
+		tMax = MathUtil::Min(tMax, t2);
+		if (tMin > tMax)
+		{
+			return false;
+		}
+	}
+	entry = tMin;
+	return true;
+}
+
+void SpatialIndex::QueryRay(const Vector2& start, const Vector2& end, ActorList& results)
+{
+	if (++_queryStamp == 0)
+	{
+		for (unsigned int i=0; i < _entries.size(); i++)
+		{
+			_entries[i]._queryStamp = 0;
+		}
+		_queryStamp = 1;
+	}
+	_rayHits.clear();
+
+	Vector2 delta = end - start;
+	RayHit hit;
+	for (unsigned int i=0; i < _oversized.size(); i++)
+	{
+		Entry& entry = _entries[_oversized[i]];
+		entry._queryStamp = _queryStamp;
+		if (SegmentHitsBox(start, delta, entry._box, hit._distance))
+		{
+			hit._index = _oversized[i];
+			_rayHits.push_back(hit);
+		}
+	}
+
+	// Walk the cells the segment passes through (Amanatides & Woo).
+	int x = GetCellCoord(start.X);
+	int y = GetCellCoord(start.Y);
+	int endX = GetCellCoord(end.X);
+	int endY = GetCellCoord(end.Y);
+	int stepX = (delta.X > 0.0f) ? 1 : -1;
+	int stepY = (delta.Y > 0.0f) ? 1 : -1;
+	float tDeltaX = (fabsf(delta.X) > MathUtil::Epsilon) ? (_cellSize / fabsf(delta.X)) : MathUtil::MaxFloat;
+	float tDeltaY = (fabsf(delta.Y) > MathUtil::Epsilon) ? (_cellSize / fabsf(delta.Y)) : MathUtil::MaxFloat;
+	float nextX = (stepX > 0) ? ((x + 1) * _cellSize) : (x * _cellSize);
+	float nextY = (stepY > 0) ? ((y + 1) * _cellSize) : (y * _cellSize);
+	float tMaxX = (fabsf(delta.X) > MathUtil::Epsilon) ? ((nextX - start.X) / delta.X) : MathUtil::MaxFloat;
+	float tMaxY = (fabsf(delta.Y) > MathUtil::Epsilon) ? ((nextY - start.Y) / delta.Y) : MathUtil::MaxFloat;
+
+	int steps = abs(endX - x) + abs(endY - y) + 1;
+	for (int s=0; s < steps; s++)
+	{
+		Cell* cell = FindCell(x, y);
+		if (cell != NULL)
+		{
+			for (unsigned int i=0; i < cell->_entries.size(); i++)
+			{
+				Entry& entry = _entries[cell->_entries[i]];
+				if (entry._queryStamp == _queryStamp)
+				{
+					continue;
+				}
+				entry._queryStamp = _queryStamp;
+				if (SegmentHitsBox(start, delta, entry._box, hit._distance))
+				{
+					hit._index = cell->_entries[i];
+					_rayHits.push_back(hit);
+				}
+			}
+		}
+
+		if (tMaxX < tMaxY)
+		{
+			tMaxX += tDeltaX;
+			x += stepX;
+		}
+		else
+		{
+			tMaxY += tDeltaY;
+			y += stepY;
+		}
+	}
+
+	std::sort(_rayHits.begin(), _rayHits.end());
+	for (unsigned int i=0; i < _rayHits.size(); i++)
+	{
+		results.push_back(_entries[_rayHits[i]._index]._actor);
+	}
+}
+
+ActorList SpatialIndex::GetActorsInBox(const Vector2& min, const Vector2& max)
+{
+	ActorList forReturn;
+	QueryAABB(BoundingBox(min, max), forReturn);
+	return forReturn;
+}
+
+ActorList SpatialIndex::GetActorsInRadius(const Vector2& center, float radius)
+{
+	ActorList forReturn;
+	QueryRadius(center, radius, forReturn);
+	return forReturn;
+}
+
+ActorList SpatialIndex::GetActorsAlongRay(const Vector2& start, const Vector2& end)
+{
+	ActorList forReturn;
+	QueryRay(start, end, forReturn);
+	return forReturn;
+}
@@ -0,0 +1,259 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../Actors/Actor.h"
+#include "../AI/BoundingShapes.h"
+
+//singleton shortcut
+#define theSpatialIndex SpatialIndex::GetInstance()
+
+///Keeps track of where every Actor in the World is, for proximity queries
+/** 
+ * Every Actor that's in the World (except screen-space ones like HUDActors)
+ *  is filed into a uniform grid by its bounding box. The grid is hashed, so
+ *  it doesn't need to know how big your level is, and it's kept up to date 
+ *  as Actors move and resize -- there's no rebuilding step. Physics Actors
+ *  are picked up when Box2D moves them, too, and you don't need them to be
+ *  in Box2D at all. 
+ * 
+ * Queries check the boxes the Actors had the last time they moved, which 
+ *  is what Actor::GetBoundingBox returns. Anything larger than a handful 
+ *  of cells is kept in a separate list that every query looks at, so a 
+ *  huge background doesn't get smeared across the grid. 
+ * 
+ * Pick a cell size somewhere around the size of your typical Actor. 
+ * 
+ * Like the World, it uses the singleton pattern; use "theSpatialIndex" to 
+ *  access it. Only query it from the main thread. 
+ */
+class SpatialIndex
+{
+public:
+	/**
+	 * Used to access the singleton instance of this class. As a shortcut, 
+	 *  you can just use "theSpatialIndex". 
+	 * 
+	 * @return The singleton
+	 */
+	static SpatialIndex& GetInstance();
+	
+	/**
+	 * Finds every Actor whose bounding box overlaps a given box. 
+	 * 
+	 * @param box The area to look in
+	 * @param results The Actors are appended here (it's not cleared first)
+	 */
+	void QueryAABB(const BoundingBox& box, ActorList& results);
+	
+	/**
+	 * Finds every Actor whose bounding box comes within a given distance of
+	 *  a point. 
+	 * 
+	 * @param center The point to look around
+	 * @param radius How far to look
+	 * @param results The Actors are appended here (it's not cleared first)
+	 */
+	void QueryRadius(const Vector2& center, float radius, ActorList& results);
+	
+	/**
+	 * Finds every Actor whose bounding box is crossed by a line segment, 
+	 *  nearest to the start first. Only the cells along the segment are 
+	 *  looked at. 
+	 * 
+	 * @param start Where the segment starts
+	 * @param end Where the segment ends
+	 * @param results The Actors are appended here (it's not cleared first)
+	 */
+	void QueryRay(const Vector2& start, const Vector2& end, ActorList& results);
+	
+	/**
+	 * A version of QueryAABB that returns a new list, which is easier to use
+	 *  from script. 
+	 * 
+	 * @param min The bottom-left corner of the area
+	 * @param max The top-right corner of the area
+	 * @return The overlapping Actors
+	 */
+	ActorList GetActorsInBox(const Vector2& min, const Vector2& max);
+	
+	/**
+	 * A version of QueryRadius that returns a new list. 
+	 * 
+	 * @param center The point to look around
+	 * @param radius How far to look
+	 * @return The Actors within range
+	 */
+	ActorList GetActorsInRadius(const Vector2& center, float radius);
+	
+	/**
+	 * A version of QueryRay that returns a new list. 
+	 * 
+	 * @param start Where the segment starts
+	 * @param end Where the segment ends
+	 * @return The Actors it crosses, nearest first
+	 */
+	ActorList GetActorsAlongRay(const Vector2& start, const Vector2& end);
+	
+	/**
+	 * Changes the size of the grid cells, which refiles every Actor. 
+	 * 
+	 * @param cellSize The width and height of a cell, in world units
+	 */
+	void SetCellSize(float cellSize);
+	
+	/**
+	 * Get the current size of the grid cells. 
+	 * 
+	 * @return The width and height of a cell, in world units
+	 */
+	const float GetCellSize() const { return _cellSize; }
+	
+	/**
+	 * Get the number of Actors in the index. 
+	 * 
+	 * @return How many Actors are being tracked
+	 */
+	const int GetNumTracked() const { return _numTracked; }
+	
+	/**
+	 * Get the number of grid cells that have something in them. 
+	 * 
+	 * @return The number of occupied cells
+	 */
+	const int GetNumCells() const { return (int)_cellLookup.size(); }
+	
+	/**
+	 * Get the number of Actors that are too big to go in the grid. 
+	 * 
+	 * @return The size of the oversized list
+	 */
+	const int GetNumOversized() const { return (int)_oversized.size(); }
+	
+	/**
+	 * INTERNAL: Starts tracking an Actor. Called by the World when an Actor
+	 *  is added. 
+	 * 
+	 * @param actor The Actor to track
+	 */
+	void Add(Actor* actor);
+	
+	/**
+	 * INTERNAL: Stops tracking an Actor. Called by the World when an Actor
+	 *  is removed, and by the Actor when it's destroyed. 
+	 * 
+	 * @param actor The Actor to forget
+	 */
+	void Remove(Actor* actor);
+	
+	/**
+	 * INTERNAL: Refiles an Actor after its bounding box has changed. Called
+	 *  by the Actor itself. 
+	 * 
+	 * @param actor The Actor that moved
+	 */
+	void Update(Actor* actor);
+	
+	/**
+	 * INTERNAL: Called by the World before its parallel update. Until 
+	 *  FlushDeferredUpdates, Actors that move are just marked, so threads
+	 *  don't have to fight over the grid. 
+	 * 
+	 * @param numThreads The JobSystem's thread count
+	 */
+	void DeferUpdates(int numThreads);
+	
+	/**
+	 * INTERNAL: Called by the World after its parallel update to refile 
+	 *  everything that moved. They're refiled in index order, so the grid 
+	 *  comes out the same no matter which threads did what. 
+	 */
+	void FlushDeferredUpdates();
+	
+protected:
+	SpatialIndex();
+	static SpatialIndex* s_SpatialIndex;
+	
+private:
+	// One per Actor handle index
+	struct Entry
+	{
+		Actor* _actor;
+		BoundingBox _box;
+		int _minX, _minY, _maxX, _maxY;
+		// Where we are in _oversized, or -1 if we're in the grid
+		int _oversizedSlot;
+		unsigned int _queryStamp;
+		bool _tracked;
+		bool _dirty;
+	};
+	
+	struct Cell
+	{
+		std::vector<int> _entries;
+		bool _inUse;
+	};
+	
+	int GetCellCoord(float position) const;
+	Cell* FindCell(int x, int y);
+	void Insert(int index);
+	void Extract(int index);
+	void Relocate(int index);
+	void Gather(const BoundingBox& box, std::vector<int>& indices);
+	
+	float _cellSize;
+	std::vector<Entry> _entries;
+	std::vector<Cell> _cells;
+	std::vector<int> _freeCells;
+	hashmap_ns::hash_map<unsigned int, int> _cellLookup;
+	std::vector<int> _oversized;
+	int _numTracked;
+	unsigned int _queryStamp;
+	
+	bool _deferring;
+	std::vector< std::vector<int> > _deferredUpdates;
+	std::vector<int> _scratch;
+	
+	struct RayHit
+	{
+		float _distance;
+		int _index;
+		
+		bool operator<(const RayHit& other) const
+		{
+			if (_distance != other._distance)
+			{
+				return _distance < other._distance;
+			}
+			return _index < other._index;
+		}
+	};
+	std::vector<RayHit> _rayHits;
+};
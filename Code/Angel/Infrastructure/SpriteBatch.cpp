@@ -0,0 +1,197 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "../Infrastructure/SpriteBatch.h"
+
+#include "../Util/MathUtil.h"
+
+#include <algorithm>
+
+// Same corners Actor uses for its triangle strip
+static const float s_quadCorners[] = {
+	-0.5f,  0.5f,
+	-0.5f, -0.5f,
+	 0.5f,  0.5f,
+	 0.5f, -0.5f,
+};
+
+// Two counter-clockwise triangles out of the four strip corners
+static const int s_triangleCorners[] = { 0, 1, 2, 2, 1, 3 };
+
+SpriteBatch* SpriteBatch::s_SpriteBatch = NULL;
+
+SpriteBatch::SpriteBatch()
+{
+	_enabled = true;
+	_open = false;
+	
+	_drawCalls = _vertexCount = _spriteCount = 0;
+	_lastDrawCalls = _lastVertices = _lastSprites = 0;
+}
+
+SpriteBatch& SpriteBatch::GetInstance()
+{
+	if (s_SpriteBatch == NULL)
+	{
+		s_SpriteBatch = new SpriteBatch();
+	}
+	return *s_SpriteBatch;
+}
+
+void SpriteBatch::SetEnabled(bool enabled)
+{
+	if (!enabled)
+	{
+		Flush();
+		_open = false;
+	}
+	_enabled = enabled;
+}
+
+void SpriteBatch::BeginFrame()
+{
+	_drawCalls = _vertexCount = _spriteCount = 0;
+	_open = _enabled;
+}
+
+void SpriteBatch::EndFrame()
+{
+	Flush();
+	_open = false;
+	
+	_lastDrawCalls = _drawCalls;
+	_lastVertices = _vertexCount;
+	_lastSprites = _spriteCount;
+}
+
+bool SpriteBatch::AddSprite(int textureReference, const Vector2& position, const Vector2& size, float rotation, const Color& color, const float* uvs)
+{
+	if (!_open)
+	{
+		return false;
+	}
+	
+	float cosRot = 1.0f;
+	float sinRot = 0.0f;
+	if (rotation != 0.0f)
+	{
+		float radians = MathUtil::ToRadians(rotation);
+		cosRot = cos(radians);
+		sinRot = sin(radians);
+	}
+	
+	++_spriteCount;
+	
+	SortKey key;
+	key._texture = textureReference < 0 ? -1 : textureReference;
+	key._index = (int)_quads.size();
+	_keys.push_back(key);
+	
+	_quads.push_back(SpriteQuad());
+	SpriteQuad& quad = _quads.back();
+	for (int i=0; i < 4; i++)
+	{
+		float localX = s_quadCorners[i*2] * size.X;
+		float localY = s_quadCorners[(i*2)+1] * size.Y;
+		
+		SpriteVertex& vert = quad.Corners[i];
+		vert.X = position.X + (localX * cosRot) - (localY * sinRot);
+		vert.Y = position.Y + (localX * sinRot) + (localY * cosRot);
+		vert.U = uvs[i*2];
+		vert.V = uvs[(i*2)+1];
+		vert.R = color.R;
+		vert.G = color.G;
+		vert.B = color.B;
+		vert.A = color.A;
+	}
+	
+	return true;
+}
+
+void SpriteBatch::Flush()
+{
+	if (_quads.empty())
+	{
+		return;
+	}
+	
+	// Group by texture; the index keeps the submission order within a group.
+	std::sort(_keys.begin(), _keys.end());
+	
+	_vertices.resize(_quads.size() * 6);
+	for (unsigned int i=0; i < _keys.size(); i++)
+	{
+		const SpriteQuad& quad = _quads[_keys[i]._index];
+		for (int j=0; j < 6; j++)
+		{
+			_vertices[(i*6)+j] = quad.Corners[s_triangleCorners[j]];
+		}
+	}
+	
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(SpriteVertex), &_vertices[0].X);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(SpriteVertex), &_vertices[0].U);
+	glColorPointer(4, GL_FLOAT, sizeof(SpriteVertex), &_vertices[0].R);
+	
+	unsigned int runStart = 0;
+	while (runStart < _keys.size())
+	{
+		int texture = _keys[runStart]._texture;
+		unsigned int runEnd = runStart + 1;
+		while (runEnd < _keys.size() && _keys[runEnd]._texture == texture)
+		{
+			++runEnd;
+		}
+		
+		if (texture >= 0)
+		{
+			glEnable(GL_TEXTURE_2D);
+			glBindTexture(GL_TEXTURE_2D, texture);
+		}
+		else
+		{
+			glDisable(GL_TEXTURE_2D);
+		}
+		glDrawArrays(GL_TRIANGLES, runStart * 6, (runEnd - runStart) * 6);
+		++_drawCalls;
+		
+		runStart = runEnd;
+	}
+	
+	glDisable(GL_TEXTURE_2D);
+	glDisableClientState(GL_COLOR_ARRAY);
+	
+	_vertexCount += (int)_vertices.size();
+	
+	_quads.clear();
+	_keys.clear();
+}
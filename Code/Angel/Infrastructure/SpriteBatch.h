@@ -0,0 +1,211 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../Infrastructure/Vector2.h"
+#include "../Infrastructure/Color.h"
+
+//singleton shortcut
+#define theSpriteBatch SpriteBatch::GetInstance()
+
+///Collects sprite quads and draws them with as few OpenGL calls as possible
+/** 
+ * Drawing every Actor with its own matrix push, texture bind, and draw call
+ *  gets expensive once you have thousands of them on screen. While the World
+ *  is drawing its Renderables, the SpriteBatch is open, and the default 
+ *  Actor::Render implementation hands its quad over to it instead of 
+ *  drawing immediately. The quads get transformed on the CPU, sorted by 
+ *  texture, and drawn out of a single interleaved vertex array, with one 
+ *  draw call for each run of sprites that share a texture. 
+ * 
+ * The batch is flushed at the end of every layer, and whenever something 
+ *  needs to draw immediately (circles, display lists, TextActors, etc.), so 
+ *  layers still stack the way you'd expect. Within a layer, sprites may be 
+ *  reordered to group them by texture. 
+ * 
+ * Only Renderables marked with Renderable::SetBatchable go through the 
+ *  batch; the World flushes before drawing anything else. Actors are 
+ *  batchable by default, so an Actor subclass that overrides Render to do 
+ *  its own drawing should turn it off in its constructor. 
+ * 
+ * Like the World, it uses the singleton pattern; use "theSpriteBatch" to 
+ *  access it. 
+ */
+class SpriteBatch
+{
+public:
+	/**
+	 * Used to access the singleton instance of this class. As a shortcut, 
+	 *  you can just use "theSpriteBatch". 
+	 * 
+	 * @return The singleton
+	 */
+	static SpriteBatch& GetInstance();
+	
+	/**
+	 * Turns batching on or off. When it's off, every Actor draws itself 
+	 *  immediately like it used to, which can be handy for comparing 
+	 *  performance or tracking down a drawing problem. On by default. 
+	 * 
+	 * @param enabled Whether sprites should be batched
+	 */
+	void SetEnabled(bool enabled);
+	
+	/**
+	 * Find out whether batching is turned on. 
+	 * 
+	 * @return True if sprites will be batched
+	 */
+	const bool IsEnabled() const { return _enabled; }
+	
+	/**
+	 * Lets you know if the batch is currently accepting sprites. (It only 
+	 *  does so while the World is drawing its Renderables.) 
+	 * 
+	 * @return True if AddSprite will accept new sprites
+	 */
+	const bool IsOpen() const { return _open; }
+	
+	/**
+	 * Queues up a textured quad to be drawn at the next flush. The parameters
+	 *  are the same ones Actor::Render uses. 
+	 * 
+	 * @param textureReference The OpenGL texture to use, or a negative number
+	 *   for an untextured quad
+	 * @param position The center of the quad in world coordinates
+	 * @param size The width and height of the quad
+	 * @param rotation The rotation of the quad in degrees
+	 * @param color The color to tint the quad
+	 * @param uvs The eight texture coordinates for the four corners, in the 
+	 *   same order Actor stores them
+	 * @return True if the quad was accepted; false if the batch is closed or
+	 *   disabled, in which case the caller needs to draw it itself
+	 */
+	bool AddSprite(int textureReference, const Vector2& position, const Vector2& size, float rotation, const Color& color, const float* uvs);
+	
+	/**
+	 * Draws everything that's been queued up and empties the batch. Does 
+	 *  nothing if the batch is empty, so it's cheap to call defensively 
+	 *  before doing any immediate-mode drawing. 
+	 */
+	void Flush();
+	
+	/**
+	 * Get the number of draw calls made while drawing the World's 
+	 *  Renderables last frame. Renderables that drew themselves immediately 
+	 *  count as one call each. 
+	 * 
+	 * @return The number of draw calls
+	 */
+	const int GetDrawCallCount() const { return _lastDrawCalls; }
+	
+	/**
+	 * Get the number of vertices that went through the batch last frame. 
+	 * 
+	 * @return The number of batched vertices
+	 */
+	const int GetVertexCount() const { return _lastVertices; }
+	
+	/**
+	 * Get the number of sprites that were batched last frame. 
+	 * 
+	 * @return The number of batched sprites
+	 */
+	const int GetSpriteCount() const { return _lastSprites; }
+	
+	/**
+	 * INTERNAL: Called by the World when it starts drawing its Renderables. 
+	 */
+	void BeginFrame();
+	
+	/**
+	 * INTERNAL: The number of sprites handed to the batch so far this frame. 
+	 *  The World uses it to tell which Renderables drew themselves. 
+	 */
+	const int GetSubmittedCount() const { return _spriteCount; }
+	
+	/**
+	 * INTERNAL: Called by the World when something drew itself without 
+	 *  going through the batch, so it can be counted as a draw call. 
+	 */
+	void AddImmediateDraw() { ++_drawCalls; }
+	
+	/**
+	 * INTERNAL: Called by the World when it's done drawing its Renderables. 
+	 *  Flushes anything left over and closes the batch. 
+	 */
+	void EndFrame();
+	
+protected:
+	SpriteBatch();
+	static SpriteBatch* s_SpriteBatch;
+	
+private:
+	struct SpriteVertex
+	{
+		float X, Y;
+		float U, V;
+		float R, G, B, A;
+	};
+	
+	struct SpriteQuad
+	{
+		SpriteVertex Corners[4];
+	};
+	
+	struct SortKey
+	{
+		int _texture;
+		int _index;
+		
+		bool operator<(const SortKey& other) const
+		{
+			if (_texture != other._texture)
+			{
+				return _texture < other._texture;
+			}
+			return _index < other._index;
+		}
+	};
+	
+	bool _enabled;
+	bool _open;
+	
+	std::vector<SpriteQuad> _quads;
+	std::vector<SortKey> _keys;
+	std::vector<SpriteVertex> _vertices;
+	
+	int _drawCalls;
+	int _vertexCount;
+	int _spriteCount;
+	int _lastDrawCalls;
+	int _lastVertices;
+	int _lastSprites;
+};
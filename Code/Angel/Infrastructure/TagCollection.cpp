@@ -50,88 +50,271 @@ TagCollection::TagCollection()
 
 }
 
+// Index of the lowest set bit, via a de Bruijn sequence.
+static int LowestBit(unsigned int bits)
+{
+	static const int s_debruijnBits[32] = 
+	{
+		0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8, 
+		31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+	};
+	return s_debruijnBits[((bits & (0u - bits)) * 0x077CB531u) >> 27];
+}
+
+static int CountBits(unsigned int bits)
+{
+	bits = bits - ((bits >> 1) & 0x55555555u);
+	bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+	return (int)((((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+}
+
 ActorSet TagCollection::GetObjectsTagged(String findTag)
 {
-	StringList tags = SplitString(findTag, ", ");
-	if (tags.size() == 0)
+	ActorSet forReturn;
+	TagQuery query(findTag);
+	for (TagQuery::iterator it = query.begin(); it != query.end(); ++it)
 	{
-		return ActorSet();
+		forReturn.insert(*it);
 	}
-	else if (tags.size() == 1)
+	return forReturn;
+}
+
+StringSet TagCollection::GetTagList()
+{
+	StringSet forReturn;
+	for (unsigned int i=0; i < _tags.size(); i++)
 	{
-		findTag = ToLower(findTag);
-		std::map<String, ActorSet>::iterator it = _tagMappings.find(findTag);
-		if (it != _tagMappings.end())
+		if (_tags[i]._count > 0)
 		{
-			return it->second;
-		}
-		else
-		{
-			return ActorSet();
+			forReturn.insert(_tags[i]._name);
 		}
 	}
-	else
+
+	return forReturn;
+}
+
+const int TagCollection::GetTagId(const String& tag)
+{
+	String lowerTag = ToLower(tag);
+	hashmap_ns::hash_map<String, int>::iterator it = _tagIds.find(lowerTag);
+	if (it != _tagIds.end())
+	{
+		return it->second;
+	}
+
+	int id = (int)_tags.size();
+	TagEntry entry;
+	entry._name = lowerTag;
+	entry._count = 0;
+	_tags.push_back(entry);
+	_tagIds[lowerTag] = id;
+	return id;
+}
+
+const int TagCollection::FindTagId(const String& tag) const
+{
+	hashmap_ns::hash_map<String, int>::const_iterator it = _tagIds.find(ToLower(tag));
+	if (it == _tagIds.end())
+	{
+		return -1;
+	}
+	return it->second;
+}
+
+void TagCollection::AddObjToTagList(Actor* obj, const String& tag)
+{
+	// Without a handle it has no bit of its own; it'd share the one at 0
+	if (obj->GetHandle() == INVALID_ACTOR_HANDLE)
+	{
+		return;
+	}
+
+	int index = obj->GetHandleIndex();
+	TagEntry& entry = _tags[GetTagId(tag)];
+	unsigned int word = index >> 5;
+	unsigned int mask = 1u << (index & 31);
+	if (word >= entry._bits.size())
+	{
+		entry._bits.resize(word + 1, 0);
+	}
+	if ((entry._bits[word] & mask) == 0)
 	{
-		ActorSet t1;
-		ActorSet t2;
-		String searchTag = ToLower(tags[0]);
-		
-		bool t1_active = true;
-		t1 = GetObjectsTagged(searchTag);
+		entry._bits[word] |= mask;
+		entry._count++;
+	}
+}
+
+void TagCollection::RemoveObjFromTagList(Actor* obj, const String& tag)
+{
+	hashmap_ns::hash_map<String, int>::iterator it = _tagIds.find(tag);
+	if ((it == _tagIds.end()) || (obj->GetHandle() == INVALID_ACTOR_HANDLE))
+	{
+		return;
+	}
+
+	int index = obj->GetHandleIndex();
+	TagEntry& entry = _tags[it->second];
+	unsigned int word = index >> 5;
+	unsigned int mask = 1u << (index & 31);
+	if ((word < entry._bits.size()) && (entry._bits[word] & mask))
+	{
+		entry._bits[word] &= ~mask;
+		entry._count--;
+	}
+}
+
 
-		for(unsigned int i=1; i < tags.size(); i++)
+TagQuery::TagQuery()
+{
+	_matchAny = false;
+}
+
+TagQuery::TagQuery(const String& tags, bool matchAny)
+{
+	_matchAny = matchAny;
+	StringList tagList = SplitString(tags, ", ");
+	for (unsigned int i=0; i < tagList.size(); i++)
+	{
+		int id = theTagList.FindTagId(tagList[i]);
+		if (id < 0)
 		{
-			searchTag = ToLower(tags[i]);
-			ActorSet compare = GetObjectsTagged(searchTag);
-			if (t1_active)
+			String lowerTag = ToLower(tagList[i]);
+			if (std::find(_missingTags.begin(), _missingTags.end(), lowerTag) == _missingTags.end())
 			{
-				std::set_intersection(t1.begin(), t1.end(), compare.begin(), compare.end(), std::inserter(t2, t2.begin()));
-				t1.clear();
-				t1_active = false;
+				_missingTags.push_back(lowerTag);
 			}
-			else
+		}
+		else if (std::find(_tagIds.begin(), _tagIds.end(), id) == _tagIds.end())
+		{
+			_tagIds.push_back(id);
+		}
+	}
+}
+
+const int TagQuery::GetNumTags() const
+{
+	return (int)(_tagIds.size() + _missingTags.size());
+}
+
+const int TagQuery::GetTagId(int i) const
+{
+	if (i < (int)_tagIds.size())
+	{
+		return _tagIds[i];
+	}
+	// -1 (nobody has it, so it matches nothing) until someone gets tagged
+	return theTagList.FindTagId(_missingTags[i - _tagIds.size()]);
+}
+
+const int TagQuery::GetNumWords() const
+{
+	int numTags = GetNumTags();
+	if (numTags == 0)
+	{
+		return 0;
+	}
+
+	// Words past the end of a tag's bits are all zero, so an AND can stop 
+	//  at the shortest tag and an OR has to go to the longest. 
+	const std::vector<TagCollection::TagEntry>& tags = theTagList._tags;
+	int numWords = 0;
+	for (int i=0; i < numTags; i++)
+	{
+		int id = GetTagId(i);
+		int tagWords = (id < 0) ? 0 : (int)tags[id]._bits.size();
+		if ((i == 0) || (_matchAny ? (tagWords > numWords) : (tagWords < numWords)))
+		{
+			numWords = tagWords;
+		}
+	}
+	return numWords;
+}
+
+const unsigned int TagQuery::GetWord(int word) const
+{
+	const std::vector<TagCollection::TagEntry>& tags = theTagList._tags;
+	unsigned int result = _matchAny ? 0u : ~0u;
+	int numTags = GetNumTags();
+	for (int i=0; i < numTags; i++)
+	{
+		int id = GetTagId(i);
+		if (id < 0)
+		{
+			if (!_matchAny)
 			{
-				std::set_intersection(t2.begin(), t2.end(), compare.begin(), compare.end(), std::inserter(t1, t1.begin()));
-				t2.clear();
-				t1_active = true;
+				return 0u;
 			}
+			continue;
 		}
-
-		if (t1_active)
+		const std::vector<unsigned int>& bits = tags[id]._bits;
+		unsigned int tagBits = (word < (int)bits.size()) ? bits[word] : 0u;
+		if (_matchAny)
 		{
-			return t1;
+			result |= tagBits;
 		}
 		else
 		{
-			return t2;
+			result &= tagBits;
+			if (result == 0)
+			{
+				break;
+			}
 		}
 	}
+	return result;
 }
 
-StringSet TagCollection::GetTagList()
+const bool TagQuery::Matches(const Actor* actor) const
 {
-	StringSet forReturn;
-	std::map<String, ActorSet>::iterator it = _tagMappings.begin();
-	while (it != _tagMappings.end())
+	if ((actor == NULL) || (GetNumTags() == 0) || (actor->GetHandle() == INVALID_ACTOR_HANDLE))
 	{
-		forReturn.insert(it->first);
-		it++;
+		return false;
 	}
+	int index = actor->GetHandleIndex();
+	return (GetWord(index >> 5) & (1u << (index & 31))) != 0;
+}
 
-	return forReturn;
+const int TagQuery::Count() const
+{
+	int count = 0;
+	int numWords = GetNumWords();
+	for (int i=0; i < numWords; i++)
+	{
+		count += CountBits(GetWord(i));
+	}
+	return count;
 }
 
+TagQuery::iterator TagQuery::begin() const
+{
+	iterator it;
+	it._query = this;
+	it._word = -1;
+	it._numWords = GetNumWords();
+	it._bits = 0;
+	++it;
+	return it;
+}
 
-void TagCollection::AddObjToTagList(Actor* obj, const String& tag)
+TagQuery::iterator TagQuery::end() const
 {
-	_tagMappings[tag].insert(obj);
+	return iterator();
 }
 
-void TagCollection::RemoveObjFromTagList(Actor* obj, const String& tag)
+TagQuery::iterator& TagQuery::iterator::operator++()
 {
-	_tagMappings[tag].erase(obj);
-	if (_tagMappings[tag].empty())
+	while (_bits == 0)
 	{
-		_tagMappings.erase(tag);
+		if (++_word >= _numWords)
+		{
+			_current = NULL;
+			return *this;
+		}
+		_bits = _query->GetWord(_word);
 	}
-}
\ No newline at end of file
+
+	int bit = LowestBit(_bits);
+	_bits &= _bits - 1;
+	_current = Actor::GetFromHandleIndex((_word << 5) + bit);
+	return *this;
+}
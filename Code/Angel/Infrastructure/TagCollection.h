@@ -33,6 +33,8 @@
 
 #define theTagList TagCollection::GetInstance()
 
+class TagQuery;
+
 ///A helper class that manages the tags you can set on Actors
 /** 
  * Whenever you call Actor::Tag or Actor::Untag, the Actor manipulates the 
@@ -64,7 +66,12 @@ public:
 	/**
 	 * Returns the set of all Actors who have the given tag. 
 	 * 
-	 * @param findTag The tag of interest
+	 * This builds a new TagQuery and copies its results every time, so if 
+	 *  you're asking the same question every frame, make a TagQuery once 
+	 *  and hang on to it instead. 
+	 * 
+	 * @param findTag The tag of interest (or a comma-separated list of 
+	 *   tags, all of which must match)
 	 * @return An ActorSet of everyone who is tagged thusly
 	 */
 	ActorSet GetObjectsTagged(String findTag);
@@ -94,10 +101,141 @@ public:
 	 */
 	void RemoveObjFromTagList(Actor* obj, const String& tag);
 
+	/**
+	 * Get the ID for a tag, adding it to the collection if it's new. Tags 
+	 *  are lowercased first, just like in Actor::Tag. 
+	 * 
+	 * @param tag The tag
+	 * @return Its ID
+	 */
+	const int GetTagId(const String& tag);
+	
+	/**
+	 * Get the ID for a tag without adding it. Tags are lowercased first, 
+	 *  just like in Actor::Tag. 
+	 * 
+	 * @param tag The tag
+	 * @return Its ID, or -1 if no Actor has ever had it
+	 */
+	const int FindTagId(const String& tag) const;
+
 protected:
 	TagCollection();
 	static TagCollection* s_TagCollection;
 
 private:
-	std::map<String, ActorSet> _tagMappings;
+	friend class TagQuery;
+	
+	// Every tag keeps one bit per Actor handle index, so a query is just 
+	//  ANDing or ORing words together. 
+	struct TagEntry
+	{
+		String _name;
+		std::vector<unsigned int> _bits;
+		int _count;
+	};
+	
+	hashmap_ns::hash_map<String, int> _tagIds;
+	std::vector<TagEntry> _tags;
+};
+
+///A precompiled tag search that you can keep around and run every frame
+/** 
+ * TagCollection::GetObjectsTagged has to split up and look up its tags on 
+ *  every call, then copy its answer into a std::set. A TagQuery does the 
+ *  lookup once, when it's made, and afterwards walks the matching Actors in
+ *  place without allocating anything. 
+ * 
+ * \code
+ * TagQuery bluePeople("person, blue");
+ * for (TagQuery::iterator it = bluePeople.begin(); it != bluePeople.end(); ++it)
+ * {
+ *     (*it)->SetColor(0.0f, 0.0f, 1.0f);
+ * }
+ * \endcode
+ * 
+ * Results always reflect the current tags -- Actors tagged after the query
+ *  was made will show up in it, even if nobody had the tag yet. (Tags like 
+ *  that do get looked up again every time the query runs, until they 
+ *  exist.) Don't tag or untag Actors other than the current one while 
+ *  you're iterating. 
+ */
+class TagQuery
+{
+public:
+	/**
+	 * An empty query, which doesn't match anything. 
+	 */
+	TagQuery();
+	
+	/**
+	 * Compiles a query. 
+	 * 
+	 * @param tags A comma-separated list of tags
+	 * @param matchAny If false (the default), an Actor has to have all of
+	 *   the tags to match. If true, any one of them will do. 
+	 */
+	TagQuery(const String& tags, bool matchAny = false);
+	
+	/**
+	 * Find out whether a particular Actor matches this query. 
+	 * 
+	 * @param actor The Actor to check
+	 * @return True if it matches
+	 */
+	const bool Matches(const Actor* actor) const;
+	
+	/**
+	 * Get the number of Actors that currently match this query. 
+	 * 
+	 * @return The number of matches
+	 */
+	const int Count() const;
+	
+	///Walks the matching Actors
+	class iterator
+	{
+	public:
+		iterator() : _query(NULL), _word(0), _numWords(0), _bits(0), _current(NULL) {}
+		
+		Actor* operator*() const { return _current; }
+		iterator& operator++();
+		bool operator==(const iterator& other) const { return _current == other._current; }
+		bool operator!=(const iterator& other) const { return _current != other._current; }
+		
+	private:
+		friend class TagQuery;
+		
+		const TagQuery* _query;
+		int _word;
+		int _numWords;
+		unsigned int _bits;
+		Actor* _current;
+	};
+	
+	/**
+	 * Get an iterator pointing to the first matching Actor. 
+	 * 
+	 * @return The start of the results
+	 */
+	iterator begin() const;
+	
+	/**
+	 * Get the iterator that marks the end of the results. 
+	 * 
+	 * @return The end of the results
+	 */
+	iterator end() const;
+	
+private:
+	const int GetNumTags() const;
+	const int GetTagId(int i) const;
+	const int GetNumWords() const;
+	const unsigned int GetWord(int word) const;
+	
+	std::vector<int> _tagIds;
+	// Tags that didn't exist when the query was made; making a query 
+	//  shouldn't add them
+	StringList _missingTags;
+	bool _matchAny;
 };
@@ -33,6 +33,7 @@
 #include "../Infrastructure/Camera.h"
 #include "../Infrastructure/Log.h"
 #include "../AI/SpatialGraph.h"
+#include "../AI/PathRequestQueue.h"
 #if !ANGEL_MOBILE
 	#include "../Infrastructure/Console.h"
 	#include "../Input/Input.h"
@@ -43,7 +44,12 @@
 	#include "../Infrastructure/TextRendering.h"
 #endif
 #include "../Infrastructure/Textures.h"
+#include "../Infrastructure/JobSystem.h"
+#include "../Infrastructure/ParticleSystemManager.h"
+#include "../Infrastructure/SpatialIndex.h"
+#include "../Infrastructure/SpriteBatch.h"
 #include "../Actors/PhysicsActor.h"
+#include "../Actors/ParticleActor.h"
 #include "../Messaging/Switchboard.h"
 #include "../Scripting/LuaModule.h"
 #include "../Infrastructure/Preferences.h"
@@ -76,6 +82,14 @@ World::World()
 	_highResScreen = false;
 	
 	_processingDeferredAdds = false;
+	_parallelUpdate = false;
+	_updatingInParallel = false;
+	_parallelDT = 0.0f;
+	
+	_culling = true;
+	_cullStamp = 0;
+	_numRenderablesDrawn = 0;
+	_numRenderablesCulled = 0;
 }
 
 World& World::GetInstance()
@@ -115,6 +129,11 @@ bool World::Initialize(unsigned int windowWidth, unsigned int windowHeight, Stri
 	
 	_running = true;
 
+	// Whatever thread we're initialized on is the main one, no matter who
+	//  got to these singletons first.
+	theJobSystem.SetMainThread();
+	theSwitchboard.SetMainThread();
+
 	// Windows DLL locations
 	#if defined(WIN32) && defined(ANGEL_RELEASE)
 		String bitsPath = "bits";
@@ -401,6 +420,9 @@ void World::Destroy()
     
     theUI.Shutdown();
 
+	thePathRequestQueue.Shutdown();
+	theJobSystem.Shutdown();
+
 	if (_gameManager != NULL)
 	{
 		delete _gameManager;
@@ -415,7 +437,7 @@ void World::StartGame()
 	}
 	_started = true;
 
-	theSwitchboard.Broadcast(new Message("GameStart"));
+	theSwitchboard.Broadcast("GameStart");
 
 	//enter main loop
 	while(_running)
@@ -508,6 +530,13 @@ void World::Simulate(bool simRunning)
 		theSwitchboard.SendAllMessages();
 
 		RunPhysics(frame_dt);
+
+		// Step every particle system in one pass before the Actors update.
+		theParticleSystems.Update(frame_dt);
+		
+		// Catch the pathing graph up with any physics shapes that came or went.
+		theSpatialGraph.ProcessPhysicsChanges();
+		thePathRequestQueue.Update();
 		
 		//Flag that the _elements array is locked so we don't try to add any
 		// new actors during the update.
@@ -519,7 +548,6 @@ void World::Simulate(bool simRunning)
 		// Now that we're done updating the list, allow any deferred Adds to be processed.
 		ProcessDeferredAdds();
 		ProcessDeferredLayerChanges();
-		ProcessDeferredRemoves();
 		
 		theSwitchboard.Update(frame_dt);
 
@@ -565,28 +593,17 @@ void World::RunPhysics(float frame_dt)
 
 void World::SendCollisionNotifications(b2Contact* contact, bool beginning)
 {
-	String messageStart;
-	if (beginning)
-	{
-		messageStart = "CollisionStartWith";
-	}
-	else
-	{
-		messageStart = "CollisionEndWith";
-	}
-	
 	PhysicsActor* pa1 = (PhysicsActor*)contact->GetFixtureA()->GetBody()->GetUserData();
 	PhysicsActor* pa2 = (PhysicsActor*)contact->GetFixtureB()->GetBody()->GetUserData();
 	
 	if (pa1 != NULL)
 	{
-		String pa1Message = messageStart + pa1->GetName();
-		if (theSwitchboard.GetSubscribersTo(pa1Message).size() > 0)
+		MessageId pa1Message = pa1->_getCollisionMessageId(beginning);
+		if (theSwitchboard.HasSubscribers(pa1Message))
 		{
 			if (_currentTouches[pa1].find(pa2) == _currentTouches[pa1].end())
 			{
-				TypedMessage<b2Contact*>* coll = new TypedMessage<b2Contact*>(pa1Message, contact, pa2);
-				theSwitchboard.Broadcast(coll);
+				theSwitchboard.Broadcast(pa1Message, contact, pa2);
 			}
 			_currentTouches[pa1].insert(pa2);
 		}
@@ -594,13 +611,12 @@ void World::SendCollisionNotifications(b2Contact* contact, bool beginning)
 	
 	if (pa2 != NULL)
 	{
-		String pa2Message = messageStart + pa2->GetName();
-		if (theSwitchboard.GetSubscribersTo(pa2Message).size() > 0)
+		MessageId pa2Message = pa2->_getCollisionMessageId(beginning);
+		if (theSwitchboard.HasSubscribers(pa2Message))
 		{
 			if (_currentTouches[pa2].find(pa1) == _currentTouches[pa2].end())
 			{
-				TypedMessage<b2Contact*>* coll = new TypedMessage<b2Contact*>(pa2Message, contact, pa1);
-				theSwitchboard.Broadcast(coll);
+				theSwitchboard.Broadcast(pa2Message, contact, pa1);
 			}
 			_currentTouches[pa2].insert(pa1);
 		}
@@ -656,40 +672,281 @@ void World::Render()
 
 void World::CleanupRenderables()
 {
-	RenderableIterator it = theWorld.GetFirstRenderable();
-	while (it != theWorld.GetLastRenderable())
+	// One pass per layer: slide the survivors down over anything that was 
+	//  removed or destroyed, keeping their order, and set the dead aside.
+	for (unsigned int layer=0; layer < _layers.size(); layer++)
 	{
-		if ((*it)->IsDestroyed())
-		{
-			Renderable* deadManWalking = *it;
-			it = it.erase(it);
-			delete deadManWalking;
-		}
-		else
+		RenderList& renderables = _layers[layer]._renderables;
+		unsigned int next = 0;
+		for (unsigned int i=0; i < renderables.size(); i++)
 		{
-			++it;
+			Renderable* renderable = renderables[i];
+			if (renderable == NULL)
+			{
+				continue;
+			}
+			if (renderable->IsDestroyed())
+			{
+				renderable->_layerSlot = -1;
+				_pendingDeletes.push_back(renderable);
+				continue;
+			}
+			if (next != i)
+			{
+				renderables[next] = renderable;
+				renderable->_layerSlot = (int)next;
+			}
+			++next;
 		}
+		renderables.resize(next);
 	}
+
+	// Now that the layers are consistent again, delete everything at once.
+	for (unsigned int i=0; i < _pendingDeletes.size(); i++)
+	{
+		delete _pendingDeletes[i];
+	}
+	_pendingDeletes.clear();
 }
 
 void World::UpdateRenderables(float frame_dt)
 {
+	if (_parallelUpdate)
+	{
+		UpdateRenderablesInParallel(frame_dt);
+	}
+
 	RenderableIterator it = theWorld.GetFirstRenderable();
 	while (it != theWorld.GetLastRenderable())
 	{
+		// Already taken care of in the parallel phase
+		if (_parallelUpdate && (*it)->IsThreadSafe())
+		{
+			++it;
+			continue;
+		}
 		(*it)->Update(frame_dt);
 		++it;
 	}
 }
 
-void World::DrawRenderables()
+// How many Renderables each parallel job updates
+static const int s_parallelUpdateGrain = 64;
+
+void World::UpdateRenderablesInParallel(float frame_dt)
 {
+	_parallelRenderables.clear();
 	RenderableIterator it = theWorld.GetFirstRenderable();
 	while (it != theWorld.GetLastRenderable())
 	{
-		(*it)->Render();
+		if ((*it)->IsThreadSafe())
+		{
+			_parallelRenderables.push_back(*it);
+		}
 		++it;
 	}
+	if (_parallelRenderables.empty())
+	{
+		return;
+	}
+
+	unsigned int numChunks = (_parallelRenderables.size() + s_parallelUpdateGrain - 1) / s_parallelUpdateGrain;
+	if (_capturedCalls.size() < numChunks)
+	{
+		_capturedCalls.resize(numChunks);
+	}
+	_activeCaptures.assign(theJobSystem.GetThreadCount(), NULL);
+
+	_parallelDT = frame_dt;
+	_updatingInParallel = true;
+	theSpatialIndex.DeferUpdates(theJobSystem.GetThreadCount());
+	theParticleSystems.DeferGrowth();
+	theJobSystem.ParallelFor((int)_parallelRenderables.size(), s_parallelUpdateGrain, UpdateRenderablesJob, this);
+	theParticleSystems.FlushDeferredGrowth();
+	theSpatialIndex.FlushDeferredUpdates();
+	_updatingInParallel = false;
+
+	// Carry out whatever got held, chunk by chunk, so the results are the 
+	//  same no matter which threads ran what.
+	for (unsigned int chunk=0; chunk < numChunks; chunk++)
+	{
+		CapturedCallList& calls = _capturedCalls[chunk];
+		for (unsigned int i=0; i < calls.size(); i++)
+		{
+			CapturedCall& call = calls[i];
+			switch (call._type)
+			{
+				case CCT_Broadcast:
+					theSwitchboard.Broadcast(call._message);
+					break;
+				case CCT_DeferredBroadcast:
+					theSwitchboard.DeferredBroadcast(call._message, call._delay);
+					break;
+				case CCT_Add:
+					Add(call._renderable, call._layer);
+					break;
+				case CCT_Remove:
+					Remove(call._renderable);
+					break;
+			}
+		}
+		calls.clear();
+	}
+}
+
+void World::UpdateRenderablesJob(void* context, int begin, int end)
+{
+	World* world = (World*)context;
+
+	int thread = theJobSystem.GetCurrentThreadIndex();
+	world->_activeCaptures[thread] = &world->_capturedCalls[begin / s_parallelUpdateGrain];
+	for (int i=begin; i < end; i++)
+	{
+		world->_parallelRenderables[i]->Update(world->_parallelDT);
+	}
+	world->_activeCaptures[thread] = NULL;
+}
+
+World::CapturedCallList* World::GetCaptureList()
+{
+	if (!_updatingInParallel)
+	{
+		return NULL;
+	}
+
+	int thread = theJobSystem.GetCurrentThreadIndex();
+	if (thread < 0)
+	{
+		return NULL;
+	}
+	return _activeCaptures[thread];
+}
+
+bool World::CaptureBroadcast(Message* message, float delay)
+{
+	CapturedCallList* captures = GetCaptureList();
+	if (captures == NULL)
+	{
+		return false;
+	}
+
+	CapturedCall call;
+	call._type = (delay < 0.0f) ? CCT_Broadcast : CCT_DeferredBroadcast;
+	call._renderable = NULL;
+	call._layer = 0;
+	call._message = message;
+	call._delay = delay;
+	captures->push_back(call);
+	return true;
+}
+
+void World::SetParallelUpdate(bool enabled)
+{
+	_parallelUpdate = enabled;
+}
+
+void World::SetLayerCulling(int layer, bool enabled)
+{
+	FindOrCreateLayer(layer)._cull = enabled;
+}
+
+void World::SetLayerCulling(const String& layer, bool enabled)
+{
+	SetLayerCulling(GetLayerByName(layer), enabled);
+}
+
+const bool World::GetLayerCulling(int layer)
+{
+	RenderLayer* renderLayer = FindLayer(layer);
+	if (renderLayer == NULL)
+	{
+		return true;
+	}
+	return renderLayer->_cull;
+}
+
+void World::MarkVisibleActors()
+{
+	if (++_cullStamp == 0)
+	{
+		// Wrapped around; skip the value every Renderable starts with
+		_cullStamp = 1;
+	}
+
+	// Unproject all four corners so a rotated camera is still covered
+	int width = theCamera.GetWindowWidth();
+	int height = theCamera.GetWindowHeight();
+	Vector2 corners[4] = {
+		MathUtil::ScreenToWorld(0, 0),
+		MathUtil::ScreenToWorld(width, 0),
+		MathUtil::ScreenToWorld(0, height),
+		MathUtil::ScreenToWorld(width, height)
+	};
+	BoundingBox view(corners[0], corners[0]);
+	for (int i=1; i < 4; i++)
+	{
+		view.Min = Vector2::Min(view.Min, corners[i]);
+		view.Max = Vector2::Max(view.Max, corners[i]);
+	}
+
+	_visibleActors.clear();
+	theSpatialIndex.QueryAABB(view, _visibleActors);
+	for (unsigned int i=0; i < _visibleActors.size(); i++)
+	{
+		_visibleActors[i]->_visibleStamp = _cullStamp;
+	}
+}
+
+void World::DrawRenderables()
+{
+	theSpriteBatch.BeginFrame();
+
+	_numRenderablesDrawn = 0;
+	_numRenderablesCulled = 0;
+	if (_culling)
+	{
+		MarkVisibleActors();
+	}
+
+	for (unsigned int layer=0; layer < _layers.size(); layer++)
+	{
+		bool cullLayer = _culling && _layers[layer]._cull;
+		RenderList& renderables = _layers[layer]._renderables;
+		for (unsigned int i=0; i < renderables.size(); i++)
+		{
+			Renderable* renderable = renderables[i];
+			if (renderable == NULL)
+			{
+				continue;
+			}
+			if (cullLayer && renderable->_inSpatialIndex && renderable->_cullable 
+				&& (renderable->_visibleStamp != _cullStamp))
+			{
+				_numRenderablesCulled++;
+				continue;
+			}
+			_numRenderablesDrawn++;
+
+			// Anything that might draw for itself has to go on top of the 
+			//  sprites queued before it
+			if (!renderable->_batchable)
+			{
+				theSpriteBatch.Flush();
+			}
+
+			int submittedBefore = theSpriteBatch.GetSubmittedCount();
+			renderable->Render();
+			if (theSpriteBatch.GetSubmittedCount() == submittedBefore)
+			{
+				theSpriteBatch.AddImmediateDraw();
+			}
+		}
+
+		// Keep layers stacked in order
+		theSpriteBatch.Flush();
+	}
+
+	theSpriteBatch.EndFrame();
 }
 
 const float World::GetDT()
@@ -753,6 +1010,20 @@ void World::Add(Renderable *newElement, int layer)
 		sysLog.Log("WARNING: Can't add a null element to the World.");
 		return;
 	}
+
+	// Hold on to it if we're in the middle of the parallel update.
+	CapturedCallList* captures = GetCaptureList();
+	if (captures != NULL)
+	{
+		CapturedCall call;
+		call._type = CCT_Add;
+		call._renderable = newElement;
+		call._layer = layer;
+		call._message = NULL;
+		call._delay = 0.0f;
+		captures->push_back(call);
+		return;
+	}
 	
 	//Check to see if it's an Actor; give it a name if it doesn't have one
 	Actor *a = dynamic_cast<Actor*> (newElement);
@@ -765,16 +1036,40 @@ void World::Add(Renderable *newElement, int layer)
 	// If we're not locked, add directly to _elements.
 	if (!_elementsLocked)
 	{
+		if (newElement->_layerSlot >= 0)
+		{
+			sysLog.Log("WARNING: Renderable is already in the World; use UpdateLayer to move it.");
+			return;
+		}
+		RenderList& renderables = FindOrCreateLayer(layer)._renderables;
 		newElement->_layer = layer;
-		_layers[layer].push_back(newElement);
+		newElement->_layerSlot = (int)renderables.size();
+		renderables.push_back(newElement);
+		if (a != NULL)
+		{
+			theSpatialIndex.Add(a);
+
+			// Emitters are only simulated while they're in the World
+			ParticleActor* emitter = dynamic_cast<ParticleActor*>(a);
+			if (emitter != NULL)
+			{
+				theParticleSystems.AddEmitter(emitter);
+			}
+		}
 	}
 	// If we're locked, add to _deferredAdds and we'll add the new
 	// Renderable after we're done updating all the _elements.
 	else
 	{
+		if (newElement->_deferredAddSlot >= 0)
+		{
+			sysLog.Log("WARNING: Renderable is already waiting to be added to the World.");
+			return;
+		}
 		RenderableLayerPair addMe;
 		addMe._layer = layer;
 		addMe._renderable = newElement;
+		newElement->_deferredAddSlot = (int)_deferredAdds.size();
 		_deferredAdds.push_back( addMe );
 	}
 }
@@ -791,51 +1086,101 @@ void World::Remove(Renderable *oldElement)
 		return;
 	}
 
-	if (_elementsLocked)
+	// Hold on to it if we're in the middle of the parallel update.
+	CapturedCallList* captures = GetCaptureList();
+	if (captures != NULL)
 	{
-		_deferredRemoves.push_back(oldElement);
+		CapturedCall call;
+		call._type = CCT_Remove;
+		call._renderable = oldElement;
+		call._layer = 0;
+		call._message = NULL;
+		call._delay = 0.0f;
+		captures->push_back(call);
 		return;
 	}
 
-	// First, make sure that it isn't deferred in the _deferredAdds list.
-	std::vector<RenderableLayerPair>::iterator it = _deferredAdds.begin();
-	while (it != _deferredAdds.end())
+	// If it's still waiting in _deferredAdds, just cancel that.
+	if (oldElement->_deferredAddSlot >= 0)
+	{
+		_deferredAdds[oldElement->_deferredAddSlot]._renderable = NULL;
+		oldElement->_deferredAddSlot = -1;
+		return;
+	}
+
+	// Otherwise clear it out of its layer. This only leaves a hole, so 
+	//  it's safe to do even while we're iterating over the layers.
+	ClearLayerSlot(oldElement);
+}
+
+void World::ClearLayerSlot(Renderable* element)
+{
+	if (element->_layerSlot < 0)
+	{
+		return;
+	}
+
+	Actor* actor = dynamic_cast<Actor*>(element);
+	if (actor != NULL)
 	{
-		if ((*it)._renderable == oldElement)
+		theSpatialIndex.Remove(actor);
+
+		ParticleActor* emitter = dynamic_cast<ParticleActor*>(actor);
+		if (emitter != NULL)
 		{
-			_deferredAdds.erase(it);
-			return;
+			theParticleSystems.RemoveEmitter(emitter);
 		}
-		++it;
 	}
 
-	// If we didn't find it in the deferred list, find/remove it from the layers.
-	bool found = false;
-	// Find the layer that matches the elements layer.
-	RenderLayers::iterator layer = _layers.find(oldElement->_layer);
-	// Found the layer (list of renderables).
-	if ( layer != _layers.end() )
+	RenderLayer* layer = FindLayer(element->_layer);
+	if (layer != NULL)
 	{
-		// Now that we have the list of elements for this layer, let's remove the requested element.
-		//rb - TODO - Cache off vector.
-		std::vector<Renderable*>::iterator element = (*layer).second.begin();
-		for ( ; element != (*layer).second.end(); ++element )
+		// Just leave a hole; CleanupRenderables will close it up.
+		layer->_renderables[element->_layerSlot] = NULL;
+	}
+	element->_layerSlot = -1;
+}
+
+RenderLayer* World::FindLayer(int layer)
+{
+	// Binary search, since the table is sorted by layer number.
+	unsigned int low = 0;
+	unsigned int high = _layers.size();
+	while (low < high)
+	{
+		unsigned int mid = (low + high) / 2;
+		if (_layers[mid]._layer < layer)
 		{
-			// Found it.
-			if ( (*element) == oldElement )
-			{
-				// Remove the element.
-				element = (*layer).second.erase(element);
-				found = true;
-				// Nothing else to do.
-				break;
-			}
+			low = mid + 1;
 		}
-		if (!found)
+		else
 		{
-			//log or error handle
+			high = mid;
 		}
 	}
+	if ((low < _layers.size()) && (_layers[low]._layer == layer))
+	{
+		return &_layers[low];
+	}
+	return NULL;
+}
+
+RenderLayer& World::FindOrCreateLayer(int layer)
+{
+	RenderLayers::iterator it = _layers.begin();
+	while ((it != _layers.end()) && (it->_layer < layer))
+	{
+		++it;
+	}
+	if ((it != _layers.end()) && (it->_layer == layer))
+	{
+		return *it;
+	}
+
+	RenderLayer newLayer;
+	newLayer._layer = layer;
+	newLayer._cull = true;
+	return *_layers.insert(it, newLayer);
 }
 
 void World::UpdateLayer(Renderable* element, int newLayer)
@@ -1009,7 +1354,12 @@ void World::ProcessDeferredAdds()
 	std::vector<RenderableLayerPair>::iterator it = _deferredAdds.begin();
 	while(it != _deferredAdds.end())
 	{
-		Add( (*it)._renderable, (*it)._layer );
+		// Entries that were removed before we got to them are left NULL.
+		if ((*it)._renderable != NULL)
+		{
+			(*it)._renderable->_deferredAddSlot = -1;
+			Add( (*it)._renderable, (*it)._layer );
+		}
 		++it;
 	}
 
@@ -1030,17 +1380,6 @@ void World::ProcessDeferredLayerChanges()
 	_deferredLayerChanges.clear();
 }
 
-void World::ProcessDeferredRemoves()
-{
-	RenderList::iterator it = _deferredRemoves.begin();
-	while(it != _deferredRemoves.end())
-	{
-		Remove(*it);
-		++it;
-	}
-	_deferredRemoves.clear();
-}
-
 void World::UpdateDebugItems(float frame_dt)
 {
 	DebugDrawIterator itdd = _debugDrawItems.begin();
@@ -36,6 +36,7 @@
 #include "../Messaging/Message.h"
 
 #include <Box2D/Box2D.h>
+#include <atomic>
 
 //forward declarations
 class Actor;
@@ -245,6 +246,39 @@ public:
 	 */
 	const bool ResumePhysics();
 
+	/**
+	 * Turns on the parallel update phase. When it's on, every Renderable 
+	 *  that has been marked with Renderable::SetThreadSafe gets its Update 
+	 *  called on the JobSystem's worker threads, in chunks, before the rest
+	 *  are updated one at a time as usual. Off by default. 
+	 * 
+	 * While the parallel phase is running, calls to Switchboard::Broadcast,
+	 *  Switchboard::DeferredBroadcast, World::Add, and World::Remove are 
+	 *  held and then carried out on the main thread once every chunk is 
+	 *  done, in the same order the Renderables would have been updated 
+	 *  serially. 
+	 * 
+	 * @param enabled Whether thread-safe Renderables should update in 
+	 *   parallel
+	 */
+	void SetParallelUpdate(bool enabled);
+	
+	/**
+	 * Find out whether the parallel update phase is turned on. 
+	 * 
+	 * @return True if thread-safe Renderables update in parallel
+	 */
+	const bool GetParallelUpdate() const { return _parallelUpdate; }
+	
+	/**
+	 * INTERNAL: Used by the Switchboard to hold on to messages broadcast 
+	 *  from the parallel update phase. 
+	 * 
+	 * @return True if the message was held, in which case the Switchboard 
+	 *   shouldn't queue it itself
+	 */
+	bool CaptureBroadcast(Message* message, float delay = -1.0f);
+	
 	/**
 	 * Sets the world's background color. White by default. 
 	 * 
@@ -312,12 +346,77 @@ public:
 	const int GetLayerByName(const String& name);
 	
 	/**
-	 * Get the set of layers and their associated Renderables
+	 * Get the set of layers and their associated Renderables. The layers 
+	 *  are sorted by number, lowest first. A layer's list can contain NULL
+	 *  entries where something was removed this frame, so skip those. 
 	 * 
 	 * @return The world's layers
 	 */
 	RenderLayers& GetLayers() { return _layers; }
 	
+	/**
+	 * Turns view culling on or off for the whole World. When it's on, 
+	 *  Actors whose bounding boxes are entirely outside the camera's view
+	 *  don't get their Render calls. Only Actors tracked by the 
+	 *  SpatialIndex are culled; HUDActors and other screen-space elements 
+	 *  are always drawn. On by default. 
+	 * 
+	 * @param enabled Whether off-camera Actors should be skipped
+	 */
+	void SetCulling(bool enabled) { _culling = enabled; }
+	
+	/**
+	 * Find out whether view culling is turned on. 
+	 * 
+	 * @return True if off-camera Actors are being skipped
+	 */
+	const bool GetCulling() const { return _culling; }
+	
+	/**
+	 * Turns view culling on or off for a single layer. Useful for layers
+	 *  whose contents are positioned in world space but should always be
+	 *  drawn, like fullscreen backgrounds or overlays that follow the 
+	 *  camera. 
+	 * 
+	 * @param layer The layer to change
+	 * @param enabled Whether off-camera Actors in that layer should be 
+	 *   skipped
+	 */
+	void SetLayerCulling(int layer, bool enabled);
+	
+	/**
+	 * Turns view culling on or off for a named layer. 
+	 * 
+	 * @param layer The name of the layer to change
+	 * @param enabled Whether off-camera Actors in that layer should be 
+	 *   skipped
+	 */
+	void SetLayerCulling(const String& layer, bool enabled);
+	
+	/**
+	 * Find out whether a layer's off-camera Actors are being skipped. 
+	 * 
+	 * @param layer The layer to check
+	 * @return True if culling is on for that layer (it still won't happen 
+	 *   if it's turned off for the whole World)
+	 */
+	const bool GetLayerCulling(int layer);
+	
+	/**
+	 * Find out how many Renderables got a Render call last frame. 
+	 * 
+	 * @return The number of Renderables drawn
+	 */
+	const int GetNumRenderablesDrawn() const { return _numRenderablesDrawn; }
+	
+	/**
+	 * Find out how many Renderables were skipped last frame because they
+	 *  were off-camera. 
+	 * 
+	 * @return The number of Renderables culled
+	 */
+	const int GetNumRenderablesCulled() const { return _numRenderablesCulled; }
+	
 	/**
 	 * Register a new Console with the World. Only one Console can be
 	 *  activated at at time. 
@@ -530,12 +629,39 @@ protected:
 	void Simulate(bool simRunning);
 	void ProcessDeferredAdds();
 	void ProcessDeferredLayerChanges();
-	void ProcessDeferredRemoves();
 	void RunPhysics(float frame_dt);
 	void UpdateDebugItems(float frame_dt);
 	void DrawDebugItems();
 
 private:
+	friend class RenderableIterator;
+	
+	enum CapturedCallType
+	{
+		CCT_Broadcast,
+		CCT_DeferredBroadcast,
+		CCT_Add,
+		CCT_Remove
+	};
+	
+	struct CapturedCall
+	{
+		CapturedCallType _type;
+		Renderable* _renderable;
+		int _layer;
+		Message* _message;
+		float _delay;
+	};
+	typedef std::vector<CapturedCall> CapturedCallList;
+	
+	void UpdateRenderablesInParallel(float frame_dt);
+	static void UpdateRenderablesJob(void* context, int begin, int end);
+	CapturedCallList* GetCaptureList();
+	
+	RenderLayer& FindOrCreateLayer(int layer);
+	RenderLayer* FindLayer(int layer);
+	void ClearLayerSlot(Renderable* element);
+	
 	struct RenderableLayerPair
 	{
 		Renderable* _renderable;
@@ -562,10 +688,27 @@ private:
 
 	RenderLayers _layers;
 
+	bool _culling;
+	// Bumped every frame; Actors in view get it as their _visibleStamp
+	unsigned int _cullStamp;
+	ActorList _visibleActors;
+	int _numRenderablesDrawn;
+	int _numRenderablesCulled;
+	void MarkVisibleActors();
+
 	bool _processingDeferredAdds;
 	std::vector<RenderableLayerPair> _deferredAdds;	
 	std::vector<RenderableLayerPair> _deferredLayerChanges;
-	std::vector<Renderable*> _deferredRemoves;
+	RenderList _pendingDeletes;
+
+	bool _parallelUpdate;
+	std::atomic<bool> _updatingInParallel;
+	float _parallelDT;
+	RenderList _parallelRenderables;
+	// One list per chunk of the parallel phase, replayed in chunk order
+	std::vector<CapturedCallList> _capturedCalls;
+	// The list each thread is currently writing to
+	std::vector<CapturedCallList*> _activeCaptures;
 	std::map<String, int> _layerNames;
 
 	bool _elementsLocked;
@@ -53,7 +53,7 @@ void InputBinding::OnKeyDown()
 	if( _keyDownMessage.length() == 0 )
 		return;
 	
-	theSwitchboard.Broadcast(new Message(_keyDownMessage));
+	theSwitchboard.Broadcast(_keyDownMessage);
 }
 
 void InputBinding::OnKeyUp()
@@ -61,7 +61,7 @@ void InputBinding::OnKeyUp()
 	if( _keyUpMessage.length() == 0 )
 		return;
 
-	theSwitchboard.Broadcast(new Message(_keyUpMessage));
+	theSwitchboard.Broadcast(_keyUpMessage);
 }
 
 InputManager* InputManager::s_Input = NULL;
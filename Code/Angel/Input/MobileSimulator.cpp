@@ -168,12 +168,12 @@ void MobileSimulator::MouseMotionEvent(Vec2i screenCoordinates)
 						radiansRotated = -radiansRotated;
 					}
 					gd.GestureMagnitude = radiansRotated;
-					theSwitchboard.Broadcast(new TypedMessage<GestureData>("MultiTouchRotate", gd));
+					theSwitchboard.Broadcast("MultiTouchRotate", gd, NULL);
 				}
 				else if (_gestureType == PINCH)
 				{
 					gd.GestureMagnitude = currentVector.Length() / initialVector.Length();
-					theSwitchboard.Broadcast(new TypedMessage<GestureData>("MultiTouchPinch", gd));	
+					theSwitchboard.Broadcast("MultiTouchPinch", gd, NULL);	
 				}
 			}
 		}
@@ -256,22 +256,22 @@ void MobileSimulator::MouseUpEvent(Vec2i screenCoordinates, MouseButtonInput but
 					if      ( (angle > 45.0f) && (angle <= 135.0f) )
 					{
 						// swipe up
-						theSwitchboard.Broadcast(new Message("MultiTouchSwipeUp"));
+						theSwitchboard.Broadcast("MultiTouchSwipeUp");
 					}
 					else if ( (angle > 135.0f) && (angle <= 225.0f) )
 					{
 						// swipe left
-						theSwitchboard.Broadcast(new Message("MultiTouchSwipeLeft"));
+						theSwitchboard.Broadcast("MultiTouchSwipeLeft");
 					}
 					else if ( (angle > 225.0f) && (angle <= 315.0f) )
 					{
 						// swipe down
-						theSwitchboard.Broadcast(new Message("MultiTouchSwipeDown"));
+						theSwitchboard.Broadcast("MultiTouchSwipeDown");
 					}
 					else
 					{
 						// swipe right
-						theSwitchboard.Broadcast(new Message("MultiTouchSwipeRight"));
+						theSwitchboard.Broadcast("MultiTouchSwipeRight");
 					}
 				}
 			}
@@ -35,6 +35,8 @@ Message::Message()
 {
 	_messageName = "GenericMessage";
 	_sender = NULL;
+	_messageId = INVALID_MESSAGE_ID;
+	_pooled = false;
 }
 
 Message::~Message()
@@ -45,6 +47,16 @@ Message::Message(const String& messageName, MessageListener* sender)
 {
 	_messageName = messageName;
 	_sender = sender;
+	_messageId = INVALID_MESSAGE_ID;
+	_pooled = false;
+}
+
+Message::Message(MessageId messageId, MessageListener* sender)
+{
+	_messageName = theMessageNames.GetName(messageId);
+	_sender = sender;
+	_messageId = messageId;
+	_pooled = false;
 }
 
 const String& Message::GetMessageName() const
@@ -52,6 +64,17 @@ const String& Message::GetMessageName() const
 	return _messageName;
 }
 
+const MessageId Message::GetMessageId() const
+{
+	if (_messageId == INVALID_MESSAGE_ID)
+	{
+		// Only subscribing (or making a MessageId) adds a name, so one 
+		//  that's missing has nobody listening for it yet.
+		_messageId = theMessageNames.Find(GetMessageName());
+	}
+	return _messageId;
+}
+
 MessageListener* const Message::GetSender()
 {
 	return _sender;
@@ -59,6 +82,7 @@ MessageListener* const Message::GetSender()
 
 MessageListener::~MessageListener()
 {
+	// Copy it, since unsubscribing changes the original.
 	StringSet subs = theSwitchboard.GetSubscriptionsFor(this);
 	StringSet::iterator it = subs.begin();
 	while (it != subs.end())
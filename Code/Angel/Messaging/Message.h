@@ -30,6 +30,7 @@
 #pragma once
 
 #include "../Util/StringUtil.h"
+#include "../Messaging/MessageNameTable.h"
 
 //forward declaration
 class MessageListener;
@@ -71,6 +72,15 @@ public:
 	 */
 	Message(const String& messageName, MessageListener* sender = NULL);
 	
+	/**
+	 * Creates a Message from an already-interned name, which saves a 
+	 *  lookup if you send the same Message often. 
+	 * 
+	 * @param messageId The MessageId of this Message's name
+	 * @param sender Who sent this Message; NULL by default
+	 */
+	Message(MessageId messageId, MessageListener* sender = NULL);
+	
 	/**
 	 * Get the name of this Message. Since all Messages come to the listener
 	 *  via the same ReceiveMessage function, this can be used to filter 
@@ -80,6 +90,18 @@ public:
 	 */
 	virtual const String& GetMessageName() const;
 	
+	/**
+	 * Get the interned ID of this Message's name. The Switchboard uses it 
+	 *  to find subscribers without comparing strings. It's looked up the 
+	 *  first time it's asked for, so don't change the name after sending. 
+	 *  Looking it up never adds the name to theMessageNames, so sending 
+	 *  one-off names (per-Actor timers, built strings) doesn't grow it. 
+	 * 
+	 * @return The MessageId for GetMessageName, or INVALID_MESSAGE_ID if 
+	 *   nobody has ever subscribed to it
+	 */
+	const MessageId GetMessageId() const;
+	
 	/**
 	 * Find out who requested this Message to be sent. This can have all sorts
 	 *  of semantics depending on what the Message itself is communicating. 
@@ -91,6 +113,12 @@ public:
 protected:
 	String _messageName;
 	MessageListener* _sender;
+	
+private:
+	friend class Switchboard;
+	
+	mutable MessageId _messageId;
+	bool _pooled;
 };
 
 ///A templated class for delivering additional information with Messages
@@ -125,6 +153,19 @@ public:
 		_sender = sender;
 	}
 	
+	/**
+	 * Creates a new TypedMessage from an already-interned name. 
+	 * 
+	 * @param messageId The MessageId of the message's name
+	 * @param value Any data of the type defined in the template constructor
+	 * @param sender Who is sending this message; NULL by default
+	 */
+	TypedMessage(MessageId messageId, T value, MessageListener* sender = NULL)
+		: Message(messageId, sender)
+	{
+		_value = value;
+	}
+	
 	/**
 	 * Get the data that this Message carries with it
 	 * 
@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "../Messaging/MessageArena.h"
+
+#include <cstdlib>
+
+// Enough for doubles, pointers and SSE types on every platform we build for.
+static const size_t s_alignment = 16;
+
+MessageArena::MessageArena(size_t blockSize)
+{
+	_blockSize = blockSize;
+	_currentBlock = 0;
+	_offset = 0;
+	_bytesInUse = 0;
+	_bytesReserved = 0;
+}
+
+MessageArena::~MessageArena()
+{
+	for (unsigned int i=0; i < _blocks.size(); i++)
+	{
+		free(_blocks[i]._allocation);
+	}
+}
+
+void* MessageArena::Allocate(size_t size)
+{
+	size = (size + s_alignment - 1) & ~(s_alignment - 1);
+
+	while (_currentBlock < _blocks.size())
+	{
+		Block& block = _blocks[_currentBlock];
+		if (_offset + size <= block._size)
+		{
+			void* memory = block._memory + _offset;
+			_offset += size;
+			_bytesInUse += size;
+			return memory;
+		}
+		_currentBlock++;
+		_offset = 0;
+	}
+
+	// Out of room; anything too big for a normal block gets one to itself.
+	Block block;
+	block._size = (size > _blockSize) ? size : _blockSize;
+	block._allocation = malloc(block._size + s_alignment);
+	// malloc only promises enough alignment for the basic types.
+	size_t address = (size_t)block._allocation;
+	block._memory = (unsigned char*)((address + s_alignment - 1) & ~(s_alignment - 1));
+	_bytesReserved += block._size;
+	_blocks.push_back(block);
+
+	_currentBlock = (unsigned int)_blocks.size() - 1;
+	_offset = size;
+	_bytesInUse += size;
+	return block._memory;
+}
+
+void MessageArena::Reset()
+{
+	_currentBlock = 0;
+	_offset = 0;
+	_bytesInUse = 0;
+}
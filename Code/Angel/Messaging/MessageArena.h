@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+///A bump allocator that the Switchboard uses for Messages
+/** 
+ * Hands out memory by moving a pointer forward through a list of big 
+ *  blocks, and gives it all back at once with Reset. There's no way to 
+ *  free a single allocation, and nothing's destructor gets called for you, 
+ *  so it only suits things that all die at the same time -- like the 
+ *  Messages in a frame's queue, which are gone once SendAllMessages is 
+ *  done with them. 
+ * 
+ * Blocks are kept around after a Reset, so once the arena has grown to fit
+ *  a typical frame it stops asking the system for memory. 
+ * 
+ * It's not thread-safe; only the main thread should use it. 
+ */
+class MessageArena
+{
+public:
+	/**
+	 * Creates an empty arena. No memory is reserved until the first 
+	 *  allocation. 
+	 * 
+	 * @param blockSize How many bytes to reserve at a time
+	 */
+	MessageArena(size_t blockSize = 64 * 1024);
+	
+	/**
+	 * Releases all of the arena's blocks. 
+	 */
+	~MessageArena();
+	
+	/**
+	 * Get some memory from the arena. It's aligned well enough for any 
+	 *  Message type. 
+	 * 
+	 * @param size How many bytes are needed
+	 * @return The memory
+	 */
+	void* Allocate(size_t size);
+	
+	/**
+	 * Makes all the memory handed out so far available again. Anything 
+	 *  that was constructed in it must already have been destroyed. 
+	 */
+	void Reset();
+	
+	/**
+	 * Get the number of bytes handed out since the last Reset. 
+	 * 
+	 * @return The bytes in use
+	 */
+	const int GetBytesInUse() const { return (int)_bytesInUse; }
+	
+	/**
+	 * Get the total size of all the blocks the arena is holding on to. 
+	 * 
+	 * @return The bytes reserved
+	 */
+	const int GetBytesReserved() const { return (int)_bytesReserved; }
+	
+private:
+	struct Block
+	{
+		void* _allocation;
+		unsigned char* _memory;
+		size_t _size;
+	};
+	std::vector<Block> _blocks;
+	unsigned int _currentBlock;
+	size_t _offset;
+	size_t _blockSize;
+	size_t _bytesInUse;
+	size_t _bytesReserved;
+};
@@ -0,0 +1,92 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "../Messaging/MessageNameTable.h"
+
+MessageNameTable* MessageNameTable::s_MessageNameTable = NULL;
+
+MessageNameTable::MessageNameTable()
+{
+}
+
+MessageNameTable& MessageNameTable::GetInstance()
+{
+	if (s_MessageNameTable == NULL)
+	{
+		s_MessageNameTable = new MessageNameTable();
+	}
+	return *s_MessageNameTable;
+}
+
+MessageId MessageNameTable::Intern(const String& name)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	hashmap_ns::hash_map<String, MessageId>::iterator it = _ids.find(name);
+	if (it != _ids.end())
+	{
+		return it->second;
+	}
+
+	MessageId id = (MessageId)_names.size();
+	_names.push_back(name);
+	_ids[name] = id;
+	return id;
+}
+
+MessageId MessageNameTable::Find(const String& name)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	hashmap_ns::hash_map<String, MessageId>::iterator it = _ids.find(name);
+	if (it == _ids.end())
+	{
+		return INVALID_MESSAGE_ID;
+	}
+	return it->second;
+}
+
+const String& MessageNameTable::GetName(MessageId id)
+{
+	static const String empty;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	if ((id < 0) || (id >= (MessageId)_names.size()))
+	{
+		return empty;
+	}
+	return _names[id];
+}
+
+const int MessageNameTable::GetCount()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return (int)_names.size();
+}
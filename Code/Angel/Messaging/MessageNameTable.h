@@ -0,0 +1,116 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008-2014, Shane Liesegang
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright 
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright 
+//       notice, this list of conditions and the following disclaimer in the 
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder nor the names of any 
+//       contributors may be used to endorse or promote products derived from 
+//       this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../Util/StringUtil.h"
+
+#include <deque>
+#include <mutex>
+
+///An integer standing in for a Message name
+/** 
+ * Every distinct Message name gets its own small, dense ID the first time
+ *  it's seen, so the Switchboard can index its subscriber lists directly 
+ *  instead of comparing strings. 
+ */
+typedef int MessageId;
+
+#define INVALID_MESSAGE_ID -1
+
+//singleton shortcut
+#define theMessageNames MessageNameTable::GetInstance()
+
+///The global table that maps Message names to MessageIds and back
+/** 
+ * You usually won't need to touch this directly -- Messages and the 
+ *  Switchboard look names up as needed. If you're sending the same Message 
+ *  a lot, though, you can look its ID up once and pass that around instead
+ *  of the string. 
+ * 
+ * IDs are never reused or removed, and it's safe to intern names from 
+ *  any thread. 
+ * 
+ * Like the World, it uses the singleton pattern; use "theMessageNames" to 
+ *  access it. 
+ */
+class MessageNameTable
+{
+public:
+	/**
+	 * Used to access the singleton instance of this class. As a shortcut, 
+	 *  you can just use "theMessageNames". 
+	 * 
+	 * @return The singleton
+	 */
+	static MessageNameTable& GetInstance();
+	
+	/**
+	 * Get the ID for a Message name, assigning a new one if this is the 
+	 *  first time the name has come up. 
+	 * 
+	 * @param name The Message name
+	 * @return Its ID
+	 */
+	MessageId Intern(const String& name);
+	
+	/**
+	 * Get the ID for a Message name without adding it to the table. 
+	 * 
+	 * @param name The Message name
+	 * @return Its ID, or INVALID_MESSAGE_ID if it's never been interned
+	 */
+	MessageId Find(const String& name);
+	
+	/**
+	 * Get the name that goes with an ID. 
+	 * 
+	 * @param id An ID returned by Intern
+	 * @return The Message name, or an empty string for an unknown ID
+	 */
+	const String& GetName(MessageId id);
+	
+	/**
+	 * Get the number of names that have been interned. Every ID is less 
+	 *  than this. 
+	 * 
+	 * @return The number of distinct Message names
+	 */
+	const int GetCount();
+	
+protected:
+	MessageNameTable();
+	static MessageNameTable* s_MessageNameTable;
+	
+private:
+	hashmap_ns::hash_map<String, MessageId> _ids;
+	// A deque, so handing out references stays safe as it grows
+	std::deque<String> _names;
+	std::mutex _mutex;
+};
@@ -32,11 +32,36 @@
 
 #include "../Infrastructure/World.h"
 
+#include <algorithm>
+#include <functional>
+
 Switchboard* Switchboard::s_Switchboard = NULL;
 
 Switchboard::Switchboard()
 {
 	_messagesLocked = false;
+
+	// Until the World says otherwise, whoever creates us is the thread 
+	//  that delivers messages.
+	_mainThread = std::this_thread::get_id();
+
+	IntakeNode* stub = new IntakeNode();
+	stub->_next = NULL;
+	stub->_message = NULL;
+	_intakeHead = stub;
+	_intakeTail = stub;
+
+	_enqueued = 0;
+	_delivered = 0;
+	_fromOtherThreads = 0;
+	_pooled = 0;
+	_lastEnqueued = 0;
+	_lastDelivered = 0;
+	_lastFromOtherThreads = 0;
+	_lastPooled = 0;
+
+	_nextTimerHandle = INVALID_DEFERRED_BROADCAST + 1;
+	_currentTime = 0.0;
 }
 
 Switchboard& Switchboard::GetInstance()
@@ -48,128 +73,359 @@ Switchboard& Switchboard::GetInstance()
 	return *s_Switchboard;
 }
 
+void Switchboard::SetMainThread()
+{
+	_mainThread = std::this_thread::get_id();
+}
+
 void Switchboard::Broadcast(Message* message)
 {
+	// Messages sent from the World's parallel update get held there and 
+	//  sent from the main thread afterwards.
+	if (theWorld.CaptureBroadcast(message))
+	{
+		return;
+	}
+
+	++_enqueued;
+	if (std::this_thread::get_id() != _mainThread)
+	{
+		PushIntake(message, -1.0f);
+		return;
+	}
+
 	_messages.push(message);
 }
 
-void Switchboard::DeferredBroadcast(Message* message, float delay)
+void Switchboard::Broadcast(const String& messageName, MessageListener* sender)
 {
-	MessageTimer mt(message, delay);
-	_delayedMessages.push_back(mt);
+	void* memory = AllocateMessage(sizeof(Message));
+	Message* message = NULL;
+	if (memory != NULL)
+	{
+		message = new (memory) Message(messageName, sender);
+		message->_pooled = true;
+	}
+	else
+	{
+		message = new Message(messageName, sender);
+	}
+	Broadcast(message);
 }
 
-void Switchboard::Update(float dt)
+void Switchboard::Broadcast(MessageId messageId, MessageListener* sender)
+{
+	void* memory = AllocateMessage(sizeof(Message));
+	Message* message = NULL;
+	if (memory != NULL)
+	{
+		message = new (memory) Message(messageId, sender);
+		message->_pooled = true;
+	}
+	else
+	{
+		message = new Message(messageId, sender);
+	}
+	Broadcast(message);
+}
+
+void* Switchboard::AllocateMessage(size_t size)
+{
+	if (std::this_thread::get_id() != _mainThread)
+	{
+		return NULL;
+	}
+	++_pooled;
+	return _arena.Allocate(size);
+}
+
+void Switchboard::ReleaseMessage(Message* message)
+{
+	if (message->_pooled)
+	{
+		// The memory goes back when the arena is reset.
+		message->~Message();
+	}
+	else
+	{
+		delete message;
+	}
+}
+
+DeferredBroadcastHandle Switchboard::DeferredBroadcast(Message* message, float delay)
+{
+	if (theWorld.CaptureBroadcast(message, (delay > 0.0f) ? delay : 0.0f))
+	{
+		return INVALID_DEFERRED_BROADCAST;
+	}
+
+	if (std::this_thread::get_id() != _mainThread)
+	{
+		PushIntake(message, (delay > 0.0f) ? delay : 0.0f);
+		return INVALID_DEFERRED_BROADCAST;
+	}
+
+	return ScheduleTimer(message, delay);
+}
+
+DeferredBroadcastHandle Switchboard::ScheduleTimer(Message* message, float delay)
+{
+	DeferredBroadcastHandle handle = _nextTimerHandle++;
+	if (_nextTimerHandle == INVALID_DEFERRED_BROADCAST)
+	{
+		_nextTimerHandle++;
+	}
+
+	_pendingTimers[handle] = message;
+	_timerHeap.push_back(MessageTimer(_currentTime + MathUtil::Max(0.0f, delay), handle));
+	std::push_heap(_timerHeap.begin(), _timerHeap.end(), std::greater<MessageTimer>());
+	return handle;
+}
+
+const bool Switchboard::CancelDeferredBroadcast(DeferredBroadcastHandle handle)
+{
+	hashmap_ns::hash_map<DeferredBroadcastHandle, Message*>::iterator it = _pendingTimers.find(handle);
+	if (it == _pendingTimers.end())
+	{
+		return false;
+	}
+	ReleaseMessage(it->second);
+	_pendingTimers.erase(it);
+
+	// Once most of the heap is cancelled entries, sweep them out so it 
+	//  doesn't grow without bound in games that cancel a lot.
+	if (_timerHeap.size() > 2 * _pendingTimers.size() + 64)
+	{
+		unsigned int kept = 0;
+		for (unsigned int i=0; i < _timerHeap.size(); i++)
+		{
+			if (_pendingTimers.find(_timerHeap[i]._handle) != _pendingTimers.end())
+			{
+				_timerHeap[kept++] = _timerHeap[i];
+			}
+		}
+		_timerHeap.resize(kept, MessageTimer(0.0, INVALID_DEFERRED_BROADCAST));
+		std::make_heap(_timerHeap.begin(), _timerHeap.end(), std::greater<MessageTimer>());
+	}
+	return true;
+}
+
+void Switchboard::PushIntake(Message* message, float delay)
+{
+	IntakeNode* node = new IntakeNode();
+	node->_next.store(NULL, std::memory_order_relaxed);
+	node->_message = message;
+	node->_delay = delay;
+
+	IntakeNode* previous = _intakeHead.exchange(node, std::memory_order_acq_rel);
+	previous->_next.store(node, std::memory_order_release);
+}
+
+void Switchboard::DrainIntake()
 {
-	std::vector<MessageTimer>::iterator it = _delayedMessages.begin();
-	while (it != _delayedMessages.end())
+	// A producer that's halfway through pushing won't be linked in yet; it
+	//  just gets picked up next frame.
+	// Links only ever get added in the order each producer pushed, so 
+	//  following them keeps every thread's Messages in its own order.
+	IntakeNode* next = _intakeTail->_next.load(std::memory_order_acquire);
+	while (next != NULL)
 	{
-		(*it)._timeRemaining -= dt;
-		if ((*it)._timeRemaining <= 0.0f)
+		if (next->_delay < 0.0f)
 		{
-			Broadcast((*it)._message);
-			it = _delayedMessages.erase(it);
+			_messages.push(next->_message);
 		}
 		else
 		{
-			it++;
+			ScheduleTimer(next->_message, next->_delay);
+		}
+		_fromOtherThreads++;
+
+		delete _intakeTail;
+		_intakeTail = next;
+		next = _intakeTail->_next.load(std::memory_order_acquire);
+	}
+}
+
+void Switchboard::Update(float dt)
+{
+	_currentTime += dt;
+	while (!_timerHeap.empty() && (_timerHeap.front()._fireTime <= _currentTime))
+	{
+		DeferredBroadcastHandle handle = _timerHeap.front()._handle;
+		std::pop_heap(_timerHeap.begin(), _timerHeap.end(), std::greater<MessageTimer>());
+		_timerHeap.pop_back();
+
+		// Cancelled timers have already been taken out of the table.
+		hashmap_ns::hash_map<DeferredBroadcastHandle, Message*>::iterator it = _pendingTimers.find(handle);
+		if (it != _pendingTimers.end())
+		{
+			Message* message = it->second;
+			_pendingTimers.erase(it);
+			Broadcast(message);
 		}
 	}
 }
 
 const bool Switchboard::SubscribeTo(MessageListener* subscriber, const String& messageType)
 {
+	return SubscribeTo(subscriber, theMessageNames.Intern(messageType));
+}
+
+const bool Switchboard::SubscribeTo(MessageListener* subscriber, MessageId messageId)
+{
+	if ((subscriber == NULL) || (messageId < 0))
+	{
+		return false;
+	}
+
 	if (_messagesLocked)
 	{
-		_deferredAdds.push_back(SubscriptionInfo(subscriber, messageType));
+		_deferredAdds.push_back(SubscriptionInfo(subscriber, messageId));
 		return false;
 	}
 	
-	_subscriptions[subscriber].insert(messageType);
-	std::pair<std::set<MessageListener*>::iterator, bool> insertResult = _subscribers[messageType].insert(subscriber);
-	return insertResult.second;
+	if (messageId >= (MessageId)_subscribers.size())
+	{
+		_subscribers.resize(messageId + 1);
+	}
+	SubscriberList& list = _subscribers[messageId];
+	if (std::find(list.begin(), list.end(), subscriber) != list.end())
+	{
+		return false;
+	}
+	list.push_back(subscriber);
+	_subscriptions[subscriber].insert(theMessageNames.GetName(messageId));
+	return true;
 }
 
 const bool Switchboard::UnsubscribeFrom(MessageListener* subscriber, const String& messageType)
 {
+	// Nobody can be subscribed to a name that was never interned.
+	MessageId messageId = theMessageNames.Find(messageType);
+	if (messageId == INVALID_MESSAGE_ID)
+	{
+		return false;
+	}
+	return UnsubscribeFrom(subscriber, messageId);
+}
+
+const bool Switchboard::UnsubscribeFrom(MessageListener* subscriber, MessageId messageId)
+{
+	if (messageId < 0)
+	{
+		return false;
+	}
+
 	if (_messagesLocked)
 	{
-		_deferredRemoves.push_back(SubscriptionInfo(subscriber, messageType));
+		_deferredRemoves.push_back(SubscriptionInfo(subscriber, messageId));
 		return false;
 	}
 	
-	if (_subscribers.find(messageType) == _subscribers.end())
+	if (messageId >= (MessageId)_subscribers.size())
 	{
 		return false;
 	}
-	std::set<MessageListener*>::iterator it = _subscribers[messageType].find(subscriber);
-	if (it == _subscribers[messageType].end())
+	SubscriberList& list = _subscribers[messageId];
+	SubscriberList::iterator it = std::find(list.begin(), list.end(), subscriber);
+	if (it == list.end())
 	{
 		return false;
 	}
-	else
+
+	// Keep subscription order, since that's the delivery order.
+	list.erase(it);
+	std::map< MessageListener*, StringSet >::iterator subIt = _subscriptions.find(subscriber);
+	if (subIt != _subscriptions.end())
 	{
-		_subscribers[messageType].erase(it);
-		StringSet::iterator sIt = _subscriptions[subscriber].find(messageType);
-		if (sIt != _subscriptions[subscriber].end())
-			_subscriptions[subscriber].erase(sIt);
-		return true;
+		subIt->second.erase(theMessageNames.GetName(messageId));
+		if (subIt->second.empty())
+		{
+			_subscriptions.erase(subIt);
+		}
 	}
+	return true;
 }
 
-const std::set<MessageListener*> Switchboard::GetSubscribersTo(const String& messageType)
+const std::vector<MessageListener*>& Switchboard::GetSubscribersTo(const String& messageType)
 {
-	if (_subscribers.find(messageType) == _subscribers.end())
-	{
-		return std::set<MessageListener*>();
-	}
-	else
-	{
-		return _subscribers[messageType];		
-	}
+	return GetSubscribersTo(theMessageNames.Find(messageType));
 }
 
-const StringSet Switchboard::GetSubscriptionsFor(MessageListener* subscriber)
+const std::vector<MessageListener*>& Switchboard::GetSubscribersTo(MessageId messageId)
 {
-	if (_subscriptions.find(subscriber) == _subscriptions.end())
+	static const SubscriberList empty;
+	if ((messageId < 0) || (messageId >= (MessageId)_subscribers.size()))
 	{
-		return StringSet();
+		return empty;
 	}
-	else
+	return _subscribers[messageId];
+}
+
+const bool Switchboard::HasSubscribers(const String& messageType) const
+{
+	return HasSubscribers(theMessageNames.Find(messageType));
+}
+
+const StringSet& Switchboard::GetSubscriptionsFor(MessageListener* subscriber)
+{
+	static const StringSet empty;
+	std::map< MessageListener*, StringSet >::const_iterator it = _subscriptions.find(subscriber);
+	if (it == _subscriptions.end())
 	{
-		return _subscriptions[subscriber];
+		return empty;
 	}
+	return it->second;
 }
 
 void Switchboard::SendAllMessages()
 {
+	DrainIntake();
+
 	_messagesLocked = true;
 	while (!_messages.empty())
 	{
-		String frontMessageName = _messages.front()->GetMessageName();
-		if (_subscribers.find(frontMessageName) != _subscribers.end())
+		++_delivered;
+		Message* message = _messages.front();
+		MessageId messageId = message->GetMessageId();
+		// A name that was never interned has no subscribers to go to.
+		if ((messageId != INVALID_MESSAGE_ID) && (messageId < (MessageId)_subscribers.size()))
 		{
-			std::set<MessageListener*>::iterator listenIt = _subscribers[frontMessageName].begin();
-			while (listenIt != _subscribers[frontMessageName].end())
+			// Subscription changes are deferred while we're locked, so the
+			//  list can't move out from under us.
+			const SubscriberList& listeners = _subscribers[messageId];
+			for (unsigned int i=0; i < listeners.size(); i++)
 			{
-				(*listenIt)->ReceiveMessage(_messages.front());
-				listenIt++;
+				listeners[i]->ReceiveMessage(message);
 			}
 		}
-		delete _messages.front();
+		ReleaseMessage(message);
 		_messages.pop();
 	}
 	_messagesLocked = false;
+
+	// Everything that was built in the arena has been delivered and 
+	//  destroyed by now -- including anything broadcast while we were 
+	//  delivering, since that went on the end of the same queue.
+	_arena.Reset();
+
+	_lastEnqueued = _enqueued.exchange(0);
+	_lastDelivered = _delivered;
+	_lastFromOtherThreads = _fromOtherThreads;
+	_lastPooled = _pooled;
+	_delivered = 0;
+	_fromOtherThreads = 0;
+	_pooled = 0;
 	
 	for(unsigned int i = 0; i < _deferredRemoves.size(); i++)
 	{
-		UnsubscribeFrom(_deferredRemoves[i]._subscriber, _deferredRemoves[i]._messageType);
+		UnsubscribeFrom(_deferredRemoves[i]._subscriber, _deferredRemoves[i]._messageId);
 	}
 	_deferredRemoves.clear();
 	
 	for(unsigned int i = 0; i < _deferredAdds.size(); i++)
 	{
-		SubscribeTo(_deferredAdds[i]._subscriber, _deferredAdds[i]._messageType);
+		SubscribeTo(_deferredAdds[i]._subscriber, _deferredAdds[i]._messageId);
 	}
 	_deferredAdds.clear();
 }
\ No newline at end of file
@@ -30,9 +30,18 @@
 #pragma once
 
 #include "../Messaging/Message.h"
+#include "../Messaging/MessageArena.h"
 #include "../Util/MathUtil.h"
 
 #include <queue>
+#include <new>
+#include <atomic>
+#include <thread>
+
+///Identifies a pending DeferredBroadcast so it can be cancelled
+typedef unsigned int DeferredBroadcastHandle;
+
+#define INVALID_DEFERRED_BROADCAST 0
 
 //Singleton shortcut
 #define theSwitchboard Switchboard::GetInstance()
@@ -69,20 +78,130 @@ public:
 	 *  of the current frame, outside the Update loop. (Which means you can
 	 *  safely remove objects from the World in response to a Message.)
 	 * 
+	 * Broadcast can be called from any thread. Messages from the main 
+	 *  thread are delivered in the order they were sent. Messages from other
+	 *  threads go through a lock-free intake and are delivered after the 
+	 *  main thread's, in the order they arrived. The only guarantee there 
+	 *  is that each thread's Messages stay in the order it sent them; how 
+	 *  they interleave with other threads' depends on timing. (Broadcasts 
+	 *  from the World's parallel update phase are held and replayed in 
+	 *  order on the main thread, so those are deterministic.)
+	 * 
 	 * @param message The message to send
 	 */
 	void Broadcast(Message* message);
 	
+	/**
+	 * Broadcasts a plain Message without making you allocate it. Messages
+	 *  sent this way from the main thread are built in a per-frame arena 
+	 *  that gets reset once they've all been delivered, so a heavy frame 
+	 *  doesn't hammer the heap. Otherwise it's the same as broadcasting 
+	 *  a new Message yourself. 
+	 * 
+	 * @param messageName The name of the Message to send
+	 * @param sender Who's sending it; NULL by default
+	 */
+	void Broadcast(const String& messageName, MessageListener* sender = NULL);
+	
+	/**
+	 * Same as above, but takes an already-interned Message name. 
+	 * 
+	 * @param messageId The MessageId of the Message to send
+	 * @param sender Who's sending it; NULL by default
+	 */
+	void Broadcast(MessageId messageId, MessageListener* sender = NULL);
+	
+	/**
+	 * Broadcasts a TypedMessage carrying a value, built in the same 
+	 *  per-frame arena as above. 
+	 * 
+	 * \code
+	 * theSwitchboard.Broadcast("StartingSpot", a->GetPosition(), a);
+	 * \endcode
+	 * 
+	 * The sender isn't optional here, since otherwise passing a pointer 
+	 *  as the sender would quietly turn it into the value. 
+	 * 
+	 * @param messageName The name of the Message to send
+	 * @param value The data it carries
+	 * @param sender Who's sending it (can be NULL)
+	 */
+	template <class T>
+	void Broadcast(const String& messageName, const T& value, MessageListener* sender)
+	{
+		void* memory = AllocateMessage(sizeof(TypedMessage<T>));
+		Message* message = NULL;
+		if (memory != NULL)
+		{
+			message = new (memory) TypedMessage<T>(messageName, value, sender);
+			message->_pooled = true;
+		}
+		else
+		{
+			message = new TypedMessage<T>(messageName, value, sender);
+		}
+		Broadcast(message);
+	}
+	
+	/**
+	 * Same as above, but takes an already-interned Message name. 
+	 * 
+	 * @param messageId The MessageId of the Message to send
+	 * @param value The data it carries
+	 * @param sender Who's sending it (can be NULL)
+	 */
+	template <class T>
+	void Broadcast(MessageId messageId, const T& value, MessageListener* sender)
+	{
+		void* memory = AllocateMessage(sizeof(TypedMessage<T>));
+		Message* message = NULL;
+		if (memory != NULL)
+		{
+			message = new (memory) TypedMessage<T>(messageId, value, sender);
+			message->_pooled = true;
+		}
+		else
+		{
+			message = new TypedMessage<T>(messageId, value, sender);
+		}
+		Broadcast(message);
+	}
+	
 	/**
 	 * Lets you send a Message after a designated delay. Oftentimes you want
 	 *  something to happen a little while *after* an event, and it can be
 	 *  be easier to simply defer the sending of the Message rather than
 	 *  make the MessageListener responsible for implementing the delay. 
 	 * 
+	 * Pending Messages are kept in a heap ordered by the time they're due, 
+	 *  so having thousands of them waiting doesn't cost anything per frame. 
+	 *  Messages that come due in the same frame go out in the order they 
+	 *  were due, then in the order they were deferred. 
+	 * 
 	 * @param message The message to send
 	 * @param delay Amount of time (in seconds) to wait before sending
+	 * @return A handle you can pass to CancelDeferredBroadcast. Deferred 
+	 *   broadcasts made off the main thread (or during the World's parallel
+	 *   update) are scheduled later on, and get INVALID_DEFERRED_BROADCAST.
 	 */
-	void DeferredBroadcast(Message* message, float delay);
+	DeferredBroadcastHandle DeferredBroadcast(Message* message, float delay);
+	
+	/**
+	 * Calls off a DeferredBroadcast that hasn't gone out yet. The Message 
+	 *  is deleted without being delivered. 
+	 * 
+	 * @param handle The handle DeferredBroadcast returned
+	 * @return True if it was cancelled; false if it had already been sent,
+	 *   was already cancelled, or the handle was never valid
+	 */
+	const bool CancelDeferredBroadcast(DeferredBroadcastHandle handle);
+	
+	/**
+	 * Get the number of DeferredBroadcasts still waiting to be sent. 
+	 * 
+	 * @return The number of pending deferred Messages
+	 */
+	const int GetNumDeferredBroadcasts() const { return (int)_pendingTimers.size(); }
 	
 	/**
 	 * Takes the same form as the Renderable::Update function, but Switchboard
@@ -108,6 +227,15 @@ public:
 	 */
 	const bool SubscribeTo(MessageListener* subscriber, const String& messageType);
 	
+	/**
+	 * Same as above, but takes an already-interned Message name. 
+	 * 
+	 * @param subscriber The MessageListener to sign up
+	 * @param messageId The MessageId of the Message it's interested in
+	 * @return True if the MessageListener was successfully subscribed
+	 */
+	const bool SubscribeTo(MessageListener* subscriber, MessageId messageId);
+	
 	/**
 	 * Lets a MessageListener stop receiving notifications of specific 
 	 *  name. MessageListeners automatically unsubscribe from all their Messages 
@@ -127,22 +255,66 @@ public:
 	 */
 	const bool UnsubscribeFrom(MessageListener* subscriber, const String& messageType);
 	
+	/**
+	 * Same as above, but takes an already-interned Message name. 
+	 * 
+	 * @param subscriber The MessageListener that doesn't want to get these
+	 *   Messages anymore
+	 * @param messageId The MessageId of the Message they're tired of 
+	 *   hearing about
+	 * @return True if the MessageListener was successfully unsubscribed
+	 */
+	const bool UnsubscribeFrom(MessageListener* subscriber, MessageId messageId);
+	
 	/**
 	 * Get a list of all MessageListeners subscribed to Messages with a 
-	 *  given name. 
+	 *  given name, in the order they subscribed. Nothing is copied; the 
+	 *  reference is only good until the next subscription change, so copy 
+	 *  it yourself if you need to hang on to it. 
 	 * 
 	 * @param messageName The Message you care about
-	 * @return A std::set of objects subscribed
+	 * @return The subscribers (empty if there are none)
 	 */
-	const std::set<MessageListener*> GetSubscribersTo(const String& messageName);
+	const std::vector<MessageListener*>& GetSubscribersTo(const String& messageName);
 	
 	/**
-	 * Get a list of all Message subscriptions for a certain MessageListener
+	 * Same as above, but takes an already-interned Message name. 
+	 * 
+	 * @param messageId The MessageId you care about
+	 * @return The subscribers (empty if there are none)
+	 */
+	const std::vector<MessageListener*>& GetSubscribersTo(MessageId messageId);
+	
+	/**
+	 * Find out whether anybody is listening for a Message before going to 
+	 *  the trouble of building it. 
+	 * 
+	 * @param messageName The Message you care about
+	 * @return True if it has at least one subscriber
+	 */
+	const bool HasSubscribers(const String& messageName) const;
+	
+	/**
+	 * Same as above, but takes an already-interned Message name. This is 
+	 *  just an index and a size check, so it's fine to call per-contact or 
+	 *  per-Actor. 
+	 * 
+	 * @param messageId The MessageId you care about
+	 * @return True if it has at least one subscriber
+	 */
+	const bool HasSubscribers(MessageId messageId) const
+	{
+		return (messageId >= 0) && (messageId < (MessageId)_subscribers.size()) && !_subscribers[messageId].empty();
+	}
+	
+	/**
+	 * Get a list of all Message subscriptions for a certain MessageListener.
+	 *  Like GetSubscribersTo, this doesn't make a copy. 
 	 * 
 	 * @param subscriber The MessageListener you care about
 	 * @return A StringSet of all their subscriptions
 	 */
-	const StringSet GetSubscriptionsFor(MessageListener* subscriber);
+	const StringSet& GetSubscriptionsFor(MessageListener* subscriber);
 	
 	/**
 	 * Immediately sends all Messages to the appropriate subscribers. Called
@@ -151,37 +323,139 @@ public:
 	 */
 	void SendAllMessages();
 	
+	/**
+	 * INTERNAL: Makes the calling thread the one that delivers Messages; 
+	 *  Broadcasts from any other thread go through the intake. Called by 
+	 *  the World in Initialize, so a thread that happens to touch the 
+	 *  Switchboard first doesn't take over. 
+	 */
+	void SetMainThread();
+	
+	/**
+	 * Get the number of Messages broadcast (from any thread) between the 
+	 *  last two calls to SendAllMessages. 
+	 * 
+	 * @return The number of Messages enqueued last frame
+	 */
+	const int GetMessagesEnqueued() const { return _lastEnqueued; }
+	
+	/**
+	 * Get the number of Messages that were delivered in the last call to 
+	 *  SendAllMessages. 
+	 * 
+	 * @return The number of Messages dequeued last frame
+	 */
+	const int GetMessagesDelivered() const { return _lastDelivered; }
+	
+	/**
+	 * Get how many of last frame's Messages came in from threads other than
+	 *  the main one. 
+	 * 
+	 * @return The number of Messages that went through the thread intake
+	 */
+	const int GetMessagesFromOtherThreads() const { return _lastFromOtherThreads; }
+	
+	/**
+	 * Get how many Messages were built in the Switchboard's arena rather 
+	 *  than on the heap between the last two calls to SendAllMessages. 
+	 * 
+	 * @return The number of pooled Messages last frame
+	 */
+	const int GetMessagesPooled() const { return _lastPooled; }
+	
+	/**
+	 * Get how much memory the Message arena is holding on to. It grows to 
+	 *  fit the busiest frame so far and doesn't shrink. 
+	 * 
+	 * @return The arena's size in bytes
+	 */
+	const int GetMessageArenaSize() const { return _arena.GetBytesReserved(); }
+	
 protected:
 	Switchboard();
 	static Switchboard* s_Switchboard;
 	
 private:
+	// Returns NULL when called off the main thread, since the arena's not 
+	//  thread-safe; the caller falls back to the heap.
+	void* AllocateMessage(size_t size);
+	void ReleaseMessage(Message* message);
+	
 	std::queue<Message*> _messages;
+	MessageArena _arena;
+	int _pooled;
+	int _lastPooled;
 	
-	std::map< String, std::set<MessageListener*> > _subscribers;
+	// Multi-producer, single-consumer linked list for Messages sent from 
+	//  other threads. Producers swap themselves in at the head; the main 
+	//  thread follows the links from the tail. There's always one spent 
+	//  node at the tail, so neither end ever has to check for empty.
+	struct IntakeNode
+	{
+		std::atomic<IntakeNode*> _next;
+		Message* _message;
+		float _delay;
+	};
+	
+	void PushIntake(Message* message, float delay);
+	void DrainIntake();
+	
+	std::atomic<IntakeNode*> _intakeHead;
+	IntakeNode* _intakeTail;
+	std::thread::id _mainThread;
+	
+	std::atomic<int> _enqueued;
+	int _delivered;
+	int _fromOtherThreads;
+	int _lastEnqueued;
+	int _lastDelivered;
+	int _lastFromOtherThreads;
+	
+	// Indexed by MessageId. Each list is small, so a linear scan for 
+	//  duplicates beats a set, and walking it on delivery is just a loop.
+	typedef std::vector<MessageListener*> SubscriberList;
+	std::vector<SubscriberList> _subscribers;
 	std::map< MessageListener*, StringSet > _subscriptions;
 	
+	DeferredBroadcastHandle ScheduleTimer(Message* message, float delay);
+	
+	// The heap only holds due times; the Messages themselves live in 
+	//  _pendingTimers. Cancelling just removes the Message, and the stale 
+	//  heap entry is thrown away when it comes up (or when enough of them 
+	//  pile up that it's worth rebuilding the heap).
 	struct MessageTimer
 	{
-		Message* _message;
-		float _timeRemaining;
+		double _fireTime;
+		DeferredBroadcastHandle _handle;
+		
+		MessageTimer(double fireTime, DeferredBroadcastHandle handle)
+		{
+			_fireTime = fireTime;
+			_handle = handle;
+		}
 		
-		MessageTimer(Message* message, float timeRemaining)
+		bool operator>(const MessageTimer& other) const
 		{
-			_message = message;
-			_timeRemaining = MathUtil::Max(0.0f, timeRemaining);
+			if (_fireTime != other._fireTime)
+			{
+				return _fireTime > other._fireTime;
+			}
+			return _handle > other._handle;
 		}
 	};
-	std::vector<MessageTimer> _delayedMessages;
+	std::vector<MessageTimer> _timerHeap;
+	hashmap_ns::hash_map<DeferredBroadcastHandle, Message*> _pendingTimers;
+	DeferredBroadcastHandle _nextTimerHandle;
+	double _currentTime;
 	
 	struct SubscriptionInfo 
 	{
 		MessageListener* _subscriber;
-		String _messageType;
+		MessageId _messageId;
 		
-		SubscriptionInfo(MessageListener* subscriber, String messageType) :
+		SubscriptionInfo(MessageListener* subscriber, MessageId messageId) :
 		_subscriber(subscriber),
-		_messageType(messageType)
+		_messageId(messageId)
 		{}
 	};
 	bool _messagesLocked;
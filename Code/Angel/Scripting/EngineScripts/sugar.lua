@@ -32,7 +32,9 @@ require "util"
 -- Singleton shortcuts
 theWorld = World_GetInstance()
 theTagList = TagCollection_GetInstance()
+theSpatialIndex = SpatialIndex_GetInstance()
 theSwitchboard = Switchboard_GetInstance()
+theMessageNames = MessageNameTable_GetInstance()
 theCamera = Camera_GetInstance()
 theSound = SoundDevice_GetInstance()
 theTuning = Tuning_GetInstance()
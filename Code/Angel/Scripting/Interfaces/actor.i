@@ -2,10 +2,12 @@
 %{
 #include "../../Actors/Actor.h"
 #include "../../Infrastructure/TagCollection.h"
+#include "../../Infrastructure/SpatialIndex.h"
 %}
 
 typedef std::set<Actor*>	ActorSet;
 typedef std::vector<Actor*>	ActorList;
+typedef unsigned int ActorHandle;
 
 #ifdef SWIGLUA
 %typemap(out) std::vector<Actor*>
@@ -115,6 +117,9 @@ public:
 	const String SetName(String newName);
 	const String GetName();
 	static const Actor* GetNamed(String nameLookup);
+	const ActorHandle GetHandle() const;
+	static Actor* const GetFromHandle(ActorHandle handle);
+	const int GetHandleIndex() const;
 	
 	void SetLayer(int layerIndex);
 	void SetLayer(String layerName);
@@ -140,3 +145,29 @@ public:
 	ActorSet GetObjectsTagged(String findTag);
 	StringSet GetTagList();
 };
+
+class TagQuery
+{
+public:
+	TagQuery(const String& tags, bool matchAny = false);
+	
+	const bool Matches(const Actor* actor) const;
+	const int Count() const;
+};
+
+%nodefaultctor SpatialIndex;
+class SpatialIndex
+{
+public:
+	static SpatialIndex& GetInstance();
+	
+	ActorList GetActorsInBox(const Vector2& min, const Vector2& max);
+	ActorList GetActorsInRadius(const Vector2& center, float radius);
+	ActorList GetActorsAlongRay(const Vector2& start, const Vector2& end);
+	
+	void SetCellSize(float cellSize);
+	const float GetCellSize() const;
+	const int GetNumTracked() const;
+	const int GetNumCells() const;
+	const int GetNumOversized() const;
+};
@@ -2,14 +2,31 @@
 %{
 #include "../../Messaging/Switchboard.h"
 #include "../../Messaging/Message.h"
+#include "../../Messaging/MessageNameTable.h"
 %}
 
+typedef int MessageId;
+typedef unsigned int DeferredBroadcastHandle;
+
+%nodefaultctor MessageNameTable;
+class MessageNameTable
+{
+public:
+	static MessageNameTable& GetInstance();
+	
+	MessageId Intern(const String& name);
+	MessageId Find(const String& name);
+	const String& GetName(MessageId id);
+	const int GetCount();
+};
+
 class Message
 {
 public:
 	Message(String messageName, MessageListener* sender = NULL);
 	
 	virtual const String GetMessageName();
+	const MessageId GetMessageId();
 	
 	MessageListener* const GetSender();
 };
@@ -49,12 +66,25 @@ public:
 	
 	%apply SWIGTYPE *DISOWN {Message* message};
 	void Broadcast(Message* message);
-	void DeferredBroadcast(Message* message, float delay);
+	DeferredBroadcastHandle DeferredBroadcast(Message* message, float delay);
 	%clear Message* message;
+	const bool CancelDeferredBroadcast(DeferredBroadcastHandle handle);
+	const int GetNumDeferredBroadcasts() const;
+	void Broadcast(const String& messageName, MessageListener* sender = NULL);
 	
 	const bool SubscribeTo(MessageListener* subscriber, String messageType);
 	const bool UnsubscribeFrom(MessageListener* subscriber, String messageType);
+	const bool SubscribeTo(MessageListener* subscriber, MessageId messageId);
+	const bool UnsubscribeFrom(MessageListener* subscriber, MessageId messageId);
 	
-	const std::set<MessageListener*> GetSubscribersTo(String messageType);
+	const std::vector<MessageListener*> GetSubscribersTo(String messageType);
+	const bool HasSubscribers(String messageType) const;
+	const bool HasSubscribers(MessageId messageId) const;
 	const StringSet GetSubscriptionsFor(MessageListener* subscriber);
+	
+	const int GetMessagesEnqueued() const;
+	const int GetMessagesDelivered() const;
+	const int GetMessagesFromOtherThreads() const;
+	const int GetMessagesPooled() const;
+	const int GetMessageArenaSize() const;
 };
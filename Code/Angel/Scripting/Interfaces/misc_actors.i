@@ -41,6 +41,7 @@ public:
 class HUDActor : public Actor 
 {
 public:
+	HUDActor();
 
 	virtual const String GetClassName() const;
 };
@@ -1,6 +1,7 @@
 %module angel
 %{
 #include "../../Actors/ParticleActor.h"
+#include "../../Infrastructure/ParticleSystemManager.h"
 %}
 
 class ParticleActor : public Actor
@@ -26,5 +27,26 @@ public:
 	void SetAttractorStrength(float strength);
 	void SetMaxParticles(int maxParticles);
 
+	const int GetMaxParticles() const;
+	const int GetNumParticlesAlive() const;
+	const float GetPoolOccupancy() const;
+	const int GetNumParticlesSpawned() const;
+	const int GetNumParticlesExpired() const;
+
 	virtual const String GetClassName() const;
 };
+
+%nodefaultctor ParticleSystemManager;
+class ParticleSystemManager
+{
+public:
+	static ParticleSystemManager& GetInstance();
+	
+	void SetParticleBudget(int maxParticles);
+	const int GetParticleBudget() const;
+	const int GetNumParticlesAlive() const;
+	const int GetNumParticlesCulled() const;
+	const int GetNumEmitters() const;
+	const int GetArenaSize() const;
+	const int GetArenaInUse() const;
+};
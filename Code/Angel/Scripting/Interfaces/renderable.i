@@ -12,4 +12,11 @@ public:
 	void Destroy();
 	bool IsDestroyed();
 	int GetLayer();
+	
+	void SetThreadSafe(bool threadSafe);
+	bool IsThreadSafe();
+	void SetCullable(bool cullable);
+	bool IsCullable();
+	void SetBatchable(bool batchable);
+	bool IsBatchable();
 };
@@ -33,6 +33,14 @@ public:
 	void NameLayer(String name, int number);
 	const int GetLayerByName(String name);
 	
+	void SetCulling(bool enabled);
+	const bool GetCulling() const;
+	void SetLayerCulling(int layer, bool enabled);
+	void SetLayerCulling(String layer, bool enabled);
+	const bool GetLayerCulling(int layer);
+	const int GetNumRenderablesDrawn() const;
+	const int GetNumRenderablesCulled() const;
+	
 	void DrawDebugLine( const Vector2& a, const Vector2& b, float time = 5.f, Color color = Color(1.f, 0.f, 0.f) );
 	void PurgeDebugDrawing();
     
@@ -45,6 +53,9 @@ public:
     const bool PausePhysics();
     const bool ResumePhysics();
 	
+	void SetParallelUpdate(bool enabled);
+	const bool GetParallelUpdate() const;
+	
 	void RegisterConsole(Console* console);
 	Console* GetConsole();
 };
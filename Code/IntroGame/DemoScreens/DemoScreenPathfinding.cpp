@@ -147,6 +147,7 @@ MazeFinder::MazeFinder()
 	SetColor(1, 0, 0);
 	SetSize(0.75f);
 	SetDrawShape(ADS_Circle);
+	SetBatchable(false); //we draw our path ourselves
 	theSwitchboard.SubscribeTo(this, "MazeFinderPathPointReached");
 	theSwitchboard.SubscribeTo(this, "MouseDown");
 	_pathIndex = 0;